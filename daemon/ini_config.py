@@ -19,12 +19,17 @@
 #
 
 import configparser
+import logging
+import os
+import os.path
+import tempfile
 
 import dbus
 import dbus.service
 from gi.repository import GLib
 
 from osdlyrics.app import App
+from osdlyrics.config import ValueNotExistError, split, to_config_string
 from osdlyrics.consts import CONFIG_BUS_NAME, CONFIG_OBJECT_PATH
 import osdlyrics.errors
 import osdlyrics.utils
@@ -34,11 +39,6 @@ class MalformedKeyError(osdlyrics.errors.BaseError):
     pass
 
 
-class ValueNotExistError(osdlyrics.errors.BaseError):
-    def __init__(self, key=''):
-        super().__init__('Value of key %s does not exist' % key)
-
-
 class IniConfig(dbus.service.Object):
     """ Implement org.osdlyrics.Config
     """
@@ -120,6 +120,21 @@ class IniConfig(dbus.service.Object):
         except (configparser.NoSectionError, configparser.NoOptionError):
             raise ValueNotExistError(key)
 
+    @dbus.service.method(dbus_interface=CONFIG_BUS_NAME,
+                         in_signature='',
+                         out_signature='a{ss}')
+    def GetAllValues(self):
+        """ Returns all the values as strings in the config file, so that
+        clients can cache them with one call.
+
+        Option names are case insensitive and returned in lower case.
+        """
+        values = {}
+        for section in self._confparser.sections():
+            for name, value in self._confparser.items(section):
+                values[section + '/' + name] = value
+        return dbus.Dictionary(values, signature='ss')
+
     def _set_value(self, key, value, overwrite=True):
         section, name = self._split_key(key, True)
         if overwrite or not self._confparser.has_option(section, name):
@@ -132,7 +147,7 @@ class IniConfig(dbus.service.Object):
                          in_signature='sb',
                          out_signature='')
     def SetBool(self, key, value):
-        self._set_value(key, 'true' if value else 'false')
+        self._set_value(key, to_config_string(bool(value)))
 
     @dbus.service.method(dbus_interface=CONFIG_BUS_NAME,
                          in_signature='si',
@@ -156,16 +171,33 @@ class IniConfig(dbus.service.Object):
                          in_signature='sas',
                          out_signature='')
     def SetStringList(self, key, value):
-        self._set_value(key, join(value))
+        self._set_value(key, to_config_string(value))
 
     @dbus.service.method(dbus_interface=CONFIG_BUS_NAME,
                          in_signature='a{sv}',
                          out_signature='')
     def SetDefaultValues(self, values):
         for k, v in values.items():
-            if isinstance(v, list):
-                v = join(v)
-            self._set_value(k, v, False)
+            self._set_value(k, to_config_string(v), False)
+
+    @dbus.service.method(dbus_interface=CONFIG_BUS_NAME,
+                         in_signature='a{sv}',
+                         out_signature='')
+    def SetValues(self, values):
+        """ Sets a set of values at once
+
+        Either all or none of the values are set. The changed values are
+        saved together and reported in one ValueChanged signal.
+        """
+        # Check all the keys before setting any of them
+        for k in values:
+            self._split_key(k, False)
+        for k, v in values.items():
+            v = to_config_string(v)
+            section, name = self._split_key(k)
+            if (not self._confparser.has_option(section, name) or
+                    self._confparser.get(section, name) != v):
+                self._set_value(k, v)
 
     def _schedule_save(self, filename=None):
         if self._save_timer is None:
@@ -173,13 +205,40 @@ class IniConfig(dbus.service.Object):
                                                 lambda: self.save(filename))
 
     def save(self, filename=None):
+        """ Writes the config file
+
+        The content is written to a temporary file, which replaces the config
+        file once it is synced to the disk, so the config file is never left
+        partially written.
+        """
         if filename is None:
             filename = self._filename
-        with open(filename, 'w') as f:
-            self._confparser.write(f)
         if self._save_timer is not None:
             GLib.source_remove(self._save_timer)
             self._save_timer = None
+        dirname, basename = os.path.split(filename)
+        try:
+            fd, temp_path = tempfile.mkstemp(prefix='.%s.' % basename, dir=dirname)
+        except OSError as e:
+            logging.error('Cannot save config to %s: %s', filename, e)
+            return
+        try:
+            with os.fdopen(fd, 'w') as f:
+                self._confparser.write(f)
+                f.flush()
+                os.fsync(f.fileno())
+            try:
+                mode = os.stat(filename).st_mode & 0o777
+            except OSError:
+                mode = 0o644
+            os.chmod(temp_path, mode)
+            os.replace(temp_path, filename)
+        except OSError as e:
+            logging.error('Cannot save config to %s: %s', filename, e)
+            try:
+                os.unlink(temp_path)
+            except OSError:
+                pass
 
     def _schedule_signal(self):
         if self._signal_timer is None:
@@ -200,72 +259,6 @@ class IniConfig(dbus.service.Object):
         pass
 
 
-def split(value, sep=';'):
-    r"""
-    >>> split('')
-    []
-    >>> split(' ')
-    [' ']
-    >>> split('single')
-    ['single']
-    >>> split('one;two')
-    ['one', 'two']
-    >>> split('one;')
-    ['one']
-    >>> split(';one;two;')
-    ['', 'one', 'two']
-    >>> split(r'one\;two;three\\;four')
-    ['one;two', 'three\\', 'four']
-    >>> split(r'\one\\\;two;\\three\\\\;four;')
-    ['\\one\\;two', '\\three\\\\', 'four']
-    >>> split('; ')
-    ['', ' ']
-    """
-    start = 0
-    ret = []
-    item = []
-    curr = 0
-    while curr <= len(value):
-        if curr == len(value) or value[curr] == sep:
-            if start < curr:
-                item.append(value[start:curr])
-            if curr != len(value) or item:
-                ret.append(''.join(item))
-            item = []
-            start = curr + 1
-        elif value[curr] == '\\' and curr < len(value) - 1:
-            tag = value[curr + 1]
-            if tag == '\\' or tag == sep:
-                item.append(value[start:curr])
-                start = curr + 1
-                curr = start
-        curr = curr + 1
-    return ret
-
-
-def join(values, sep=';'):
-    r"""
-    >>> join([])
-    ''
-    >>> join([''])
-    ';'
-    >>> join(['one'])
-    'one;'
-    >>> join(['one', 'two'])
-    'one;two;'
-    >>> join(['one;', 'two'])
-    'one\\;;two;'
-    >>> print join([r'on\e', 't;wo'])
-    on\\e;t\;wo;
-    """
-    if not values:
-        return ''
-    result = []
-    for item in values:
-        result.append(item.replace('\\', '\\\\').replace(sep, '\\;'))
-    return sep.join(result) + sep
-
-
 def test():
     import doctest
     doctest.testmod()
@@ -17,9 +17,11 @@
 # You should have received a copy of the GNU General Public License
 # along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
 #
+import json
 import logging
 import os.path
 import sqlite3
+import unicodedata
 
 from osdlyrics.consts import (METADATA_ALBUM, METADATA_ARTIST, METADATA_TITLE,
                               METADATA_TRACKNUM)
@@ -29,6 +31,10 @@ __all__ = (
     'LrcDb',
 )
 
+# The number of prepared statements kept by the connection, enough for all the
+# queries of LrcDb
+CACHED_STATEMENTS = 32
+
 
 def query_param_from_metadata(metadata):
     """
@@ -39,10 +45,38 @@ def query_param_from_metadata(metadata):
         METADATA_ARTIST: metadata.artist or '',
         METADATA_ALBUM: metadata.album or '',
         METADATA_TRACKNUM: max(metadata.tracknum, 0),
+        'info_key': normalize_key(metadata.title, metadata.artist,
+                                  metadata.album, metadata.tracknum),
     }
     return param
 
 
+def normalize_key(title, artist, album, tracknum):
+    """
+    Generate a key from the metadata that is insensitive to case, width and
+    whitespaces, which is used to find lyrics when the metadata is not exactly
+    the same as the assigned one.
+
+    >>> normalize_key(' Tiger  Soldier ', '\\uff21BC', None, -1)
+    'tiger soldier\\x1fabc\\x1f\\x1f0'
+    >>> normalize_key('Tiger Soldier', 'abc', '', 0)
+    'tiger soldier\\x1fabc\\x1f\\x1f0'
+    """
+    fields = [' '.join(unicodedata.normalize('NFKC', value or '').casefold().split())
+              for value in (title, artist, album)]
+    fields.append(str(max(tracknum or 0, 0)))
+    return '\x1f'.join(fields)
+
+
+def _migrate_info_key(conn):
+    """ Fills the normalized keys of the assignments created before version 3
+    """
+    rows = conn.execute('SELECT id, {0}, {1}, {2}, {3} FROM lyrics'.format(
+        METADATA_TITLE, METADATA_ARTIST, METADATA_ALBUM, METADATA_TRACKNUM)).fetchall()
+    conn.executemany('UPDATE lyrics SET info_key = ? WHERE id = ?',
+                     [(normalize_key(*row[1:]), row[0]) for row in rows])
+
+
 class LrcDb:
     """ Database to store location of LRC files that have been manually assigned
     """
@@ -51,19 +85,83 @@ class LrcDb:
 
     METADATA_LIST = [METADATA_TITLE, METADATA_ARTIST, METADATA_ALBUM, METADATA_TRACKNUM]
 
-    CREATE_TABLE = """
+    ENCODING_TABLE_NAME = 'encodings'
+
+    OFFSET_TABLE_NAME = 'offsets'
+
+    SEARCH_TABLE_NAME = 'search_results'
+
+    # The schema of the db. The version of a db is stored in the user_version
+    # pragma, which is 0 for new dbs and the ones created before migrations
+    # are introduced. Each item upgrades the db to the next version with a
+    # list of SQL statements or functions taking the connection. Never change
+    # a released migration, append a new one instead.
+    MIGRATIONS = [
+        # Version 1: assignments of lyrics
+        [
+            """
 CREATE TABLE IF NOT EXISTS {0} (
   id INTEGER PRIMARY KEY AUTOINCREMENT,
   {1} TEXT, {2} TEXT, {3} TEXT, {4} INTEGER,
   uri TEXT UNIQUE ON CONFLICT REPLACE,
   lrcpath TEXT
 )
-""".format(TABLE_NAME, *METADATA_LIST)
+""".format(TABLE_NAME, *METADATA_LIST),
+        ],
+        # Version 2: encodings and offsets of LRC files. elapsed is the time in
+        # seconds spent on detecting the encoding. hash is the hash of the
+        # content of the file, so the offset is not applied if the file is
+        # replaced.
+        [
+            """
+CREATE TABLE IF NOT EXISTS {0} (
+  path TEXT PRIMARY KEY ON CONFLICT REPLACE,
+  mtime INTEGER,
+  encoding TEXT,
+  elapsed REAL
+)
+""".format(ENCODING_TABLE_NAME),
+            """
+CREATE TABLE IF NOT EXISTS {0} (
+  uri TEXT,
+  hash TEXT,
+  offset INTEGER,
+  PRIMARY KEY (uri, hash) ON CONFLICT REPLACE
+)
+""".format(OFFSET_TABLE_NAME),
+        ],
+        # Version 3: indices to find lyrics by metadata
+        [
+            'ALTER TABLE {0} ADD COLUMN info_key TEXT'.format(TABLE_NAME),
+            _migrate_info_key,
+            'CREATE INDEX IF NOT EXISTS {0}_info ON {0} ({1}, {2}, {3}, {4})'.format(
+                TABLE_NAME, *METADATA_LIST),
+            'CREATE INDEX IF NOT EXISTS {0}_info_key ON {0} (info_key)'.format(
+                TABLE_NAME),
+        ],
+        # Version 4: cached results of searching lyric sources. results is
+        # the JSON array of the results, found is 0 if nothing is found, and
+        # time is the time of the search in seconds since the epoch.
+        [
+            """
+CREATE TABLE IF NOT EXISTS {0} (
+  source TEXT,
+  info_key TEXT,
+  results TEXT,
+  found INTEGER,
+  time REAL,
+  PRIMARY KEY (source, info_key) ON CONFLICT REPLACE
+)
+""".format(SEARCH_TABLE_NAME),
+            'CREATE INDEX IF NOT EXISTS {0}_time ON {0} (time)'.format(
+                SEARCH_TABLE_NAME),
+        ],
+    ]
 
     ASSIGN_LYRIC = """
 INSERT OR REPLACE INTO {0}
-  ({1}, {2}, {3}, {4}, uri, lrcpath)
-  VALUES (?, ?, ?, ?, ?, ?)
+  ({1}, {2}, {3}, {4}, info_key, uri, lrcpath)
+  VALUES (?, ?, ?, ?, ?, ?, ?)
 """ .format(TABLE_NAME, *METADATA_LIST)
 
     UPDATE_LYRIC = """
@@ -72,13 +170,65 @@ UPDATE {0}
   WHERE uri=?
 """.format(TABLE_NAME)
 
-    DELETE_LYRIC = 'DELETE FROM {0} WHERE '.format(TABLE_NAME)
+    QUERY_LOCATION = 'uri = :uri'
 
-    FIND_LYRIC = 'SELECT lrcpath FROM {0} WHERE '.format(TABLE_NAME)
+    QUERY_INFO = ' AND '.join('{0}=:{0}'.format(m) for m in METADATA_LIST)
 
-    QUERY_LOCATION = 'uri = ?'
+    QUERY_INFO_KEY = 'info_key = :info_key'
 
-    QUERY_INFO = ' AND '.join('{0}=:{0}'.format(m) for m in METADATA_LIST)
+    # The statements are built once so that the connection always reuses the
+    # prepared statements of them.
+    DELETE_BY_LOCATION = 'DELETE FROM {0} WHERE {1}'.format(TABLE_NAME, QUERY_LOCATION)
+
+    DELETE_BY_INFO = 'DELETE FROM {0} WHERE ({1}) OR {2}'.format(
+        TABLE_NAME, QUERY_INFO, QUERY_INFO_KEY)
+
+    FIND_BY_LOCATION = 'SELECT lrcpath FROM {0} WHERE {1}'.format(
+        TABLE_NAME, QUERY_LOCATION)
+
+    FIND_BY_INFO = 'SELECT lrcpath FROM {0} WHERE {1}'.format(TABLE_NAME, QUERY_INFO)
+
+    # Prefers the latest assignment among the ones with the same normalized key
+    FIND_BY_INFO_KEY = 'SELECT lrcpath FROM {0} WHERE {1} ORDER BY id DESC'.format(
+        TABLE_NAME, QUERY_INFO_KEY)
+
+    ALL_LOCATIONS = "SELECT uri FROM {0} WHERE uri != ''".format(TABLE_NAME)
+
+    ASSIGN_ENCODING = """
+INSERT OR REPLACE INTO {0}
+  (path, mtime, encoding, elapsed)
+  VALUES (?, ?, ?, ?)
+""".format(ENCODING_TABLE_NAME)
+
+    FIND_ENCODING = """
+SELECT encoding, elapsed FROM {0}
+  WHERE path = ? AND mtime = ?
+""".format(ENCODING_TABLE_NAME)
+
+    ASSIGN_OFFSET = """
+INSERT OR REPLACE INTO {0}
+  (uri, hash, offset)
+  VALUES (?, ?, ?)
+""".format(OFFSET_TABLE_NAME)
+
+    FIND_OFFSET = """
+SELECT offset FROM {0}
+  WHERE uri = ? AND hash = ?
+""".format(OFFSET_TABLE_NAME)
+
+    ASSIGN_SEARCH_RESULTS = """
+INSERT OR REPLACE INTO {0}
+  (source, info_key, results, found, time)
+  VALUES (?, ?, ?, ?, ?)
+""".format(SEARCH_TABLE_NAME)
+
+    FIND_SEARCH_RESULTS = """
+SELECT results, time FROM {0}
+  WHERE source = ? AND info_key = ?
+""".format(SEARCH_TABLE_NAME)
+
+    COUNT_SEARCH_RESULTS = 'SELECT found, COUNT(*) FROM {0} GROUP BY found'.format(
+        SEARCH_TABLE_NAME)
 
     def __init__(self, dbfile=None):
         """
@@ -90,50 +240,83 @@ UPDATE {0}
             dbfile = osdlyrics.utils.get_config_path('lrc.db')
         self._dbfile = dbfile
         osdlyrics.utils.ensure_path(dbfile)
-        self._conn = sqlite3.connect(os.path.expanduser(dbfile))
-        self._create_table()
-
-    def _create_table(self):
-        """ Ensures the table structure of new open dbs
+        self._conn = sqlite3.connect(os.path.expanduser(dbfile),
+                                     cached_statements=CACHED_STATEMENTS)
+        # With WAL, a commit appends to the log without syncing the db file.
+        # NORMAL is durable enough for WAL, a power loss may only roll back the
+        # last transactions.
+        self._conn.execute('PRAGMA journal_mode=WAL')
+        self._conn.execute('PRAGMA synchronous=NORMAL')
+        self._migrate()
+
+    def _migrate(self):
+        """ Upgrades the db to the latest version in MIGRATIONS
         """
-        c = self._conn.cursor()
-        c.execute(LrcDb.CREATE_TABLE)
-        self._conn.commit()
-        c.close()
+        version = self._conn.execute('PRAGMA user_version').fetchone()[0]
+        for i in range(version, len(LrcDb.MIGRATIONS)):
+            logging.info('Upgrade lrc db %s to version %d', self._dbfile, i + 1)
+            with self._conn:
+                # Run DDL statements in the transaction too
+                self._conn.execute('BEGIN')
+                for migration in LrcDb.MIGRATIONS[i]:
+                    if callable(migration):
+                        migration(self._conn)
+                    else:
+                        self._conn.execute(migration)
+                # PRAGMA doesn't support parameters
+                self._conn.execute('PRAGMA user_version = %d' % (i + 1))
 
     def assign(self, metadata, uri):
         # type: (osdlyrics.metadata.Metadata, Text) -> None
         """ Assigns a uri of lyrics to tracks represented by metadata
         """
-        c = self._conn.cursor()
         location = metadata.location or ''
-        if self._find_by_location(metadata):
-            logging.debug('Assign lyric file %s to track of location %s', uri, location)
-            c.execute(LrcDb.UPDATE_LYRIC, (uri, location,))
-        else:
-            title = metadata.title or ''
-            artist = metadata.artist or ''
-            album = metadata.album or ''
-            tracknum = max(metadata.tracknum, 0)
-            logging.debug('Assign lyrics file %s to track %s. %s - %s in album %s @ %s', uri, tracknum, artist, title, album, location)
-            c.execute(LrcDb.ASSIGN_LYRIC, (title, artist, album, tracknum, location, uri))
-        self._conn.commit()
-        c.close()
+        with self._conn:
+            if self._find_by_location(metadata):
+                logging.debug('Assign lyric file %s to track of location %s', uri, location)
+                self._conn.execute(LrcDb.UPDATE_LYRIC, (uri, location,))
+            else:
+                param = query_param_from_metadata(metadata)
+                logging.debug('Assign lyrics file %s to track %s. %s - %s in album %s @ %s', uri,
+                              param[METADATA_TRACKNUM], param[METADATA_ARTIST],
+                              param[METADATA_TITLE], param[METADATA_ALBUM], location)
+                self._conn.execute(LrcDb.ASSIGN_LYRIC,
+                                   (param[METADATA_TITLE], param[METADATA_ARTIST],
+                                    param[METADATA_ALBUM], param[METADATA_TRACKNUM],
+                                    param['info_key'], location, uri))
+
+    def assign_many(self, assignments):
+        # type: (Iterable[Tuple[osdlyrics.metadata.Metadata, Text]]) -> None
+        """ Assigns uris of lyrics to tracks in one transaction
+
+        Arguments:
+        - `assignments`: Pairs of the metadata of a track and the uri of its
+          lyrics. Existing assignments of the same locations are replaced.
+        """
+        def rows():
+            for metadata, uri in assignments:
+                param = query_param_from_metadata(metadata)
+                yield (param[METADATA_TITLE], param[METADATA_ARTIST],
+                       param[METADATA_ALBUM], param[METADATA_TRACKNUM],
+                       param['info_key'], metadata.location or '', uri)
+        with self._conn:
+            self._conn.executemany(LrcDb.ASSIGN_LYRIC, rows())
+
+    def assigned_locations(self):
+        # type: () -> Set[Text]
+        """ Returns the locations of all the tracks with lyrics assigned
+        """
+        return set(row[0] for row in self._conn.execute(LrcDb.ALL_LOCATIONS))
 
     def delete(self, metadata):
         """ Deletes lyrics association(s) for given metadata
 
         Deletes all lyrics associations that would be found by find(self, metadata)
         """
-        c = self._conn.cursor()
-
-        if metadata.location:
-            c.execute(LrcDb.DELETE_LYRIC + LrcDb.QUERY_LOCATION, (metadata.location,))
-
-        c.execute(LrcDb.DELETE_LYRIC + LrcDb.QUERY_INFO, query_param_from_metadata(metadata))
-
-        self._conn.commit()
-        c.close()
+        with self._conn:
+            if metadata.location:
+                self._conn.execute(LrcDb.DELETE_BY_LOCATION, {'uri': metadata.location})
+            self._conn.execute(LrcDb.DELETE_BY_INFO, query_param_from_metadata(metadata))
 
     def find(self, metadata):
         """ Finds the location of LRC files for given metadata
@@ -141,7 +324,8 @@ UPDATE {0}
         To find the location of lyrics, firstly find whether there is a record matched
         with the ``location`` attribute in metadata. If not found or ``location`` is
         not specified, try to find with respect to ``title``, ``artist``, ``album``
-        and ``tracknum``
+        and ``tracknum``, and then with the normalized key of them, which ignores
+        differences in case, width and whitespaces.
 
         If found, return the uri of the LRC file. Otherwise return None. Note that
         this method may return an empty string, so use ``is None`` to figure out
@@ -155,12 +339,124 @@ UPDATE {0}
             return ret
         return None
 
-    def _find_by_condition(self, where_clause, parameters=None):
-        query = LrcDb.FIND_LYRIC + where_clause
+    def assign_encoding(self, path, mtime, encoding, elapsed):
+        # type: (Text, int, Text, float) -> None
+        """ Remembers the encoding of an LRC file
+
+        Arguments:
+        - `path`: The path of the LRC file.
+        - `mtime`: The modification time of the file in nanoseconds. The
+          encoding is forgotten once the file is modified.
+        - `encoding`: The encoding of the file.
+        - `elapsed`: The time in seconds spent on detecting the encoding.
+        """
+        with self._conn:
+            self._conn.execute(LrcDb.ASSIGN_ENCODING, (path, mtime, encoding, elapsed))
+
+    def find_encoding(self, path, mtime):
+        # type: (Text, int) -> Optional[Tuple[Text, float]]
+        """ Finds the encoding of an LRC file remembered by assign_encoding
+
+        Returns a tuple of the encoding and the time spent on detecting it, or
+        None if not found or the file is modified after that.
+        """
+        return self._conn.execute(LrcDb.FIND_ENCODING, (path, mtime)).fetchone()
+
+    def assign_offset(self, uri, content_hash, offset):
+        # type: (Text, Text, int) -> None
+        """ Sets the offset of an LRC file
+
+        Arguments:
+        - `uri`: The URI of the LRC file.
+        - `content_hash`: The hash of the content of the LRC file.
+        - `offset`: The offset in milliseconds.
+        """
+        with self._conn:
+            self._conn.execute(LrcDb.ASSIGN_OFFSET, (uri, content_hash, offset))
+
+    def find_offset(self, uri, content_hash):
+        # type: (Text, Text) -> Optional[int]
+        """ Finds the offset of an LRC file set by assign_offset
+
+        Returns the offset in milliseconds, or None if the offset of the file
+        with the content is not set.
+        """
+        r = self._conn.execute(LrcDb.FIND_OFFSET, (uri, content_hash)).fetchone()
+        if r:
+            return r[0]
+        return None
+
+    def assign_search_results(self, source, info_key, results, time):
+        # type: (Text, Text, List[Dict[Text, Any]], float) -> bool
+        """ Caches the results of searching a lyric source
+
+        Arguments:
+        - `source`: The id of the lyric source.
+        - `info_key`: The normalized key of the searched metadata.
+        - `results`: The search results, which are cached even if empty.
+        - `time`: The time of the search in seconds since the epoch.
+
+        Returns False if the results cannot be stored as JSON.
+        """
+        try:
+            value = json.dumps(results)
+        except (TypeError, ValueError) as e:
+            logging.warning('Cannot cache search results of %s: %s', source, e)
+            return False
+        with self._conn:
+            self._conn.execute(LrcDb.ASSIGN_SEARCH_RESULTS,
+                               (source, info_key, value, 1 if results else 0, time))
+        return True
+
+    def find_search_results(self, source, info_key):
+        # type: (Text, Text) -> Optional[Tuple[List[Dict[Text, Any]], float]]
+        """ Finds the search results cached by assign_search_results
+
+        Returns a tuple of the results and the time of the search, or None if
+        not cached.
+        """
+        r = self._conn.execute(LrcDb.FIND_SEARCH_RESULTS, (source, info_key)).fetchone()
+        if r:
+            return json.loads(r[0]), r[1]
+        return None
+
+    def delete_search_results(self, source=None, before=None):
+        # type: (Optional[Text], Optional[float]) -> int
+        """ Deletes cached search results
+
+        Arguments:
+        - `source`: If not None, only the results of the lyric source are
+          deleted.
+        - `before`: If not None, only the results of searches before the time
+          are deleted.
+
+        Returns the number of deleted entries.
+        """
+        conditions = []
+        params = []
+        if source is not None:
+            conditions.append('source = ?')
+            params.append(source)
+        if before is not None:
+            conditions.append('time < ?')
+            params.append(before)
+        query = 'DELETE FROM {0}'.format(LrcDb.SEARCH_TABLE_NAME)
+        if conditions:
+            query += ' WHERE ' + ' AND '.join(conditions)
+        with self._conn:
+            return self._conn.execute(query, params).rowcount
+
+    def count_search_results(self):
+        # type: () -> Tuple[int, int]
+        """ Returns the numbers of cached searches that find lyrics and that
+        find nothing
+        """
+        counts = dict(self._conn.execute(LrcDb.COUNT_SEARCH_RESULTS).fetchall())
+        return counts.get(1, 0), counts.get(0, 0)
+
+    def _find_by_condition(self, query, parameters):
         logging.debug('Find by condition, query = %s, params = %s', query, parameters)
-        c = self._conn.cursor()
-        c.execute(query, parameters)
-        r = c.fetchone()
+        r = self._conn.execute(query, parameters).fetchone()
         logging.debug('Fetch result: %s', r)
         if r:
             return r[0]
@@ -169,11 +465,14 @@ UPDATE {0}
     def _find_by_location(self, metadata):
         if not metadata.location:
             return None
-        return self._find_by_condition(LrcDb.QUERY_LOCATION, (metadata.location,))
+        return self._find_by_condition(LrcDb.FIND_BY_LOCATION, {'uri': metadata.location})
 
     def _find_by_info(self, metadata):
-        return self._find_by_condition(LrcDb.QUERY_INFO,
-                                       query_param_from_metadata(metadata))
+        param = query_param_from_metadata(metadata)
+        ret = self._find_by_condition(LrcDb.FIND_BY_INFO, param)
+        if ret is not None:
+            return ret
+        return self._find_by_condition(LrcDb.FIND_BY_INFO_KEY, param)
 
 
 def test():
@@ -212,10 +511,67 @@ def test():
     '\u8def\u5f84'
     >>> db.find(Metadata.from_dict({'title': 'Tiger', 'artist': 'Soldiers', }))
     >>> db.find(Metadata())
+    >>> db.find(Metadata.from_dict({'title': ' TIGER', 'artist': 'soldier'}))
+    'file:///tmp/b.lrc'
+    >>> db.assign_encoding('/tmp/a.lrc', 100, 'gb18030', 0.5)
+    >>> db.find_encoding('/tmp/a.lrc', 100)
+    ('gb18030', 0.5)
+    >>> db.find_encoding('/tmp/a.lrc', 101)
+    >>> db.assign_encoding('/tmp/a.lrc', 101, 'utf-8', 0.0)
+    >>> db.find_encoding('/tmp/a.lrc', 100)
+    >>> db.assign_offset('file:///tmp/a.lrc', 'hash', 100)
+    >>> db.assign_offset('file:///tmp/a.lrc', 'hash', -200)
+    >>> db.find_offset('file:///tmp/a.lrc', 'hash')
+    -200
+    >>> db.find_offset('file:///tmp/a.lrc', 'another hash')
+    >>> db.assign_many([(Metadata(title='Many', location='file:///tmp/many%d' % i),
+    ...                  'file:///tmp/many%d.lrc' % i) for i in range(3)])
+    >>> db.find(Metadata(location='file:///tmp/many2'))
+    'file:///tmp/many2.lrc'
+    >>> sorted(l for l in db.assigned_locations() if 'many' in l)
+    ['file:///tmp/many0', 'file:///tmp/many1', 'file:///tmp/many2']
     >>> db.delete(Metadata.from_dict({'location': 'file:///tmp/asdf'}))
     >>> db.find(Metadata.from_dict({'title': 'Tiger',
     ...                             'artist': 'Soldier',
     ...                             'location': 'file:///tmp/asdf'}))
+    >>> db.find(Metadata.from_dict({'title': ' TIGER', 'artist': 'soldier'}))
+    >>> _ = db.delete_search_results()
+    >>> db.assign_search_results('src', 'key', [{'title': 'Tiger', 'downloadinfo': 'url'}], 10.0)
+    True
+    >>> db.assign_search_results('src', 'none', [], 20.0)
+    True
+    >>> db.assign_search_results('src', 'bytes', [{'downloadinfo': b'data'}], 20.0)
+    False
+    >>> db.find_search_results('src', 'key')
+    ([{'title': 'Tiger', 'downloadinfo': 'url'}], 10.0)
+    >>> db.find_search_results('src', 'none')
+    ([], 20.0)
+    >>> db.find_search_results('other', 'key')
+    >>> db.count_search_results()
+    (1, 1)
+    >>> db.delete_search_results(before=15.0)
+    1
+    >>> db.delete_search_results(source='other')
+    0
+    >>> db.count_search_results()
+    (0, 1)
+
+    Dbs created before migrations are introduced are upgraded:
+
+    >>> import os
+    >>> import sqlite3
+    >>> if os.path.exists('/tmp/asdf-legacy'): os.remove('/tmp/asdf-legacy')
+    >>> conn = sqlite3.connect('/tmp/asdf-legacy')
+    >>> _ = conn.execute(LrcDb.MIGRATIONS[0][0])
+    >>> _ = conn.execute("INSERT INTO lyrics (title, artist, album, tracknum, uri, lrcpath) "
+    ...                  "VALUES ('Tiger', 'Soldier', '', 0, '', 'file:///tmp/c.lrc')")
+    >>> conn.commit()
+    >>> conn.close()
+    >>> legacy = LrcDb('/tmp/asdf-legacy')
+    >>> legacy.find(Metadata.from_dict({'title': 'tiger', 'artist': 'SOLDIER'}))
+    'file:///tmp/c.lrc'
+    >>> legacy._conn.execute('PRAGMA user_version').fetchone()[0] == len(LrcDb.MIGRATIONS)
+    True
     """
     import doctest
     doctest.testmod()
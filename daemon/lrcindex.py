@@ -0,0 +1,446 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file is part of OSD Lyrics.
+#
+# OSD Lyrics is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# OSD Lyrics is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
+#
+import logging
+import os
+import os.path
+import threading
+import unicodedata
+
+from gi.repository import Gio, GLib
+
+__all__ = (
+    'LrcIndex',
+)
+
+LRC_EXT = '.lrc'
+
+
+def normalize_name(name):
+    """
+    Generate the key of a file name in the index, which is insensitive to case
+    and width.
+
+    >>> normalize_name('Foo/\\uff21 - Bar.LRC') == normalize_name('foo/a - bar.lrc')
+    True
+    """
+    return unicodedata.normalize('NFKC', name).casefold()
+
+
+def is_lrc_file(name):
+    return name[-len(LRC_EXT):].lower() == LRC_EXT
+
+
+def scan_directory(top, root):
+    """
+    Lists the LRC files and directories under top recursively.
+
+    Return values: files, dirs
+    - `files`: The paths of the LRC files relative to root.
+    - `dirs`: The absolute paths of top and all the directories under it.
+    """
+    files = []
+    dirs = []
+    for dirpath, _, filenames in os.walk(top):
+        dirs.append(dirpath)
+        for filename in filenames:
+            if is_lrc_file(filename):
+                files.append(os.path.relpath(os.path.join(dirpath, filename), root))
+    return files, dirs
+
+
+def list_directories(dirs, root):
+    """
+    Lists the LRC files and subdirectories directly in each of dirs.
+
+    Return values: files, subdirs
+    - `files`: The paths of the LRC files relative to root.
+    - `subdirs`: The absolute paths of the subdirectories.
+    """
+    files = []
+    subdirs = []
+    for directory in dirs:
+        try:
+            entries = list(os.scandir(directory))
+        except OSError:
+            continue
+        for entry in entries:
+            try:
+                if entry.is_dir(follow_symlinks=False):
+                    subdirs.append(entry.path)
+                elif is_lrc_file(entry.name):
+                    files.append(os.path.relpath(entry.path, root))
+            except OSError:
+                continue
+    return files, subdirs
+
+
+class LrcIndex:
+    """
+    Index of the LRC files under the lyric directories.
+
+    The directories are scanned in background threads, and kept up to date with
+    file monitors. Until a directory is scanned, or for directories out of the
+    indexed ones, finding a file falls back to checking the file system.
+
+    Names are matched regardless of case and width. If several files match a
+    name, the one with exactly the same name is preferred.
+    """
+
+    def __init__(self):
+        # root -> {normalized relative path -> [relative paths]}
+        self._files = {}
+        # root -> {directory -> Gio.FileMonitor}
+        self._monitors = {}
+        # Roots being scanned, with the generation of the scan
+        self._pending = {}
+        # Roots that don't exist -> Gio.FileMonitor of the parent directory
+        self._missing = {}
+        self._generation = 0
+
+    def set_roots(self, roots):
+        """
+        Sets the directories to index. Directories no longer in roots are
+        dropped from the index.
+        """
+        roots = set(os.path.normpath(root) for root in roots)
+        known = set(self._files) | set(self._pending) | set(self._missing)
+        for root in known - roots:
+            self._drop_root(root)
+        for root in roots - known:
+            self._start_scan(root, root)
+
+    def find(self, directory, name):
+        """
+        Finds the LRC file with the name in directory.
+
+        Arguments:
+        - `directory`: The absolute path of the directory.
+        - `name`: The relative path of the file in directory, with extension.
+
+        Returns the path of the file, or None if not found.
+        """
+        root = os.path.normpath(directory)
+        files = self._files.get(root)
+        if files is None:
+            path = os.path.join(directory, name)
+            return path if os.path.isfile(path) else None
+        name = os.path.normpath(name)
+        names = files.get(normalize_name(name))
+        if not names:
+            return None
+        return os.path.join(root, name if name in names else names[0])
+
+    def add_file(self, path):
+        """
+        Adds an LRC file to the index immediately, without waiting for the
+        file monitor.
+        """
+        path = os.path.normpath(path)
+        for root, files in self._files.items():
+            if path.startswith(root + os.sep):
+                self._add(files, os.path.relpath(path, root))
+
+    def _start_scan(self, root, top):
+        self._generation += 1
+        generation = self._generation
+        if top == root:
+            self._pending[root] = generation
+
+        def scan():
+            files, dirs = scan_directory(top, root)
+            GLib.idle_add(self._scan_done, root, top, generation, files, dirs)
+
+        logging.debug('Start indexing LRC files in %s', top)
+        threading.Thread(target=scan, name='lrc-index', daemon=True).start()
+
+    def _scan_done(self, root, top, generation, files, dirs):
+        if top == root:
+            if self._pending.get(root) != generation:
+                # Dropped while scanning
+                return False
+            del self._pending[root]
+            if not dirs:
+                self._watch_missing(root)
+                return False
+            self._files[root] = {}
+            self._monitors[root] = {}
+        elif root not in self._files:
+            return False
+        index = self._files[root]
+        for name in files:
+            self._add(index, name)
+        monitored = [directory for directory in dirs if self._monitor(root, directory)]
+        logging.debug('Indexed %d LRC files in %d directories under %s',
+                      len(files), len(dirs), top)
+        self._start_verify(root, monitored)
+        return False
+
+    def _start_verify(self, root, dirs):
+        """
+        Lists the directories again once they are monitored, to find the files
+        and directories created after they were scanned and before the
+        monitors were attached.
+        """
+        if not dirs:
+            return
+
+        def verify():
+            files, subdirs = list_directories(dirs, root)
+            GLib.idle_add(self._verify_done, root, files, subdirs)
+
+        threading.Thread(target=verify, name='lrc-index', daemon=True).start()
+
+    def _verify_done(self, root, files, subdirs):
+        if root not in self._files:
+            return False
+        index = self._files[root]
+        for name in files:
+            self._add(index, name)
+        monitors = self._monitors[root]
+        for directory in subdirs:
+            if directory not in monitors:
+                self._start_scan(root, directory)
+        return False
+
+    def _watch_missing(self, root):
+        """
+        Remembers a root that doesn't exist, and monitors its parent directory
+        to index the root once it is created. Until then, finding files in it
+        falls back to checking the file system.
+        """
+        logging.debug('Not indexing %s, which is not a directory', root)
+        parent = os.path.dirname(root)
+        try:
+            monitor = Gio.File.new_for_path(parent).monitor_directory(
+                Gio.FileMonitorFlags.WATCH_MOVES, None)
+        except GLib.Error as e:
+            logging.warning('Cannot monitor %s, %s will not be indexed when created: %s',
+                            parent, root, e)
+            monitor = None
+        else:
+            monitor.connect('changed', self._parent_changed_cb, root)
+        self._missing[root] = monitor
+        # The root may be created before the monitor is attached
+        if os.path.isdir(root):
+            self._found_missing(root)
+
+    def _parent_changed_cb(self, monitor, file, other_file, event_type, root):
+        if self._missing.get(root) is not monitor:
+            return
+        event = Gio.FileMonitorEvent
+        if event_type in (event.CREATED, event.MOVED_IN):
+            path = file.get_path()
+        elif event_type == event.RENAMED:
+            path = other_file.get_path()
+        else:
+            return
+        if path == root and os.path.isdir(root):
+            self._found_missing(root)
+
+    def _found_missing(self, root):
+        monitor = self._missing.pop(root)
+        if monitor is not None:
+            monitor.cancel()
+        self._start_scan(root, root)
+
+    def _drop_root(self, root):
+        self._pending.pop(root, None)
+        monitor = self._missing.pop(root, None)
+        if monitor is not None:
+            monitor.cancel()
+        self._files.pop(root, None)
+        for monitor in self._monitors.pop(root, {}).values():
+            monitor.cancel()
+
+    @staticmethod
+    def _add(index, name):
+        names = index.setdefault(normalize_name(name), [])
+        if name not in names:
+            names.append(name)
+
+    @staticmethod
+    def _remove(index, name):
+        key = normalize_name(name)
+        names = index.get(key)
+        if names and name in names:
+            names.remove(name)
+            if not names:
+                del index[key]
+
+    def _monitor(self, root, directory):
+        """
+        Monitors the directory if it is not monitored yet.
+
+        Returns True if a new monitor is attached.
+        """
+        monitors = self._monitors[root]
+        if directory in monitors:
+            return False
+        try:
+            monitor = Gio.File.new_for_path(directory).monitor_directory(
+                Gio.FileMonitorFlags.WATCH_MOVES, None)
+        except GLib.Error as e:
+            logging.warning('Cannot monitor %s, changes of LRC files in it will not be found: %s',
+                            directory, e)
+            return False
+        monitor.connect('changed', self._changed_cb, root)
+        monitors[directory] = monitor
+        return True
+
+    def _changed_cb(self, monitor, file, other_file, event_type, root):
+        if root not in self._files:
+            return
+        event = Gio.FileMonitorEvent
+        if event_type in (event.CREATED, event.MOVED_IN):
+            self._path_created(root, file.get_path())
+        elif event_type in (event.DELETED, event.MOVED_OUT):
+            self._path_deleted(root, file.get_path())
+        elif event_type == event.RENAMED:
+            self._path_deleted(root, file.get_path())
+            self._path_created(root, other_file.get_path())
+
+    def _path_created(self, root, path):
+        if os.path.isdir(path):
+            self._start_scan(root, path)
+        elif is_lrc_file(path):
+            self._add(self._files[root], os.path.relpath(path, root))
+
+    def _path_deleted(self, root, path):
+        if path == root:
+            self._drop_root(root)
+            self._watch_missing(root)
+            return
+        monitors = self._monitors[root]
+        if path in monitors:
+            # A directory is removed, with all the files in it
+            prefix = path + os.sep
+            for directory in [d for d in monitors if d == path or d.startswith(prefix)]:
+                monitors.pop(directory).cancel()
+            rel_prefix = os.path.relpath(path, root) + os.sep
+            index = self._files[root]
+            for key in [k for k, names in index.items()
+                        if any(name.startswith(rel_prefix) for name in names)]:
+                names = [name for name in index[key] if not name.startswith(rel_prefix)]
+                if names:
+                    index[key] = names
+                else:
+                    del index[key]
+        elif is_lrc_file(path):
+            self._remove(self._files[root], os.path.relpath(path, root))
+
+
+def test():
+    """
+    >>> import shutil
+    >>> import tempfile
+    >>> import time
+    >>> def wait_for(cond):
+    ...     context = GLib.MainContext.default()
+    ...     deadline = time.monotonic() + 5
+    ...     while not cond() and time.monotonic() < deadline:
+    ...         while context.iteration(False):
+    ...             pass
+    ...         time.sleep(0.01)
+    ...     return cond()
+    >>> def touch(*parts):
+    ...     path = os.path.join(*parts)
+    ...     os.makedirs(os.path.dirname(path), exist_ok=True)
+    ...     open(path, 'w').close()
+    ...     return path
+    >>> tmp = tempfile.mkdtemp()
+    >>> root = os.path.join(tmp, 'lrc')
+    >>> title = touch(root, 'Artist - Title.lrc')
+    >>> song = touch(root, 'sub', 'Song.lrc')
+    >>> _ = touch(root, 'sub', 'cover.jpg')
+
+    Files are found in the index once the roots are scanned.
+
+    >>> index = LrcIndex()
+    >>> index.set_roots([root])
+    >>> wait_for(lambda: root in index._files)
+    True
+    >>> index.find(root, 'ARTIST - TITLE.LRC') == title
+    True
+    >>> index.find(root, 'sub/\\uff33ong.lrc') == song
+    True
+    >>> index.find(root, 'sub/cover.jpg')
+
+    Changes are picked up by the file monitors.
+
+    >>> created = touch(root, 'sub', 'deeper', 'New.lrc')
+    >>> wait_for(lambda: index.find(root, 'sub/deeper/new.lrc') == created)
+    True
+    >>> os.remove(title)
+    >>> wait_for(lambda: index.find(root, 'Artist - Title.lrc') is None)
+    True
+    >>> shutil.rmtree(os.path.join(root, 'sub'))
+    >>> wait_for(lambda: index.find(root, 'sub/Song.lrc') is None and
+    ...                  index.find(root, 'sub/deeper/New.lrc') is None)
+    True
+
+    Files saved by ourselves are indexed immediately.
+
+    >>> saved = os.path.join(root, 'Saved.lrc')
+    >>> index.add_file(saved)
+    >>> index.find(root, 'saved.lrc') == saved
+    True
+
+    A root that doesn't exist is scanned only once, and indexed when created.
+
+    >>> missing = os.path.join(tmp, 'missing')
+    >>> index.set_roots([root, missing])
+    >>> wait_for(lambda: missing in index._missing)
+    True
+    >>> index.set_roots([root, missing])
+    >>> missing in index._pending
+    False
+    >>> index.find(missing, 'Late.lrc')
+    >>> late = touch(missing, 'Late.lrc')
+    >>> wait_for(lambda: missing in index._files)
+    True
+    >>> wait_for(lambda: index.find(missing, 'late.lrc') == late)
+    True
+    >>> shutil.rmtree(missing)
+    >>> wait_for(lambda: missing in index._missing)
+    True
+    >>> index.set_roots([])
+    >>> index._files, index._pending, index._missing, index._monitors
+    ({}, {}, {}, {})
+
+    Files created after a directory is scanned but before it is monitored are
+    found by the verify pass.
+
+    >>> _ = touch(saved)
+    >>> index = LrcIndex()
+    >>> index._pending[root] = index._generation = 1
+    >>> index._scan_done(root, root, 1, [], [root])
+    False
+    >>> index.find(root, 'Saved.lrc')
+    >>> wait_for(lambda: index.find(root, 'Saved.lrc') == saved)
+    True
+    >>> index.set_roots([])
+    >>> shutil.rmtree(tmp)
+    """
+    import doctest
+    doctest.testmod()
+
+
+if __name__ == '__main__':
+    test()
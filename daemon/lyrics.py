@@ -18,10 +18,14 @@
 # along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
 #
 
+import collections
+import hashlib
 import logging
 import os
 import os.path
 import re
+import tempfile
+import time
 import urllib.parse
 import urllib.request
 
@@ -37,6 +41,7 @@ from osdlyrics.metadata import Metadata
 from osdlyrics.pattern import expand_file, expand_path
 
 import lrcdb
+import lrcindex
 
 LYRICS_INTERFACE = 'org.osdlyrics.Lyrics'
 LYRICS_OBJECT_PATH = '/org/osdlyrics/Lyrics'
@@ -61,6 +66,44 @@ SUPPORTED_SCHEMES = [
 
 DETECT_CHARSET_GUESS_MIN_LEN = 40
 DETECT_CHARSET_GUESS_MAX_LEN = 100
+# chardet is slow, only the beginning of the content is used to detect
+DETECT_CHARSET_MAX_LEN = 4096
+
+# Checked in order, as the BOM of UTF-16 LE is a prefix of the one of UTF-32 LE
+CHARSET_BOMS = [
+    (b'\xef\xbb\xbf', 'utf-8-sig'),
+    (b'\xff\xfe\x00\x00', 'utf-32'),
+    (b'\x00\x00\xfe\xff', 'utf-32'),
+    (b'\xff\xfe', 'utf-16'),
+    (b'\xfe\xff', 'utf-16'),
+]
+
+PARSED_LYRICS_CACHE_SIZE = 32
+
+
+def expand_lrc_names(metadata, path_patterns, file_patterns):
+    """
+    Generates the candidate locations of the LRC file of a track, in the order
+    to find or save it.
+
+    Yields tuples of the directory and the name of the file in it. Patterns
+    that cannot be expanded with the metadata are skipped.
+
+    >>> list(expand_lrc_names(Metadata(title='Bar', location='file:///music/foo.mp3'),
+    ...                       ['/lyrics', '%'], ['%p-%t', '%t']))
+    [('/lyrics', 'Bar.lrc'), ('/music', 'Bar.lrc')]
+    """
+    for path_pat in path_patterns:
+        try:
+            path = expand_path(path_pat, metadata)
+        except osdlyrics.pattern.PatternException:
+            continue
+        for file_pat in file_patterns:
+            try:
+                filename = expand_file(file_pat, metadata)
+            except osdlyrics.pattern.PatternException:
+                continue
+            yield path, filename + '.lrc'
 
 
 class InvalidUriException(Exception):
@@ -89,16 +132,41 @@ def metadata_description(metadata):
     return '%s(%s)' % (metadata.title, metadata.artist)
 
 
-def decode_by_charset(content):
-    # type: (bytes) -> Text
-    r"""
-    Detect the charset encoding of a string and decodes to unicode strings.
-
-    >>> decode_by_charset(u'\u4e2d\u6587'.encode('UTF-8'))
-    '\u4e2d\u6587'
-    >>> decode_by_charset(u'\u4e2d\u6587'.encode('HZ-GB-2312'))
-    '\u4e2d\u6587'
+def _detect_charset_fast(content):
+    # type: (bytes) -> Optional[Text]
+    """
+    Detects the encodings that can be told without chardet.
+
+    Returns None if the encoding cannot be determined this way.
+
+    >>> _detect_charset_fast(b'\\xef\\xbb\\xbf[00:00]')
+    'utf-8-sig'
+    >>> _detect_charset_fast(b'[00:00]lyrics')
+    'utf-8'
+    >>> _detect_charset_fast(u'\\u4e2d\\u6587'.encode('UTF-8'))
+    'utf-8'
+    >>> _detect_charset_fast(u'\\u4e2d\\u6587'.encode('HZ-GB-2312'))
+    >>> _detect_charset_fast(u'\\u4e2d\\u6587'.encode('GBK'))
     """
+    for bom, encoding in CHARSET_BOMS:
+        if content.startswith(bom):
+            return encoding
+    if content.isascii():
+        # 7-bit encodings like HZ and ISO-2022 are also pure ASCII, let chardet
+        # find them out by their escape sequences.
+        if b'~{' in content or b'\x1b' in content:
+            return None
+        return 'utf-8'
+    try:
+        content.decode('utf-8')
+    except UnicodeDecodeError:
+        return None
+    return 'utf-8'
+
+
+def _detect_charset_by_chardet(content):
+    # type: (bytes) -> Text
+    content = content[:DETECT_CHARSET_MAX_LEN]
     encoding = chardet.detect(content)['encoding']
     # Sometimes, the content is well encoded but the last few bytes. This is
     # common in the files downloaded by old versions of OSD Lyrics. In this
@@ -109,7 +177,7 @@ def decode_by_charset(content):
         content_half = len(content) // 2
         slice_end = min(max(DETECT_CHARSET_GUESS_MIN_LEN, content_half), DETECT_CHARSET_GUESS_MAX_LEN)
         encoding = chardet.detect(content[:slice_end])['encoding']
-        logging.warning('guess encoding from part: ' + encoding)
+        logging.warning('guess encoding from part: %s', encoding)
     if not encoding:
         logging.warning('Failed to detect encoding, use utf-8 as fallback')
         encoding = 'utf-8'
@@ -126,6 +194,46 @@ def decode_by_charset(content):
         encoding = 'gb18030'
     elif encoding == 'big5':
         encoding = 'big5hkscs'
+    return encoding
+
+
+def detect_charset(content):
+    # type: (bytes) -> Tuple[Text, float]
+    """
+    Detects the charset encoding of the content of an LRC file.
+
+    BOMs, pure ASCII and valid UTF-8 are detected directly. chardet is only
+    consulted for other content, and only with the beginning of it.
+
+    Return values: encoding, elapsed
+    - `encoding`: The name of the encoding, which can be used with bytes.decode.
+    - `elapsed`: The time spent on the detection in seconds.
+    """
+    start = time.perf_counter()
+    encoding = _detect_charset_fast(content)
+    method = 'fast path'
+    if encoding is None:
+        encoding = _detect_charset_by_chardet(content)
+        method = 'chardet'
+    elapsed = time.perf_counter() - start
+    logging.debug('Encoding %s detected by %s in %.2fms', encoding, method,
+                  elapsed * 1000)
+    return encoding, elapsed
+
+
+def decode_by_charset(content):
+    # type: (bytes) -> Text
+    r"""
+    Detect the charset encoding of a string and decodes to unicode strings.
+
+    >>> decode_by_charset(u'\u4e2d\u6587'.encode('UTF-8'))
+    '\u4e2d\u6587'
+    >>> decode_by_charset(u'\u4e2d\u6587'.encode('HZ-GB-2312'))
+    '\u4e2d\u6587'
+    >>> decode_by_charset(u'\ufeff\u4e2d\u6587'.encode('UTF-16'))
+    '\u4e2d\u6587'
+    """
+    encoding, _ = detect_charset(content)
     return content.decode(encoding, 'replace')
 
 
@@ -160,34 +268,49 @@ def _load_from_file(urlparts):
     """
     Load the content of file from urlparse.ParseResult
 
-    Return the content of the file, or None if error raised.
+    Return values: content, key
+    - `content`: The content of the file, or None if error raised.
+    - `key`: The (path, mtime) tuple to cache the encoding of the file with.
     """
     path = urllib.request.url2pathname(urlparts.path)
     try:
         with open(path, 'rb') as f:
-            return f.read()
+            return f.read(), (path, os.fstat(f.fileno()).st_mtime_ns)
     except IOError as e:
         logging.info("Cannot open file %s to read: %s", path, e)
-        return None
+        return None, None
 
 
-def load_from_uri(uri):
-    # type: (Text) -> Optional[Text]
+def load_from_uri(uri, encodings=None):
+    # type: (Text, Optional[lrcdb.LrcDb]) -> Optional[Text]
     """
     Load the content of LRC file from given URI
 
     If loaded, return the content. If failed, return None.
+
+    Arguments:
+    - `encodings`: The LrcDb to remember the detected encodings of files in,
+      so that a file is not detected again until it is modified.
     """
     URI_LOAD_HANDLERS = {
         'file': _load_from_file,
-        'none': lambda uri: b'',
+        'none': lambda uri: (b'', None),
     }
 
     url_parts = urllib.parse.urlparse(uri)
-    content = URI_LOAD_HANDLERS[url_parts.scheme](url_parts)
+    content, key = URI_LOAD_HANDLERS[url_parts.scheme](url_parts)
     if content is None:
         return None
-    content = decode_by_charset(content).replace('\0', '')
+    cached = encodings.find_encoding(*key) if encodings and key else None
+    if cached:
+        encoding, elapsed = cached
+        logging.debug('Encoding %s of %s is cached, saved %.2fms', encoding,
+                      uri, elapsed * 1000)
+    else:
+        encoding, elapsed = detect_charset(content)
+        if encodings and key:
+            encodings.assign_encoding(*key, encoding=encoding, elapsed=elapsed)
+    content = content.decode(encoding, 'replace').replace('\0', '')
     return content
 
 
@@ -211,12 +334,32 @@ def _save_to_file(urlparts, content, create):
             except OSError as e:
                 logging.warning("Cannot create directories for %s: %s", path, e)
                 return False
+    # Write to a temporary file and rename it, so that the file is never left
+    # partially written.
+    dirname, basename = os.path.split(path)
     try:
-        file = open(path, 'wb')
-    except IOError as e:
+        fd, temp_path = tempfile.mkstemp(prefix='.%s.' % basename, dir=dirname)
+    except OSError as e:
         logging.info("Cannot open file %s to write: %s", path, e)
         return False
-    file.write(content)
+    try:
+        with os.fdopen(fd, 'wb') as file:
+            file.write(content)
+            file.flush()
+            os.fsync(file.fileno())
+        try:
+            mode = os.stat(path).st_mode & 0o777
+        except OSError:
+            mode = 0o644
+        os.chmod(temp_path, mode)
+        os.replace(temp_path, path)
+    except OSError as e:
+        logging.info("Cannot write to file %s: %s", path, e)
+        try:
+            os.unlink(temp_path)
+        except OSError:
+            pass
+        return False
     return True
 
 
@@ -236,6 +379,18 @@ def save_to_uri(uri, content, create=True):
     return URI_SAVE_HANDLERS[url_parts.scheme](url_parts, content, create)
 
 
+def content_hash(content):
+    # type: (Text) -> Text
+    """
+    Returns the hash of the decoded content of an LRC file, which identifies
+    the content in the offsets table of lrcdb.
+
+    >>> content_hash('[00:00]lyrics')
+    'eb12ba6fb5f65b85e163de790157f946e2e8d0bd'
+    """
+    return hashlib.sha1(content.encode('utf-8')).hexdigest()
+
+
 def update_lrc_offset(content, offset):
     r"""
     Replace the offset attributes in the content of LRC file.
@@ -260,6 +415,88 @@ def update_lrc_offset(content, offset):
                        content[search_result.end(2):])
 
 
+def lrc_cache_key(uri):
+    """
+    Returns the key of the LRC file of uri in ParsedLyricsCache.
+
+    The key consists of the uri, the modification time and the size of the
+    file, so the cached content is invalidated once the file changes. Returns
+    None if the content of uri cannot be cached.
+    """
+    url_parts = urllib.parse.urlparse(uri)
+    if url_parts.scheme != 'file':
+        return None
+    try:
+        st = os.stat(urllib.request.url2pathname(url_parts.path))
+    except OSError:
+        return None
+    return uri, st.st_mtime_ns, st.st_size
+
+
+class LrcCacheEntry:
+    """
+    A loaded LRC file in ParsedLyricsCache, with its decoded content and the
+    result of parsing it.
+
+    >>> entry = LrcCacheEntry('[00:01]a')
+    >>> entry.content, entry.hash == content_hash('[00:01]a')
+    ('[00:01]a', True)
+    >>> entry.parsed
+    ({}, [(1000, 'a')])
+    """
+
+    def __init__(self, content):
+        self.content = content
+        self.hash = content_hash(content)
+        self._parsed = None
+
+    @property
+    def parsed(self):
+        """ The (attrs, lines) tuple returned by osdlyrics.lrc.parse_lrc_lines,
+        which is parsed on first use and must not be modified.
+        """
+        if self._parsed is None:
+            self._parsed = osdlyrics.lrc.parse_lrc_lines(self.content)
+        return self._parsed
+
+
+class ParsedLyricsCache:
+    """
+    LRU cache of loaded LRC files.
+
+    The values are LrcCacheEntry objects, so that both the raw and the parsed
+    lyrics are served without reading the file again. The content hashes of
+    the files by URI are kept in the same kind of cache.
+
+    >>> cache = ParsedLyricsCache(2)
+    >>> cache.put('a', 1)
+    >>> cache.put('b', 2)
+    >>> cache.get('a')
+    1
+    >>> cache.put('c', 3)
+    >>> cache.get('b') is None
+    True
+    >>> cache.get('a'), cache.get('c')
+    (1, 3)
+    """
+
+    def __init__(self, capacity):
+        self._capacity = capacity
+        self._entries = collections.OrderedDict()
+
+    def get(self, key):
+        value = self._entries.get(key)
+        if value is not None:
+            self._entries.move_to_end(key)
+        return value
+
+    def put(self, key, value):
+        self._entries[key] = value
+        self._entries.move_to_end(key)
+        while len(self._entries) > self._capacity:
+            self._entries.popitem(last=False)
+
+
 class LyricsService(dbus.service.Object):
 
     def __init__(self, conn):
@@ -267,6 +504,39 @@ class LyricsService(dbus.service.Object):
         self._db = lrcdb.LrcDb()
         self._config = osdlyrics.config.Config(conn)
         self._metadata = Metadata()
+        self._parsed_cache = ParsedLyricsCache(PARSED_LYRICS_CACHE_SIZE)
+        # The content hashes of loaded LRC files by URI, to find their offsets
+        self._content_hashes = ParsedLyricsCache(PARSED_LYRICS_CACHE_SIZE)
+        self._index = lrcindex.LrcIndex()
+        self._file_patterns = DEFAULT_FILE_PATTERNS
+        self._path_patterns = DEFAULT_PATH_PATTERNS
+        self._config.connect_change('General/lrc-filename', self._patterns_changed_cb)
+        self._config.connect_change('General/lrc-path', self._patterns_changed_cb)
+        self._patterns_changed_cb()
+
+    def _patterns_changed_cb(self, key=None):
+        """ Reloads the patterns of LRC files and indexes the directories in them
+        """
+        self._file_patterns = self._config.get_string_list('General/lrc-filename',
+                                                           DEFAULT_FILE_PATTERNS)
+        self._path_patterns = self._config.get_string_list('General/lrc-path',
+                                                           DEFAULT_PATH_PATTERNS)
+        self._update_index_roots()
+
+    def _update_index_roots(self):
+        """ Indexes the directories of the path patterns, which may depend on
+        the current metadata
+        """
+        roots = []
+        for path_pat in self._path_patterns:
+            # The directory of the music file is different for each track
+            if path_pat == '%':
+                continue
+            try:
+                roots.append(expand_path(path_pat, self._metadata))
+            except osdlyrics.pattern.PatternException:
+                continue
+        self._index.set_roots(roots)
 
     def find_lrc_from_db(self, metadata):
         uri = self._db.find(metadata)
@@ -282,43 +552,119 @@ class LyricsService(dbus.service.Object):
         if metadata == self._metadata:
             self.CurrentLyricsChanged()
 
-    @dbus.service.method(dbus_interface=LYRICS_INTERFACE,
-                         in_signature='a{sv}',
-                         out_signature='bsa{ss}aa{sv}')
-    def GetLyrics(self, metadata):
-        ret, uri, content = self.GetRawLyrics(metadata)
-        if ret:
-            attr, lines = osdlyrics.lrc.parse_lrc(content)
-            return ret, uri, attr, lines
-        else:
-            return ret, uri, {}, []
+    def _load_entry(self, uri):
+        """
+        Loads the LRC file of uri, reusing the cached entry if the file is not
+        changed.
 
-    @dbus.service.method(dbus_interface=LYRICS_INTERFACE,
-                         in_signature='a{sv}',
-                         out_signature='bss')
-    def GetRawLyrics(self, metadata):
+        Returns the LrcCacheEntry of the file, or None if failed to load.
+        """
+        key = lrc_cache_key(uri)
+        entry = self._parsed_cache.get(key) if key else None
+        if entry is None:
+            content = load_from_uri(uri, self._db)
+            if content is None:
+                return None
+            entry = LrcCacheEntry(content)
+            if key:
+                self._parsed_cache.put(key, entry)
+        self._content_hashes.put(uri, entry.hash)
+        return entry
+
+    def _find_offset(self, uri):
+        """
+        Returns the offset of the LRC file of uri set by SetOffset, or None if
+        not set for its current content.
+        """
+        hash_ = self._content_hashes.get(uri)
+        if hash_ is None:
+            return None
+        return self._db.find_offset(uri, hash_)
+
+    def load_lyrics(self, uri):
+        """
+        Loads the content of the LRC file of uri, reusing the cached content if
+        the file is not changed. The offset set by SetOffset is applied.
+
+        Returns None if failed to load.
+        """
+        entry = self._load_entry(uri)
+        if entry is None:
+            return None
+        content = entry.content
+        offset = self._find_offset(uri)
+        if offset is not None:
+            content = update_lrc_offset(content, offset)
+        return content
+
+    def load_parsed_lyrics(self, uri):
+        """
+        Loads and parses the LRC file of uri, reusing the cached result if the
+        file is not changed. The offset set by SetOffset is applied to the
+        attributes.
+
+        Returns the (attrs, lines) tuple of osdlyrics.lrc.parse_lrc_lines, or
+        None if failed to load.
+        """
+        entry = self._load_entry(uri)
+        if entry is None:
+            return None
+        attrs, lines = entry.parsed
+        offset = self._find_offset(uri)
+        if offset is not None:
+            # The cached attributes are shared and must not be modified
+            attrs = dict(attrs, offset=str(offset))
+        return attrs, lines
+
+    def find_lyrics(self, metadata, load, empty):
+        """
+        Finds the LRC file of metadata and loads it.
+
+        Arguments:
+        - `load`: A function to load the content from an URI, which returns
+          None if failed to load.
+        - `empty`: The content of the 'none:' URI, which means no lyrics are
+          shown for the track.
+
+        Return values: found, uri, content
+        """
         if isinstance(metadata, dict):
             metadata = Metadata.from_dict(metadata)
         uri = self.find_lrc_from_db(metadata)
         lrc = None
         if uri:
             if uri == 'none:':
-                return True, uri, ''
-            lrc = load_from_uri(uri)
+                return True, uri, empty
+            lrc = load(uri)
             if lrc is not None:
                 return True, uri, lrc
         uri = self.find_lrc_by_pattern(metadata)
         if uri:
-            lrc = load_from_uri(uri)
+            lrc = load(uri)
             if lrc is not None:
                 logging.info("LRC for track %s not found in db but found by pattern: %s", metadata_description(metadata), uri)
         if lrc is None:
             logging.info("LRC for track %s not found", metadata_description(metadata))
-            return False, '', ''
+            return False, '', empty
         else:
             logging.info("LRC for track %s found: %s", metadata_description(metadata), uri)
             return True, uri, lrc
 
+    @dbus.service.method(dbus_interface=LYRICS_INTERFACE,
+                         in_signature='a{sv}',
+                         out_signature='bsa{ss}aa{sv}')
+    def GetLyrics(self, metadata):
+        ret, uri, (attr, lines) = self.find_lyrics(metadata,
+                                                   self.load_parsed_lyrics,
+                                                   ({}, []))
+        return ret, uri, attr, osdlyrics.lrc.lines_to_dicts(lines)
+
+    @dbus.service.method(dbus_interface=LYRICS_INTERFACE,
+                         in_signature='a{sv}',
+                         out_signature='bss')
+    def GetRawLyrics(self, metadata):
+        return self.find_lyrics(metadata, self.load_lyrics, '')
+
     @dbus.service.method(dbus_interface=LYRICS_INTERFACE,
                          in_signature='',
                          out_signature='bsa{ss}aa{sv}')
@@ -363,12 +709,37 @@ class LyricsService(dbus.service.Object):
     def SetOffset(self, uri, offset_ms):
         if not is_valid_uri(uri):
             raise InvalidUriException(uri)
-        content = load_from_uri(uri)
+        hash_ = self._content_hashes.get(uri)
+        if hash_ is None:
+            entry = self._load_entry(uri)
+            if entry is None:
+                raise CannotLoadLrcException(uri)
+            hash_ = entry.hash
+        self._db.assign_offset(uri, hash_, offset_ms)
+        if self._config.get_bool('General/save-offset-to-file', False):
+            self._export_offset(uri, offset_ms)
+
+    def _export_offset(self, uri, offset_ms):
+        """ Writes the offset into the LRC file of uri
+        """
+        content = load_from_uri(uri, self._db)
         if content is None:
             raise CannotLoadLrcException(uri)
-        content = update_lrc_offset(content, offset_ms).encode('utf-8')
-        if not save_to_uri(uri, content, True):
+        content = update_lrc_offset(content, offset_ms)
+        if not save_to_uri(uri, content.encode('utf-8'), True):
             raise CannotSaveLrcException(uri)
+        hash_ = content_hash(content)
+        self._content_hashes.put(uri, hash_)
+        self._db.assign_offset(uri, hash_, offset_ms)
+        # The file is rewritten in UTF-8, no need to detect it on next load
+        url_parts = urllib.parse.urlparse(uri)
+        if url_parts.scheme == 'file':
+            path = urllib.request.url2pathname(url_parts.path)
+            try:
+                mtime = os.stat(path).st_mtime_ns
+            except OSError:
+                return
+            self._db.assign_encoding(path, mtime, encoding='utf-8', elapsed=0.0)
 
     def _save_to_patterns(self, metadata, content):
         """ Save content to file expanded from given patterns
@@ -377,49 +748,27 @@ class LyricsService(dbus.service.Object):
         - `metadata`:
         - `content`:
         """
-        file_patterns = self._config.get_string_list('General/lrc-filename',
-                                                     DEFAULT_FILE_PATTERNS)
-        path_patterns = self._config.get_string_list('General/lrc-path',
-                                                     DEFAULT_PATH_PATTERNS)
-        for path_pat in path_patterns:
-            try:
-                path = expand_path(path_pat, metadata)
-            except osdlyrics.pattern.PatternException:
-                continue
-            for file_pat in file_patterns:
-                try:
-                    filename = expand_file(file_pat, metadata)
-                except osdlyrics.pattern.PatternException:
-                    continue
-                fullpath = os.path.join(path, filename + '.lrc')
-                uri = osdlyrics.utils.path2uri(fullpath)
-                if save_to_uri(uri, content):
-                    return uri
+        for path, name in expand_lrc_names(metadata, self._path_patterns,
+                                           self._file_patterns):
+            fullpath = os.path.join(path, name)
+            uri = osdlyrics.utils.path2uri(fullpath)
+            if save_to_uri(uri, content):
+                self._index.add_file(fullpath)
+                return uri
         return ''
 
     def _expand_patterns(self, metadata):
-        file_patterns = self._config.get_string_list('General/lrc-filename',
-                                                     DEFAULT_FILE_PATTERNS)
-        path_patterns = self._config.get_string_list('General/lrc-path',
-                                                     DEFAULT_PATH_PATTERNS)
-        for path_pat in path_patterns:
-            try:
-                path = expand_path(path_pat, metadata)
-            except osdlyrics.pattern.PatternException:
-                continue
-            for file_pat in file_patterns:
-                try:
-                    filename = expand_file(file_pat, metadata)
-                except osdlyrics.pattern.PatternException:
-                    continue
-                fullpath = os.path.join(path, filename + '.lrc')
-                if os.path.isfile(fullpath):
-                    return fullpath
+        for path, name in expand_lrc_names(metadata, self._path_patterns,
+                                           self._file_patterns):
+            fullpath = self._index.find(path, name)
+            if fullpath:
+                return fullpath
         return None
 
     def set_current_metadata(self, metadata):
         logging.info('Setting current metadata: %s', metadata)
         self._metadata = metadata
+        self._update_index_roots()
 
 
 def doc_test():
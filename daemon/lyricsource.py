@@ -19,12 +19,17 @@
 #
 
 import logging
+import time
 
 import dbus
+from gi.repository import GLib
 
 import osdlyrics.config
 from osdlyrics.consts import (LYRIC_SOURCE_PLUGIN_INTERFACE,
                               LYRIC_SOURCE_PLUGIN_OBJECT_PATH_PREFIX)
+from osdlyrics.metadata import Metadata
+
+import lrcdb
 
 LYRIC_SOURCE_INTERFACE = 'org.osdlyrics.LyricSource'
 LYRIC_SOURCE_OBJECT_PATH = '/org/osdlyrics/LyricSource'
@@ -34,6 +39,17 @@ STATUS_SUCCESS = 0
 STATUS_CANCELLED = 1
 STATUS_FAILURE = 2
 
+# Seconds to wait for all sources in a parallel search
+DEFAULT_SEARCH_DEADLINE = 10
+
+# Hours to use the cached search results of a source without searching it
+# again, for results that find lyrics and that find nothing respectively
+DEFAULT_SEARCH_CACHE_TTL = 168
+DEFAULT_SEARCH_CACHE_MISS_TTL = 24
+
+# Seconds to keep cached search results, older ones are deleted on startup
+SEARCH_CACHE_MAX_AGE = 90 * 24 * 3600
+
 
 def validateticket(component):
     def decorator(func):
@@ -61,6 +77,13 @@ class LyricSource(dbus.service.Object):
         self._n_search_tickets = 0
         self._download_tasks = {}
         self._n_download_tickets = 0
+        # Searches refreshing expired cached results: ticket -> cache key
+        self._refresh_tasks = {}
+        self._cache_hits = 0
+        self._cache_stale_hits = 0
+        self._cache_misses = 0
+        self._db = lrcdb.LrcDb()
+        self._db.delete_search_results(before=time.time() - SEARCH_CACHE_MAX_AGE)
         self._detect_sources()
         self._config = osdlyrics.config.Config(conn)
 
@@ -115,14 +138,28 @@ class LyricSource(dbus.service.Object):
                      source_id, ticket, status, len(results))
         source = self._sources[source_id]
         myticket = source['search'].pop(ticket)
+        if myticket in self._refresh_tasks:
+            cache_key = self._refresh_tasks.pop(myticket)
+            if status == STATUS_SUCCESS:
+                self._cache_results(source_id, cache_key, results)
+            return
         if myticket not in self._search_tasks:
             return
+        cache_key = self._search_tasks[myticket]['cache_key']
+        if status == STATUS_SUCCESS and cache_key is not None:
+            self._cache_results(source_id, cache_key, results)
+        self._source_search_complete(myticket, source_id, status, results)
+
+    def _source_search_complete(self, myticket, source_id, status, results):
+        if self._search_tasks[myticket]['parallel']:
+            self._parallel_search_complete(myticket, source_id, status, results)
+            return
         if status == STATUS_SUCCESS:
             mytask = self._search_tasks[myticket]
             mytask['failure'] = False
         if (status == STATUS_SUCCESS and results) or \
                 status == STATUS_CANCELLED:
-            self.SearchComplete(myticket, status, results)
+            self._complete_search(myticket, status, results)
         else:  # STATUS_FAILURE
             mytask = self._search_tasks[myticket]
             # mytask['failure'] is set to True only when all sources fail to search.
@@ -134,7 +171,7 @@ class LyricSource(dbus.service.Object):
                 mytask['failure'] = True
             if not mytask['sources'] or mytask['sources'][0] != source_id:
                 logging.warning('Error, no source exists or source id mismatch with current id')
-                self.SearchComplete(myticket, STATUS_FAILURE, results)
+                self._complete_search(myticket, STATUS_FAILURE, results)
             else:
                 mytask['sources'].pop(0)
                 self._do_search(myticket)
@@ -186,18 +223,201 @@ class LyricSource(dbus.service.Object):
                 task['sources'].pop(0)
         if nextsource is None:
             status = STATUS_SUCCESS if not task['failure'] else STATUS_FAILURE
-            self.SearchComplete(ticket, status, [])
+            self._complete_search(ticket, status, [])
         else:
-            newticket = self._get_source_proxy(nextsource).Search(task['metadata'])
-            self._set_source_search(nextsource, newticket, ticket)
-            task['ticket'] = newticket
+            results = self._find_cached_results(nextsource, task)
+            if results is None:
+                newticket = self._get_source_proxy(nextsource).Search(task['metadata'])
+                self._set_source_search(nextsource, newticket, ticket)
+                task['ticket'] = newticket
+            else:
+                task['ticket'] = None
+                task['cached'][nextsource] = GLib.idle_add(self._cached_search_complete,
+                                                           ticket, nextsource, results)
             self.SearchStarted(ticket, nextsource, self._sources[nextsource]['name'])
 
+    def _find_cached_results(self, source_id, task):
+        """ Returns the cached results of searching the source for the task, or
+        None if not cached.
+
+        Expired results are returned as well, and the source is searched again
+        in background to refresh them.
+        """
+        if task['cache_key'] is None:
+            return None
+        cached = self._db.find_search_results(source_id, task['cache_key'])
+        if cached is None:
+            self._cache_misses += 1
+            return None
+        results, searched = cached
+        if results:
+            ttl = self._config.get_int('Download/search-cache-ttl',
+                                       DEFAULT_SEARCH_CACHE_TTL)
+        else:
+            ttl = self._config.get_int('Download/search-cache-miss-ttl',
+                                       DEFAULT_SEARCH_CACHE_MISS_TTL)
+        if ttl <= 0:
+            # Caching is disabled
+            self._cache_misses += 1
+            return None
+        if time.time() - searched > ttl * 3600:
+            self._cache_stale_hits += 1
+            self._refresh_search(source_id, task)
+        else:
+            self._cache_hits += 1
+        logging.debug('Found %d cached search results from %s', len(results), source_id)
+        return results
+
+    def _refresh_search(self, source_id, task):
+        self._n_search_tickets += 1
+        ticket = self._n_search_tickets
+        try:
+            sourceticket = self._get_source_proxy(source_id).Search(task['metadata'])
+        except dbus.exceptions.DBusException as e:
+            logging.warning('Fail to refresh search results of source %s: %s', source_id, e)
+            return
+        self._set_source_search(source_id, sourceticket, ticket)
+        self._refresh_tasks[ticket] = task['cache_key']
+
+    def _cache_results(self, source_id, cache_key, results):
+        self._db.assign_search_results(source_id, cache_key, list(results), time.time())
+
+    def _cached_search_complete(self, ticket, source_id, results):
+        """ Completes the search of a source with cached results. This is done
+        in an idle callback, so that the results are not emitted before the
+        ticket is returned by Search.
+        """
+        task = self._search_tasks.get(ticket)
+        if task is None:
+            return False
+        task['cached'].pop(source_id, None)
+        if task['parallel']:
+            pending = source_id in task['tickets']
+        else:
+            pending = task['ticket'] is None and task['sources'][:1] == [source_id]
+        if pending:
+            self._source_search_complete(ticket, source_id, STATUS_SUCCESS, results)
+        return False
+
+    def _do_parallel_search(self, ticket):
+        """ Sends the search request to all sources of the task at once
+        """
+        task = self._search_tasks[ticket]
+        for source_id in task['sources']:
+            if source_id not in self._sources:
+                logging.warning('Source %s not exist', source_id)
+                continue
+            results = self._find_cached_results(source_id, task)
+            if results is not None:
+                # Completed once Search returns the ticket
+                task['tickets'][source_id] = None
+                task['cached'][source_id] = GLib.idle_add(self._cached_search_complete,
+                                                          ticket, source_id, results)
+                self.SearchStarted(ticket, source_id, self._sources[source_id]['name'])
+                continue
+            try:
+                newticket = self._get_source_proxy(source_id).Search(task['metadata'])
+            except dbus.exceptions.DBusException as e:
+                logging.warning('Fail to search from source %s: %s', source_id, e)
+                if task['failure'] is not False:
+                    task['failure'] = True
+                continue
+            self._set_source_search(source_id, newticket, ticket)
+            task['tickets'][source_id] = newticket
+            self.SearchStarted(ticket, source_id, self._sources[source_id]['name'])
+        if not task['tickets']:
+            self._finish_parallel_search(ticket)
+            return
+        deadline = self._config.get_int('Download/search-deadline',
+                                        DEFAULT_SEARCH_DEADLINE)
+        task['deadline'] = GLib.timeout_add_seconds(max(deadline, 1),
+                                                    self._search_deadline_cb,
+                                                    ticket)
+
+    def _parallel_search_complete(self, ticket, source_id, status, results):
+        task = self._search_tasks[ticket]
+        task['tickets'].pop(source_id, None)
+        if status == STATUS_SUCCESS:
+            task['failure'] = False
+            if results:
+                task['results'][source_id] = results
+                self.SearchPartialResults(ticket, source_id, results)
+        elif status == STATUS_FAILURE and task['failure'] is not False:
+            # See comments in search_complete_cb()
+            task['failure'] = True
+        if not task['tickets'] or self._has_best_results(task):
+            self._finish_parallel_search(ticket)
+
+    @staticmethod
+    def _has_best_results(task):
+        """ Returns whether a source has returned results, and all the sources
+        ranked before it have finished.
+
+        The remaining sources can only add results ranked after them, so the
+        search is finished without waiting for them, as fast as a sequential
+        search is.
+        """
+        for source_id in task['sources']:
+            if task['results'].get(source_id):
+                return True
+            if source_id in task['tickets']:
+                return False
+        return False
+
+    def _search_deadline_cb(self, ticket):
+        task = self._search_tasks.get(ticket)
+        if task is not None:
+            task['deadline'] = None
+            logging.info('Search deadline reached, %d sources not finished: %s',
+                         len(task['tickets']), ', '.join(task['tickets']))
+            self._finish_parallel_search(ticket)
+        return False
+
+    def _finish_parallel_search(self, ticket, status=None):
+        """ Completes a parallel search with the results of finished sources,
+        ranked in the order of the sources of the task.
+
+        Unfinished sources are cancelled. Their tickets are kept until they
+        complete, and as the task is no longer registered then, the late
+        results are dropped silently.
+        """
+        task = self._search_tasks[ticket]
+        if task['deadline'] is not None:
+            GLib.source_remove(task['deadline'])
+            task['deadline'] = None
+        for source_id, sourceticket in task['tickets'].items():
+            if sourceticket is None:
+                # Cached results not applied yet
+                continue
+            try:
+                self._get_source_proxy(source_id).CancelSearch(sourceticket)
+            except dbus.exceptions.DBusException as e:
+                logging.warning('Fail to cancel search of source %s: %s', source_id, e)
+        task['tickets'] = {}
+        results = []
+        if status is None:
+            for source_id in task['sources']:
+                results.extend(task['results'].get(source_id, []))
+            status = STATUS_FAILURE if task['failure'] and not results else STATUS_SUCCESS
+        self._complete_search(ticket, status, results)
+
+    def _complete_search(self, ticket, status, results):
+        """ Unregisters a search task and emits SearchComplete for it.
+
+        Sources of the task completing later find no task, so that
+        SearchComplete is emitted only once for each task.
+        """
+        task = self._search_tasks.pop(ticket, None)
+        if task is None:
+            return
+        for idle_source in task['cached'].values():
+            GLib.source_remove(idle_source)
+        self.SearchComplete(ticket, status, results)
+
     @dbus.service.signal(dbus_interface=LYRIC_SOURCE_INTERFACE,
                          signature='iiaa{sv}')
     def SearchComplete(self, ticket, status, results):
-        if ticket in self._search_tasks:
-            del self._search_tasks[ticket]
+        pass
 
     @dbus.service.signal(dbus_interface=LYRIC_SOURCE_INTERFACE,
                          signature='iiay')
@@ -210,6 +430,11 @@ class LyricSource(dbus.service.Object):
     def SearchStarted(self, ticket, sourceid, sourcename):
         pass
 
+    @dbus.service.signal(dbus_interface=LYRIC_SOURCE_INTERFACE,
+                         signature='isaa{sv}')
+    def SearchPartialResults(self, ticket, sourceid, results):
+        pass
+
     @dbus.service.method(dbus_interface=LYRIC_SOURCE_INTERFACE,
                          in_signature='a{sv}as',
                          out_signature='i')
@@ -219,13 +444,34 @@ class LyricSource(dbus.service.Object):
         task = {
             'metadata': metadata,
             'sources': [str(id) for id in sources],
+            'cache_key': self._get_cache_key(metadata),
             'ticket': None,
             'failure': None,    # See comments in search_complete_cb()
+            'parallel': self._config.get_bool('Download/parallel-search', True),
+            'cached': {},       # source id -> idle source applying cached results
+            # The fields below are used by parallel searches only
+            'tickets': {},      # source id -> ticket of the source
+            'results': {},      # source id -> results of the source
+            'deadline': None,   # GLib source id of the deadline
         }
         self._search_tasks[ticket] = task
-        self._do_search(ticket)
+        if task['parallel']:
+            self._do_parallel_search(ticket)
+        else:
+            self._do_search(ticket)
         return ticket
 
+    @staticmethod
+    def _get_cache_key(metadata):
+        """ Returns the key of the search results of metadata in the cache, or
+        None if the search is not to be cached.
+        """
+        metadata = Metadata.from_dict(metadata)
+        if not metadata.title and not metadata.artist:
+            return None
+        return lrcdb.normalize_key(metadata.title, metadata.artist,
+                                   metadata.album, 0)
+
     @dbus.service.method(dbus_interface=LYRIC_SOURCE_INTERFACE,
                          in_signature='i',
                          out_signature='')
@@ -233,7 +479,14 @@ class LyricSource(dbus.service.Object):
         if ticket not in self._search_tasks:
             return
         task = self._search_tasks[ticket]
+        if task['parallel']:
+            self._finish_parallel_search(ticket, STATUS_CANCELLED)
+            return
         sourceticket = task['ticket']
+        if sourceticket is None:
+            # Completing with cached results
+            self._complete_search(ticket, STATUS_CANCELLED, [])
+            return
         sourceid = task['sources'][0]
         self._get_source_proxy(sourceid).CancelSearch(sourceticket)
 
@@ -266,6 +519,27 @@ class LyricSource(dbus.service.Object):
         sourceid = task['source']
         self._get_source_proxy(sourceid).CancelDownload(sourceticket)
 
+    @dbus.service.method(dbus_interface=LYRIC_SOURCE_INTERFACE,
+                         in_signature='s',
+                         out_signature='i')
+    def PurgeSearchCache(self, source_id):
+        count = self._db.delete_search_results(source=str(source_id) or None)
+        logging.info('Purged %d cached search results', count)
+        return count
+
+    @dbus.service.method(dbus_interface=LYRIC_SOURCE_INTERFACE,
+                         in_signature='',
+                         out_signature='a{sv}')
+    def GetSearchCacheStats(self):
+        found, not_found = self._db.count_search_results()
+        return {
+            'hits': dbus.UInt32(self._cache_hits),
+            'stale-hits': dbus.UInt32(self._cache_stale_hits),
+            'misses': dbus.UInt32(self._cache_misses),
+            'found': dbus.UInt32(found),
+            'not-found': dbus.UInt32(not_found),
+        }
+
     @dbus.service.method(dbus_interface=LYRIC_SOURCE_INTERFACE,
                          in_signature='',
                          out_signature='aa{sv}')
@@ -277,3 +551,102 @@ class LyricSource(dbus.service.Object):
         ]
         order = {id: i for i, id in enumerate(enabled)}
         return sorted(sources, key=lambda it: (-it['enabled'], order.get(it['id'], 1 << 31)))
+
+
+def test():
+    """
+    Parallel searches emit SearchComplete once, and drop the results of the
+    sources completing after it.
+
+    >>> class FakeSourceProxy:
+    ...     def __init__(self):
+    ...         self.cancelled = []
+    ...     def Search(self, metadata):
+    ...         return len(self.cancelled) + 100
+    ...     def CancelSearch(self, ticket):
+    ...         self.cancelled.append(ticket)
+    >>> class FakeConfig:
+    ...     def get_bool(self, key, default=None):
+    ...         return default
+    ...     def get_int(self, key, default=None):
+    ...         return default
+    >>> lyric_source = LyricSource.__new__(LyricSource)
+    >>> lyric_source._sources = {
+    ...     id: {'proxy': FakeSourceProxy(), 'name': id, 'id': id,
+    ...          'search': {}, 'download': {}}
+    ...     for id in ('a', 'b')}
+    >>> lyric_source._search_tasks = {}
+    >>> lyric_source._n_search_tickets = 0
+    >>> lyric_source._refresh_tasks = {}
+    >>> lyric_source._config = FakeConfig()
+    >>> signals = []
+    >>> for name in ('SearchStarted', 'SearchPartialResults', 'SearchComplete'):
+    ...     setattr(lyric_source, name,
+    ...             lambda *args, name=name: signals.append((name,) + args[:3]))
+
+    A source answering after the deadline:
+
+    >>> lyric_source.Search({}, ['a', 'b'])
+    1
+    >>> lyric_source.search_complete_cb('b', 100, STATUS_SUCCESS, [{'title': 'b'}])
+    >>> lyric_source._search_deadline_cb(1)
+    False
+    >>> lyric_source._sources['a']['proxy'].cancelled
+    [100]
+    >>> lyric_source.search_complete_cb('a', 100, STATUS_SUCCESS, [{'title': 'a'}])
+    >>> for signal in signals:
+    ...     print(signal)
+    ('SearchStarted', 1, 'a', 'a')
+    ('SearchStarted', 1, 'b', 'b')
+    ('SearchPartialResults', 1, 'b', [{'title': 'b'}])
+    ('SearchComplete', 1, 0, [{'title': 'b'}])
+
+    The search completes as soon as the first source returns results:
+
+    >>> del signals[:]
+    >>> lyric_source.Search({}, ['a', 'b'])
+    2
+    >>> lyric_source.search_complete_cb('a', 101, STATUS_SUCCESS, [{'title': 'a'}])
+    >>> lyric_source.search_complete_cb('b', 100, STATUS_SUCCESS, [{'title': 'b'}])
+    >>> signals[-1]
+    ('SearchComplete', 2, 0, [{'title': 'a'}])
+    >>> len(lyric_source._sources['b']['proxy'].cancelled)
+    1
+
+    Sources answering after the search is cancelled:
+
+    >>> del signals[:]
+    >>> lyric_source.Search({}, ['a', 'b'])
+    3
+    >>> lyric_source.CancelSearch(3)
+    >>> lyric_source.search_complete_cb('a', 101, STATUS_CANCELLED, [])
+    >>> lyric_source.search_complete_cb('b', 101, STATUS_SUCCESS, [{'title': 'b'}])
+    >>> [signal for signal in signals if signal[0] != 'SearchStarted']
+    [('SearchComplete', 3, 1, [])]
+    >>> lyric_source._search_tasks
+    {}
+
+    A sequential search with cached results, cancelled before the results
+    are applied:
+
+    >>> class FakeDb:
+    ...     def find_search_results(self, source, info_key):
+    ...         return [{'title': source}], time.time()
+    >>> lyric_source._db = FakeDb()
+    >>> lyric_source._cache_hits = lyric_source._cache_stale_hits = 0
+    >>> lyric_source._config.get_bool = lambda key, default=None: False
+    >>> del signals[:]
+    >>> lyric_source.Search({'title': 'Title'}, ['a'])
+    4
+    >>> lyric_source.CancelSearch(4)
+    >>> lyric_source._cached_search_complete(4, 'a', [{'title': 'a'}])
+    False
+    >>> signals
+    [('SearchStarted', 4, 'a', 'a'), ('SearchComplete', 4, 1, [])]
+    """
+    import doctest
+    doctest.testmod()
+
+
+if __name__ == '__main__':
+    test()
@@ -21,10 +21,68 @@
 import logging
 
 import dbus
+import dbus.exceptions
 
 from .consts import CONFIG_BUS_NAME, CONFIG_OBJECT_PATH
+from .errors import BaseError
 
 CONFIG_INTERFACE = 'org.osdlyrics.Config'
+VALUE_NOT_EXIST_ERROR = 'org.osdlyrics.Error.ValueNotExist'
+
+# The strings of boolean values in the config file, which are the ones
+# accepted by configparser
+BOOLEAN_STATES = {'1': True, 'yes': True, 'true': True, 'on': True,
+                  '0': False, 'no': False, 'false': False, 'off': False}
+
+
+class ValueNotExistError(BaseError):
+    def __init__(self, key=''):
+        super().__init__('Value of key %s does not exist' % key)
+
+
+def to_bool(value):
+    """
+    Converts a string in the config file to a boolean value.
+
+    >>> to_bool('True'), to_bool('0')
+    (True, False)
+    >>> to_bool('maybe')
+    Traceback (most recent call last):
+        ...
+    ValueError: Not a boolean: maybe
+    """
+    try:
+        return BOOLEAN_STATES[value.lower()]
+    except KeyError:
+        raise ValueError('Not a boolean: %s' % value)
+
+
+def to_config_string(value):
+    r"""
+    Converts a value from D-Bus to the string in the config file.
+
+    >>> to_config_string(True), to_config_string(3), to_config_string(0.5)
+    ('true', '3', '0.5')
+    >>> to_config_string(['a;b', 'c'])
+    'a\\;b;c;'
+    """
+    if isinstance(value, (bool, dbus.Boolean)):
+        return 'true' if value else 'false'
+    if isinstance(value, list):
+        return join(value)
+    return str(value)
+
+
+def cache_key(key):
+    """
+    Returns the key of a value in the result of GetAllValues, where the option
+    names are in lower case.
+
+    >>> cache_key('OSD/Font-Name')
+    'OSD/font-name'
+    """
+    section, sep, name = key.partition('/')
+    return section + sep + name.lower()
 
 
 class Config:
@@ -35,6 +93,10 @@ class Config:
     to the key is set to the default value, and returns it. If no default value
     specified and the key does not exist, raise an exception.
 
+    Values are cached, so that getting them doesn't take a D-Bus call. The cache
+    is loaded with GetAllValues, and the values that are changed are got again
+    one by one.
+
     Values can be monitored by connect_change function.
     """
 
@@ -50,83 +112,118 @@ class Config:
         self._proxy = dbus.Interface(self._proxy,
                                      CONFIG_INTERFACE)
         self._signals = {}
+        # The values by cache_key(), or None if they are to be loaded
+        self._values = None
+        # False if the config service doesn't support GetAllValues
+        self._cache_enabled = True
+        self._hits = 0
+        self._misses = 0
         self._proxy.connect_to_signal('ValueChanged',
                                       self._value_changed_cb)
+        if follow_name_owner_changes:
+            conn.watch_name_owner(CONFIG_BUS_NAME, self._name_owner_changed_cb)
 
-    def get_bool(self, key, default=None):
+    def _load_values(self):
+        """ Returns the cached values, loading them if needed
+
+        Returns None if the values cannot be cached.
+        """
+        if self._values is None and self._cache_enabled:
+            try:
+                self._values = dict(self._proxy.GetAllValues())
+            except dbus.exceptions.DBusException as e:
+                if e.get_dbus_name() == 'org.freedesktop.DBus.Error.UnknownMethod':
+                    logging.info('Config service does not support GetAllValues, '
+                                 'config values are not cached')
+                    self._cache_enabled = False
+                else:
+                    logging.warning('Cannot load config values: %s', e)
+                return None
+            total = self._hits + self._misses
+            logging.debug('Config values loaded, cache hits: %d/%d (%.1f%%)',
+                          self._hits, total, self._hits * 100.0 / max(total, 1))
+        return self._values
+
+    def _get(self, key, default, getter, setter, convert):
+        """ Gets a value from the cache, or with the getter method of the proxy
+        if the values are not cached
+        """
         try:
-            return self._proxy.GetBool(key)
+            # The get that loads the values takes a D-Bus call as a miss does
+            loaded = self._values is not None
+            values = self._load_values()
+            if values is None:
+                self._misses += 1
+                return getter(key)
+            if loaded:
+                self._hits += 1
+            else:
+                self._misses += 1
+            try:
+                return convert(values[cache_key(key)])
+            except KeyError:
+                raise ValueNotExistError(key)
         except Exception as e:
             if default is not None:
                 try:
-                    self._proxy.SetBool(key, default)
+                    setter(key, default)
                 except Exception:
                     pass
                 return default
             raise e
 
+    def _refresh_values(self, keys):
+        """ Gets the values of keys again, so that changing a few values doesn't
+        load all of them on the next get
+        """
+        for key in keys:
+            if self._values is None:
+                return
+            try:
+                self._values[cache_key(key)] = str(self._proxy.GetString(key))
+            except dbus.exceptions.DBusException as e:
+                if e.get_dbus_name() == VALUE_NOT_EXIST_ERROR:
+                    self._values.pop(cache_key(key), None)
+                else:
+                    logging.warning('Cannot get config value %s: %s', key, e)
+                    self._values = None
+
+    def _set(self, setter, key, value):
+        setter(key, value)
+        # The config service stores the value as to_config_string() does
+        if self._values is not None:
+            self._values[cache_key(key)] = to_config_string(value)
+
+    def get_bool(self, key, default=None):
+        return self._get(key, default, self._proxy.GetBool, self.set_bool, to_bool)
+
     def set_bool(self, key, value):
-        self._proxy.SetBool(key, value)
+        self._set(self._proxy.SetBool, key, value)
 
     def get_int(self, key, default=None):
-        try:
-            return self._proxy.GetInt(key)
-        except Exception as e:
-            if default is not None:
-                try:
-                    self._proxy.SetInt(key, default)
-                except Exception:
-                    pass
-                return default
-            raise e
+        return self._get(key, default, self._proxy.GetInt, self.set_int, int)
 
     def set_int(self, key, value):
-        self._proxy.SetInt(key, value)
+        self._set(self._proxy.SetInt, key, value)
 
     def get_double(self, key, default=None):
-        try:
-            return self._proxy.GetDouble(key)
-        except Exception as e:
-            if default is not None:
-                try:
-                    self._proxy.SetBool(key, default)
-                except Exception:
-                    pass
-                return default
-            raise e
+        return self._get(key, default, self._proxy.GetDouble, self.set_double, float)
 
     def set_double(self, key, value):
-        self._proxy.SetDouble(key, value)
+        self._set(self._proxy.SetDouble, key, value)
 
     def get_string(self, key, default=None):
-        try:
-            return self._proxy.GetString(key)
-        except Exception as e:
-            if default is not None:
-                try:
-                    self._proxy.SetString(key, default)
-                except Exception:
-                    pass
-                return default
-            raise e
+        return self._get(key, default, self._proxy.GetString, self.set_string, str)
 
     def set_string(self, key, value):
-        self._proxy.SetString(key, value)
+        self._set(self._proxy.SetString, key, value)
 
     def get_string_list(self, key, default=None):
-        try:
-            return self._proxy.GetStringList(key)
-        except Exception as e:
-            if default is not None:
-                try:
-                    self._proxy.SetStringList(key, default)
-                except Exception:
-                    pass
-                return default
-            raise e
+        return self._get(key, default, self._proxy.GetStringList,
+                         self.set_string_list, split)
 
     def set_string_list(self, key, value):
-        self._proxy.SetStringList(key, value)
+        self._set(self._proxy.SetStringList, key, value)
 
     def connect_change(self, key, func):
         """
@@ -150,10 +247,83 @@ class Config:
                 self._signals[key].remove(func)
 
     def _value_changed_cb(self, name_list):
+        # Update the values before the handlers get them
+        self._refresh_values(name_list)
         for name in name_list:
             for handler in self._signals.get(name, []):
                 handler(name)
 
+    def _name_owner_changed_cb(self, name_owner):
+        # A new config service may support caching
+        self._values = None
+        self._cache_enabled = True
+
+
+def split(value, sep=';'):
+    r"""
+    >>> split('')
+    []
+    >>> split(' ')
+    [' ']
+    >>> split('single')
+    ['single']
+    >>> split('one;two')
+    ['one', 'two']
+    >>> split('one;')
+    ['one']
+    >>> split(';one;two;')
+    ['', 'one', 'two']
+    >>> split(r'one\;two;three\\;four')
+    ['one;two', 'three\\', 'four']
+    >>> split(r'\one\\\;two;\\three\\\\;four;')
+    ['\\one\\;two', '\\three\\\\', 'four']
+    >>> split('; ')
+    ['', ' ']
+    """
+    start = 0
+    ret = []
+    item = []
+    curr = 0
+    while curr <= len(value):
+        if curr == len(value) or value[curr] == sep:
+            if start < curr:
+                item.append(value[start:curr])
+            if curr != len(value) or item:
+                ret.append(''.join(item))
+            item = []
+            start = curr + 1
+        elif value[curr] == '\\' and curr < len(value) - 1:
+            tag = value[curr + 1]
+            if tag == '\\' or tag == sep:
+                item.append(value[start:curr])
+                start = curr + 1
+                curr = start
+        curr = curr + 1
+    return ret
+
+
+def join(values, sep=';'):
+    r"""
+    >>> join([])
+    ''
+    >>> join([''])
+    ';'
+    >>> join(['one'])
+    'one;'
+    >>> join(['one', 'two'])
+    'one;two;'
+    >>> join(['one;', 'two'])
+    'one\\;;two;'
+    >>> print(join([r'on\e', 't;wo']))
+    on\\e;t\;wo;
+    """
+    if not values:
+        return ''
+    result = []
+    for item in values:
+        result.append(item.replace('\\', '\\\\').replace(sep, '\\;'))
+    return sep.join(result) + sep
+
 
 def test():
     def value_changed(name):
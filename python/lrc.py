@@ -18,6 +18,7 @@
 # along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
 #
 
+from operator import itemgetter
 import re
 
 import dbus.types
@@ -28,12 +29,25 @@ __all__ = (
     'StringToken',
     'tokenize',
     'parse_lrc',
+    'parse_lrc_lines',
+    'lines_to_dicts',
 )
 
 
-LINE_PATTERN = re.compile(r'(\[[^\[]*?\])')
-TIMESTAMP_PATTERN = re.compile(r'^\[(\d+(:\d+){0,2}(\.\d+)?)\]$')
-ATTR_PATTERN = re.compile(r'^\[([\w\d]+):(.*)\]$')
+# The characters str.splitlines() breaks lines at
+LINE_BREAKS = '\n\r\v\f\x1c\x1d\x1e\x85\u2028\u2029'
+
+# Matches one token at a time: a time tag, an attribute tag, or the text
+# remaining in the line along with the line break. Tags are only recognized
+# at the beginning of a line because the text alternative consumes the rest
+# of the line. As most lines have a single time tag, a time tag followed by
+# text also consumes the text as `line_text`, saving one match for the line.
+TOKEN_PATTERN = re.compile(
+    r'\[(?:(?:(?P<hour>\d+):)?(?P<minute>\d+):)?(?P<second>\d+)'
+    r'(?:\.(?P<fraction>\d+))?\]'
+    r'(?:(?P<line_text>[^\[%(breaks)s][^%(breaks)s]*|)(?:\r\n|[%(breaks)s]|\Z))?'
+    r'|\[(?P<key>\w+):(?P<value>[^\[\]%(breaks)s]*)\]'
+    r'|(?P<text>[^%(breaks)s]*)(?:\r\n|[%(breaks)s]|\Z)' % {'breaks': LINE_BREAKS})
 
 
 class AttrToken:
@@ -89,41 +103,83 @@ def tokenize(content):
 
     Arguments:
     - `content`: UTF8 string, the content to be tokenized
+
+    >>> tokenize('[ti:a][00:01.5][1]x\\n[bad]y')
+    [{ti: a}, [1500], [1000], "x"
+    , "[bad]y"
+    ]
     """
-    def parse_tag(tag):
-        m = TIMESTAMP_PATTERN.match(tag)
-        if m:
-            return TimeToken(m.group(1))
-        m = ATTR_PATTERN.match(tag)
-        if m:
-            return AttrToken(m.group(1), m.group(2))
-        return None
-
-    def tokenize_line(line):
-        pos = 0
-        tokens = []
-        while pos < len(line) and line[pos] == '[':
-            has_tag = False
-            m = LINE_PATTERN.search(line, pos)
-            if m and m.start() == pos:
-                tag = m.group()
-                token = parse_tag(tag)
-                if token:
-                    tokens.append(token)
-                    has_tag = True
-                    pos = m.end()
-            if not has_tag:
-                break
-        tokens.append(StringToken(line[pos:]))
-        return tokens
-
-    lines = content.splitlines()
     tokens = []
-    for line in lines:
-        tokens.extend(tokenize_line(line))
+    line_start = True
+    for match in TOKEN_PATTERN.finditer(content):
+        if match.group('second') is not None:
+            tag_end = match.end('fraction') if match.group('fraction') else match.end('second')
+            tokens.append(TimeToken(content[match.start() + 1:tag_end]))
+            line_start = False
+            if match.group('line_text') is not None:
+                tokens.append(StringToken(match.group('line_text')))
+                line_start = True
+        elif match.group('key') is not None:
+            tokens.append(AttrToken(match.group('key'), match.group('value')))
+            line_start = False
+        elif not line_start or match.start() < len(content):
+            # The empty text matched at the end of content is not a line
+            tokens.append(StringToken(match.group('text')))
+            line_start = True
     return tokens
 
 
+def parse_lrc_lines(content):
+    """
+    Parse an lrc file into plain Python objects
+
+    Arguments:
+    - `content`: LRC file content as a str
+
+    Return values: attrs, lines
+    - `attrs`: A dict represents attributes in LRC file
+    - `lines`: A list of (timestamp, text) tuples sorted in ascending order by
+      timestamp. Lines with the same timestamp keep their order in the file.
+
+    >>> parse_lrc_lines('[ar:b][00:02][00:01.20]x\\r\\n[00:01]y\\n[00:03]')
+    ({'ar': 'b'}, [(1000, 'y'), (1200, 'x'), (2000, 'x'), (3000, '')])
+    """
+    attrs = {}
+    lines = []
+    # Time tags waiting for the text of the line
+    timestamps = []
+    append = lines.append
+    for (hour, minute, second, fraction, line_text,
+         key, value, text) in map(re.Match.groups, TOKEN_PATTERN.finditer(content)):
+        if second is not None:
+            # Fractions of second are truncated to milliseconds
+            if fraction:
+                ms = int(second + (fraction + '00')[:3])
+            else:
+                ms = int(second) * 1000
+            if minute:
+                ms += int(minute) * 60000
+                if hour:
+                    ms += int(hour) * 3600000
+            if line_text is None:
+                timestamps.append(ms)
+            elif timestamps:
+                timestamps.append(ms)
+                for timestamp in timestamps:
+                    append((timestamp, line_text))
+                timestamps = []
+            else:
+                append((ms, line_text))
+        elif key is not None:
+            attrs[key] = value
+        elif timestamps:
+            for timestamp in timestamps:
+                append((timestamp, text))
+            timestamps = []
+    lines.sort(key=itemgetter(0))
+    return attrs, lines
+
+
 def parse_lrc(content):
     """
     Parse an lrc file
@@ -136,26 +192,19 @@ def parse_lrc(content):
     - `lyrics`: A list of dict with 3 keys: id, timestamp and text.
       The list is sorted in ascending order by timestamp. Id increases from 0.
     """
-    tokens = tokenize(content)
-    attrs = {}
-    lyrics = []
-    timetags = []
-    for token in tokens:
-        if isinstance(token, AttrToken):
-            attrs[token.key] = token.value
-        elif isinstance(token, TimeToken):
-            timetags.append(token.time)
-        else:
-            for timestamp in timetags:
-                lyrics.append({'timestamp': dbus.types.Int64(timestamp),
-                               'text': token.text})
-            timetags = []
-    lyrics.sort(key=lambda a: a['timestamp'])
-    i = 0
-    for lyric in lyrics:
-        lyric['id'] = dbus.types.UInt32(i)
-        i = i + 1
-    return attrs, lyrics
+    attrs, lines = parse_lrc_lines(content)
+    return attrs, lines_to_dicts(lines)
+
+
+def lines_to_dicts(lines):
+    """
+    Converts the lines returned by `parse_lrc_lines` to the lyrics returned by
+    `parse_lrc`.
+    """
+    return [{'id': dbus.types.UInt32(i),
+             'timestamp': dbus.types.Int64(timestamp),
+             'text': text}
+            for i, (timestamp, text) in enumerate(lines)]
 
 
 def test():
@@ -22,22 +22,115 @@ import os
 import os.path
 import stat
 import sys
+import threading
+import time
 import urllib.parse
 import urllib.request
+import weakref
 
 import pycurl
 
 __all__ = (
+    'CurlPool',
     'cmd_exists',
     'ensure_path',
     'get_config_path',
+    'get_proxy_settings',
     'http_download',
+    'invalidate_proxy_settings',
     'path2uri',
 )
 
+PROXY_CONFIG_KEYS = (
+    'Download/proxy',
+    'Download/proxy-type',
+    'Download/proxy-host',
+    'Download/proxy-port',
+    'Download/proxy-username',
+    'Download/proxy-password',
+)
+
+# Seconds to keep system proxy settings that are not watched for changes
+SYSTEM_PROXY_TTL = 60
+
 pycurl.global_init(pycurl.GLOBAL_DEFAULT)
 
 
+class CurlPool:
+    """
+    A thread-safe pool of reusable curl handles.
+
+    Handles share the DNS cache, TLS sessions and, if libcurl supports it, the
+    connection cache through a CurlShare, so requests to the same site reuse
+    the resolved address and the keep-alive connection instead of setting up
+    a new one each time. HTTP/2 is negotiated over TLS if libcurl supports it
+    and `http2` is True.
+
+    >>> pool = CurlPool(max_idle=1)
+    >>> c = pool.acquire()
+    >>> pool.release(c)
+    >>> pool.acquire() is c
+    True
+    >>> pool.release(c)
+    >>> pool.release(pool.acquire())
+    >>> len(pool._idle)
+    1
+    """
+
+    def __init__(self, max_idle=4, http2=True):
+        """
+        Arguments:
+        - `max_idle`: The number of idle handles to keep. Handles released
+          when the pool is full are closed.
+        - `http2`: Whether to negotiate HTTP/2 for HTTPS requests.
+        """
+        self._lock = threading.Lock()
+        self._idle = []
+        self._max_idle = max_idle
+        self._share = pycurl.CurlShare()
+        for data in ('LOCK_DATA_DNS', 'LOCK_DATA_SSL_SESSION', 'LOCK_DATA_CONNECT'):
+            if hasattr(pycurl, data):
+                try:
+                    self._share.setopt(pycurl.SH_SHARE, getattr(pycurl, data))
+                except pycurl.error:
+                    # Not supported by the libcurl in use
+                    pass
+        self._http2 = http2 and \
+            bool(pycurl.version_info()[4] & getattr(pycurl, 'VERSION_HTTP2', 0))
+
+    def acquire(self):
+        """
+        Returns a curl handle with the options of the pool set. The handle
+        must be given back with `release` once the request is done.
+        """
+        with self._lock:
+            c = self._idle.pop() if self._idle else None
+        if c is None:
+            c = pycurl.Curl()
+            # The share is kept when the handle is reset
+            c.setopt(pycurl.SHARE, self._share)
+        c.setopt(pycurl.NOSIGNAL, 1)
+        c.setopt(pycurl.TCP_KEEPALIVE, 1)
+        if self._http2:
+            c.setopt(pycurl.HTTP_VERSION, pycurl.CURL_HTTP_VERSION_2TLS)
+        return c
+
+    def release(self, c):
+        """
+        Gives back a handle got from `acquire`. The options of the handle are
+        reset, while its connections are kept alive for later requests.
+        """
+        c.reset()
+        with self._lock:
+            if len(self._idle) < self._max_idle:
+                self._idle.append(c)
+                return
+        c.close()
+
+
+_curl_pool = CurlPool()
+
+
 class ProxySettings:
     """
     """
@@ -97,26 +190,84 @@ def path2uri(path):
     return 'file://' + urllib.request.pathname2url(path)
 
 
+_proxy_lock = threading.Lock()
+# Config -> (ProxySettings, the time it expires or None)
+_proxy_cache = weakref.WeakKeyDictionary()
+# Increased on invalidation, so that settings resolved before are not cached
+_proxy_generation = 0
+# Configs whose changes of proxy settings are watched
+_proxy_watched_configs = weakref.WeakSet()
+# D-Bus connection -> Config created for the callers specifying conn
+_proxy_configs = {}
+# Schema id -> Gio.Settings watched for changes of system proxy settings
+_proxy_gsettings = {}
+
+
+def invalidate_proxy_settings(*args):
+    """
+    Drops the proxy settings cached by get_proxy_settings. This is called when
+    the proxy settings in config or GSettings change.
+    """
+    global _proxy_generation
+    with _proxy_lock:
+        _proxy_generation += 1
+        _proxy_cache.clear()
+
+
 def get_proxy_settings(config=None, conn=None):
     r"""
     Return proxy settings as a ProxySettings object
 
     The caller must specify either config or conn.
 
+    The settings are cached until the proxy settings in config change. System
+    proxy settings are cached until they change in GSettings, or for
+    SYSTEM_PROXY_TTL seconds if they are not from GSettings.
+
     Arguments:
      - `config`: A osdlyrics.config.Config object, this object is used to retrive
                  proxy settings. If it is not set, the caller MUST set conn to a
                  valid D-Bus connection to create a Config object
      - `conn`: A D-Bus connection object, this is used when `config` is not
-               specified.
+               specified. One Config object is created for each connection
+               and reused by the following calls.
     """
     if config is None and conn is None:
         raise ValueError('Either config or conn must be specified')
-    if config is None:
-        config = config.Config(conn)
+    with _proxy_lock:
+        if config is None:
+            config = _proxy_configs.get(conn)
+            if config is None:
+                from osdlyrics.config import Config
+                config = _proxy_configs[conn] = Config(conn)
+        cached = _proxy_cache.get(config)
+        generation = _proxy_generation
+        if config not in _proxy_watched_configs:
+            _proxy_watched_configs.add(config)
+            for key in PROXY_CONFIG_KEYS:
+                config.connect_change(key, invalidate_proxy_settings)
+    if cached is not None:
+        proxy, expiry = cached
+        if expiry is None or time.monotonic() < expiry:
+            return proxy
+    proxy, watched = _resolve_proxy_settings(config)
+    expiry = None if watched else time.monotonic() + SYSTEM_PROXY_TTL
+    with _proxy_lock:
+        if generation == _proxy_generation:
+            _proxy_cache[config] = (proxy, expiry)
+    return proxy
+
+
+def _resolve_proxy_settings(config):
+    """
+    Return values: proxy, watched
+    - `proxy`: The ProxySettings object.
+    - `watched`: Whether changes of the settings are notified, so that they
+      can be cached until invalidated.
+    """
     proxy_type = config.get_string('Download/proxy').lower()
     if proxy_type == 'no':
-        return ProxySettings(protocol='no')
+        return ProxySettings(protocol='no'), True
     if proxy_type == 'manual':
         protocol = config.get_string('Download/proxy-type')
         host = config.get_string('Download/proxy-host')
@@ -124,9 +275,13 @@ def get_proxy_settings(config=None, conn=None):
         username = config.get_string('Download/proxy-username')
         passwd = config.get_string('Download/proxy-password')
         return ProxySettings(protocol=protocol, host=host, port=port,
-                             username=username, password=passwd)
+                             username=username, password=passwd), True
     if proxy_type == 'system':
-        return detect_system_proxy()
+        desktop = detect_desktop_shell()
+        proxy = detect_system_proxy()
+        watched = desktop in ('gnome', 'unity') and bool(_proxy_gsettings)
+        return proxy, watched
+    return None, True
 
 
 def detect_system_proxy():
@@ -178,7 +333,7 @@ def detect_desktop_shell():
 
     Returns: 'gnome', 'unity', 'kde', or 'unknown'
     """
-    envar = os.environ.get('DESKTOP_SESSION')
+    envar = os.environ.get('DESKTOP_SESSION', '')
     if envar.startswith('gnome'):
         return 'gnome'
     if envar.startswith('kde'):
@@ -198,14 +353,15 @@ def get_gsettings_proxy():
         return None
     if not hasattr(Gio, 'Settings'):
         return None
-    if 'org.gnome.system.proxy' not in Gio.Settings.list_schemas():
+    if 'org.gnome.system.proxy' not in _proxy_gsettings and \
+            'org.gnome.system.proxy' not in Gio.Settings.list_schemas():
         return None
-    settings = Gio.Settings('org.gnome.system.proxy')
+    settings = _get_watched_gsettings(Gio, 'org.gnome.system.proxy')
     if settings.get_string('mode') != 'manual':
         return ProxySettings(protocol='no')
     protocol_map = {'http': 'http', 'socks5': 'socks'}
     for protocol, key in protocol_map.items():
-        settings = Gio.Settings('org.gnome.system.proxy.' + key)
+        settings = _get_watched_gsettings(Gio, 'org.gnome.system.proxy.' + key)
         host = settings.get_string('host').strip()
         port = settings.get_int('port')
         if host == '' or port <= 0:
@@ -223,6 +379,21 @@ def get_gsettings_proxy():
     return ProxySettings(protocol='no')
 
 
+def _get_watched_gsettings(Gio, schema_id):
+    """
+    Returns the Gio.Settings of the schema, whose changes invalidate the
+    cached proxy settings.
+    """
+    with _proxy_lock:
+        settings = _proxy_gsettings.get(schema_id)
+    if settings is None:
+        settings = Gio.Settings(schema_id)
+        settings.connect('changed', invalidate_proxy_settings)
+        with _proxy_lock:
+            settings = _proxy_gsettings.setdefault(schema_id, settings)
+    return settings
+
+
 def get_kde_proxy():
     r"""
     Detect KDE4 proxy settings
@@ -281,18 +452,31 @@ def http_download(url, port=0, method='GET', params={}, headers={}, timeout=15,
                  `params` will be append to the url as the param part. If `method` is
                  `'POST'`, `params` will be added to request body as post data.
      - `headers`: (optional) A dict of HTTP headers.
+     - `timeout`: (optional) The maximum number of seconds of the request.
      - `proxy`: (optional) A ProxySettings object to sepcify the proxy to use.
 
+    The curl handles, DNS cache and connections are reused across calls.
+
     >>> code, content = http_download('http://www.python.org/')
     >>> code
     200
     >>> b'Python' in content
     True
     """
-    c = pycurl.Curl()
+    c = _curl_pool.acquire()
+    try:
+        code, content = _perform(c, url, port, method, params, headers,
+                                 timeout, proxy)
+    except Exception:
+        # The handle may be left in any state, don't reuse it
+        c.close()
+        raise
+    _curl_pool.release(c)
+    return code, content
+
+
+def _perform(c, url, port, method, params, headers, timeout, proxy):
     buf = io.BytesIO()
-    c.setopt(pycurl.NOSIGNAL, 1)
-    c.setopt(pycurl.DNS_USE_GLOBAL_CACHE, 0)
     c.setopt(pycurl.FOLLOWLOCATION, 1)
     c.setopt(pycurl.MAXREDIRS, 5)
     c.setopt(pycurl.WRITEFUNCTION, buf.write)
@@ -308,6 +492,8 @@ def http_download(url, port=0, method='GET', params={}, headers={}, timeout=15,
     c.setopt(pycurl.URL, url)
     if 0 < port < 65536:
         c.setopt(pycurl.PORT, port)
+    if timeout > 0:
+        c.setopt(pycurl.TIMEOUT, timeout)
 
     real_headers = {'User-Agent': 'OSD Lyrics'}
     real_headers.update(headers)
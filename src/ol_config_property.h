@@ -110,9 +110,12 @@ static const OlConfigBoolValue config_bool[] = {
   {"OSD/visible_when_stopped", TRUE},
   {"OSD/translucent-on-mouse-over", TRUE},
   {"Download/download-first-lyric", FALSE},
+  {"Download/parallel-search", TRUE},
   {"General/display-mode-osd", TRUE},
   {"General/display-mode-scroll", TRUE},
   {"General/notify-music", TRUE},
+  {"ScrollMode/tiled-rendering", FALSE},
+  {"General/save-offset-to-file", FALSE},
 };
 
 static const OlConfigIntValue config_int[] = {
@@ -121,11 +124,17 @@ static const OlConfigIntValue config_int[] = {
   {"OSD/line-count", 1, 2, 1},
   {"OSD/x", 0, 10000, 0},
   {"OSD/y", 0, 10000, 0},
+  {"OSD/surface-cache-size", 0, 1048576, 8192},
+  {"OSD/prerender-lines", 0, 20, 3},
   {"Download/proxy-port", 1, 65535, 7070},
+  {"Download/search-deadline", 1, 300, 10},
+  {"Download/search-cache-ttl", 0, 8760, 168},
+  {"Download/search-cache-miss-ttl", 0, 8760, 24},
   {"ScrollMode/width", 1, 10000, 500},
   {"ScrollMode/height", 1, 10000, 400},
   {"ScrollMode/x", 0, 10000, 0},
   {"ScrollMode/y", 0, 10000, 0},
+  {"ScrollMode/tile-budget", 1, 64, 8},
 };
 
 static const OlConfigDoubleValue config_double[] = {
@@ -23,6 +23,11 @@
 #include "ol_debug.h"
 
 const int DEFAULT_SYNC_TIMEOUT = 500; /* 0.5s */
+static const char *UNKNOWN_METHOD_ERROR = "org.freedesktop.DBus.Error.UnknownMethod";
+/* The strings of boolean values in the config file, as configparser in the
+   config daemon accepts */
+static const char *TRUE_STRINGS[] = {"1", "yes", "true", "on", NULL};
+static const char *FALSE_STRINGS[] = {"0", "no", "false", "off", NULL};
 
 #define OL_CONFIG_PROXY_GET_PRIVATE(obj) \
     ((OlConfigProxyPrivate *)((OL_CONFIG_PROXY(obj))->priv))
@@ -36,14 +41,31 @@ enum _GetResult {
   GET_RESULT_OK = 0,
   GET_RESULT_FAILED,
   GET_RESULT_MISSING,
+  GET_RESULT_NOT_CACHED,
 };
 
 typedef struct {
   GHashTable *temp_values;
   GVariantBuilder *default_builder;
   guint default_sync_handler;
+  /* Cached values from GetAllValues, as strings in the config file. NULL if
+     the values are to be loaded on the next get. */
+  GHashTable *values;
+  /* TRUE if the config daemon doesn't support GetAllValues */
+  gboolean cache_disabled;
+  guint cache_hits;
+  guint cache_misses;
+  /* OlConfigBatch not committed yet, the newest first */
+  GList *batches;
 } OlConfigProxyPrivate;
 
+struct _OlConfigBatch
+{
+  OlConfigProxy *config;
+  /* Values set in the batch, by keys */
+  GHashTable *values;
+};
+
 static guint _signals[LAST_SINGAL];
 static OlConfigProxy *config_proxy = NULL;
 
@@ -60,6 +82,25 @@ static void ol_config_proxy_value_changed_cb (OlConfigProxy *proxy,
 static GVariant *_str_list_to_variant (const gchar *const *value,
                                        gssize len);
 static gboolean _sync_default_cb (OlConfigProxy *config);
+static void _name_owner_changed_cb (OlConfigProxy *config,
+                                    GParamSpec *pspec,
+                                    gpointer userdata);
+static void _invalidate_cache (OlConfigProxy *config);
+static void _refresh_cached_value (OlConfigProxy *config,
+                                   const gchar *key);
+static GHashTable *_load_values (OlConfigProxy *config);
+static gchar *_cache_key (const gchar *key);
+static gchar **_split_str_list (const gchar *value);
+static GVariant *_parse_value (const gchar *method,
+                               const gchar *key,
+                               const gchar *str);
+static GVariant *_get_pending (OlConfigProxy *config,
+                               const gchar *method,
+                               const gchar *key);
+static enum _GetResult _get_cached (OlConfigProxy *config,
+                                    const gchar *method,
+                                    const gchar *key,
+                                    GVariant **value);
 
 static GVariant *
 _str_list_to_variant (const gchar *const *value,
@@ -78,6 +119,328 @@ _str_list_to_variant (const gchar *const *value,
   return gvalue;
 }
 
+static void
+_invalidate_cache (OlConfigProxy *config)
+{
+  OlConfigProxyPrivate *priv = OL_CONFIG_PROXY_GET_PRIVATE (config);
+  if (priv->values != NULL)
+  {
+    g_hash_table_destroy (priv->values);
+    priv->values = NULL;
+  }
+}
+
+/**
+ * Gets the value of key again, so that changing a few values doesn't load all
+ * of them on the next get.
+ */
+static void
+_refresh_cached_value (OlConfigProxy *config,
+                       const gchar *key)
+{
+  OlConfigProxyPrivate *priv = OL_CONFIG_PROXY_GET_PRIVATE (config);
+  if (priv->values == NULL)
+    return;
+  gchar *cache_key = _cache_key (key);
+  if (cache_key == NULL)
+    return;
+  GError *error = NULL;
+  GVariant *ret = g_dbus_proxy_call_sync (G_DBUS_PROXY (config),
+                                          "GetString",
+                                          g_variant_new ("(s)", key),
+                                          G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                          -1,   /* timeout_secs */
+                                          NULL, /* cancellable */
+                                          &error);
+  if (ret)
+  {
+    gchar *value = NULL;
+    g_variant_get (ret, "(s)", &value);
+    g_hash_table_insert (priv->values, cache_key, value);
+    g_variant_unref (ret);
+    return;
+  }
+  gchar *error_name = g_dbus_error_get_remote_error (error);
+  if (error_name != NULL && strcmp (error_name, OL_ERROR_VALUE_NOT_EXIST) == 0)
+  {
+    g_hash_table_remove (priv->values, cache_key);
+  }
+  else
+  {
+    ol_errorf ("Cannot get config value %s: %s\n", key, error->message);
+    _invalidate_cache (config);
+  }
+  g_free (error_name);
+  g_error_free (error);
+  g_free (cache_key);
+}
+
+static void
+_name_owner_changed_cb (OlConfigProxy *config,
+                        GParamSpec *pspec,
+                        gpointer userdata)
+{
+  OlConfigProxyPrivate *priv = OL_CONFIG_PROXY_GET_PRIVATE (config);
+  /* The new daemon may have different values and support GetAllValues */
+  _invalidate_cache (config);
+  priv->cache_disabled = FALSE;
+}
+
+static GHashTable *
+_load_values (OlConfigProxy *config)
+{
+  OlConfigProxyPrivate *priv = OL_CONFIG_PROXY_GET_PRIVATE (config);
+  if (priv->values != NULL || priv->cache_disabled)
+    return priv->values;
+  GError *error = NULL;
+  GVariant *ret = g_dbus_proxy_call_sync (G_DBUS_PROXY (config),
+                                          "GetAllValues",
+                                          NULL,
+                                          G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                          -1,   /* timeout_secs */
+                                          NULL, /* cancellable */
+                                          &error);
+  if (!ret)
+  {
+    gchar *error_name = g_dbus_error_get_remote_error (error);
+    if (error_name != NULL && strcmp (error_name, UNKNOWN_METHOD_ERROR) == 0)
+    {
+      ol_debug ("GetAllValues is not supported, config values are not cached");
+      priv->cache_disabled = TRUE;
+    }
+    else
+    {
+      ol_errorf ("Cannot load config values: %s\n", error->message);
+    }
+    g_free (error_name);
+    g_error_free (error);
+    return NULL;
+  }
+  priv->values = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free, g_free);
+  GVariantIter *iter = NULL;
+  gchar *key, *value;
+  g_variant_get (ret, "(a{ss})", &iter);
+  while (g_variant_iter_next (iter, "{ss}", &key, &value))
+    g_hash_table_insert (priv->values, key, value);
+  g_variant_iter_free (iter);
+  g_variant_unref (ret);
+  guint total = priv->cache_hits + priv->cache_misses;
+  ol_debugf ("Config values loaded, cache hits: %u/%u (%.1f%%)\n",
+             priv->cache_hits, total,
+             total > 0 ? priv->cache_hits * 100.0 / total : 0.0);
+  return priv->values;
+}
+
+/**
+ * Gets the key of a value in the result of GetAllValues, where the option
+ * names are in lower case.
+ *
+ * @return The key, or NULL if key is malformed. Must be freed with g_free.
+ */
+static gchar *
+_cache_key (const gchar *key)
+{
+  const gchar *name = strchr (key, '/');
+  if (name == NULL || name == key || name[1] == '\0' || strchr (name + 1, '/'))
+    return NULL;
+  gchar *lower_name = g_utf8_strdown (name, -1);
+  gchar *ret = g_strdup_printf ("%.*s%s", (int) (name - key), key, lower_name);
+  g_free (lower_name);
+  return ret;
+}
+
+/**
+ * Splits a string list in the config file. Items are separated by `;', and
+ * `\;' and `\\' are escaped `;' and `\'. A trailing `;' doesn't start a new
+ * item. This is the same as split() in python/config.py.
+ */
+static gchar **
+_split_str_list (const gchar *value)
+{
+  GPtrArray *items = g_ptr_array_new ();
+  GString *item = g_string_new ("");
+  const gchar *p;
+  for (p = value; ; p++)
+  {
+    if (*p == '\0' || *p == ';')
+    {
+      if (*p != '\0' || item->len > 0)
+        g_ptr_array_add (items, g_strdup (item->str));
+      g_string_truncate (item, 0);
+      if (*p == '\0')
+        break;
+    }
+    else if (*p == '\\' && (p[1] == '\\' || p[1] == ';'))
+    {
+      p++;
+      g_string_append_c (item, *p);
+    }
+    else
+    {
+      g_string_append_c (item, *p);
+    }
+  }
+  g_string_free (item, TRUE);
+  g_ptr_array_add (items, NULL);
+  return (gchar **) g_ptr_array_free (items, FALSE);
+}
+
+static gboolean
+_str_in_list (const gchar *str, const char **list)
+{
+  for (; *list != NULL; list++)
+    if (g_ascii_strcasecmp (str, *list) == 0)
+      return TRUE;
+  return FALSE;
+}
+
+/**
+ * Converts a string in the config file to the reply of a Get method.
+ *
+ * @return The value, or NULL if str is not valid for the type of method.
+ */
+static GVariant *
+_parse_value (const gchar *method,
+              const gchar *key,
+              const gchar *str)
+{
+  GVariant *value = NULL;
+  if (strcmp (method, "GetString") == 0)
+  {
+    value = g_variant_new ("(s)", str);
+  }
+  else if (strcmp (method, "GetStringList") == 0)
+  {
+    gchar **list = _split_str_list (str);
+    value = g_variant_new ("(^as)", list);
+    g_strfreev (list);
+  }
+  else if (strcmp (method, "GetBool") == 0)
+  {
+    if (_str_in_list (str, TRUE_STRINGS))
+      value = g_variant_new ("(b)", TRUE);
+    else if (_str_in_list (str, FALSE_STRINGS))
+      value = g_variant_new ("(b)", FALSE);
+  }
+  else
+  {
+    gchar *stripped = g_strstrip (g_strdup (str));
+    gchar *end = NULL;
+    if (strcmp (method, "GetInt") == 0)
+    {
+      gint64 number = g_ascii_strtoll (stripped, &end, 10);
+      if (end != stripped && *end == '\0' &&
+          number >= G_MININT32 && number <= G_MAXINT32)
+        value = g_variant_new ("(i)", (gint32) number);
+    }
+    else if (strcmp (method, "GetDouble") == 0)
+    {
+      gdouble number = g_ascii_strtod (stripped, &end);
+      if (end != stripped && *end == '\0')
+        value = g_variant_new ("(d)", number);
+    }
+    g_free (stripped);
+  }
+  if (value == NULL)
+    ol_errorf ("Failed to get config %s: invalid value %s for %s\n",
+               key, str, method);
+  return value;
+}
+
+static const gchar *
+_get_method_value_type (const gchar *method)
+{
+  static const gchar *TYPES[][2] = {
+    { "GetBool", "b" },
+    { "GetInt", "i" },
+    { "GetDouble", "d" },
+    { "GetString", "s" },
+    { "GetStringList", "as" },
+  };
+  int i;
+  for (i = 0; i < G_N_ELEMENTS (TYPES); i++)
+    if (strcmp (method, TYPES[i][0]) == 0)
+      return TYPES[i][1];
+  return NULL;
+}
+
+/**
+ * Gets a value set in a batch not committed yet.
+ *
+ * @return The value in the form of the reply of method, or NULL if the value
+ *         is not set in any batch, or set with another type.
+ */
+static GVariant *
+_get_pending (OlConfigProxy *config,
+              const gchar *method,
+              const gchar *key)
+{
+  OlConfigProxyPrivate *priv = OL_CONFIG_PROXY_GET_PRIVATE (config);
+  GVariant *value = NULL;
+  GList *iter;
+  for (iter = priv->batches; iter != NULL && value == NULL; iter = iter->next)
+  {
+    OlConfigBatch *batch = iter->data;
+    value = g_hash_table_lookup (batch->values, key);
+  }
+  const gchar *type = _get_method_value_type (method);
+  if (value == NULL || type == NULL ||
+      !g_variant_is_of_type (value, G_VARIANT_TYPE (type)))
+    return NULL;
+  return g_variant_new_tuple (&value, 1);
+}
+
+/**
+ * Gets a value from the cached values, loading them if needed.
+ *
+ * @param value Return location of the value in the form of the reply of
+ *              method, if GET_RESULT_OK is returned.
+ *
+ * @return GET_RESULT_NOT_CACHED if the value should be got with method.
+ */
+static enum _GetResult
+_get_cached (OlConfigProxy *config,
+             const gchar *method,
+             const gchar *key,
+             GVariant **value)
+{
+  OlConfigProxyPrivate *priv = OL_CONFIG_PROXY_GET_PRIVATE (config);
+  *value = _get_pending (config, method, key);
+  if (*value != NULL)
+  {
+    g_variant_ref_sink (*value);
+    priv->cache_hits++;
+    return GET_RESULT_OK;
+  }
+  gchar *cache_key = _cache_key (key);
+  GHashTable *values = NULL;
+  /* The get that loads the values takes a D-Bus call as a miss does */
+  gboolean loaded = priv->values != NULL;
+  /* Let the daemon report malformed keys */
+  if (cache_key != NULL)
+    values = _load_values (config);
+  if (values == NULL)
+  {
+    priv->cache_misses++;
+    g_free (cache_key);
+    return GET_RESULT_NOT_CACHED;
+  }
+  if (loaded)
+    priv->cache_hits++;
+  else
+    priv->cache_misses++;
+  const gchar *str = g_hash_table_lookup (values, cache_key);
+  g_free (cache_key);
+  if (str == NULL)
+    return GET_RESULT_MISSING;
+  *value = _parse_value (method, key, str);
+  if (*value == NULL)
+    return GET_RESULT_FAILED;
+  g_variant_ref_sink (*value);
+  return GET_RESULT_OK;
+}
+
 static gboolean
 _sync_default_cb (OlConfigProxy *config)
 {
@@ -96,6 +459,7 @@ _sync_default_cb (OlConfigProxy *config)
     if (ret)
     {
       g_variant_unref (ret);
+      _invalidate_cache (config);
     }
     else
     {
@@ -157,6 +521,11 @@ ol_config_proxy_init (OlConfigProxy *proxy)
                                                g_str_equal,
                                                g_free,
                                                (GDestroyNotify) g_variant_unref);
+    priv->batches = NULL;
+    g_signal_connect (proxy,
+                      "notify::g-name-owner",
+                      G_CALLBACK (_name_owner_changed_cb),
+                      NULL);
   }
 }
 
@@ -184,6 +553,7 @@ ol_config_proxy_finalize (GObject *object)
   g_hash_table_destroy (priv->temp_values);
   priv->temp_values = NULL;
   ol_config_proxy_sync (OL_CONFIG_PROXY (object));
+  _invalidate_cache (OL_CONFIG_PROXY (object));
 }
 
 static OlConfigProxy *
@@ -226,17 +596,20 @@ static void
 ol_config_proxy_value_changed_cb (OlConfigProxy *proxy,
                                   GVariant *parameters)
 {
-  GVariantIter *iter = NULL;
-  g_variant_get (parameters, "(as)", &iter);
-  gchar *name = NULL;
-  while (g_variant_iter_loop (iter, "s", &name))
+  const gchar **names = NULL;
+  gint i;
+  g_variant_get (parameters, "(^a&s)", &names);
+  /* The handlers get the new values */
+  for (i = 0; names[i] != NULL; i++)
+    _refresh_cached_value (proxy, names[i]);
+  for (i = 0; names[i] != NULL; i++)
   {
     g_signal_emit (proxy,
                    _signals[SIGNAL_CHANGED],
-                   g_quark_from_string (name),
-                   name);
+                   g_quark_from_string (names[i]),
+                   names[i]);
   }
-  g_variant_iter_free (iter);
+  g_free (names);
 }
 
 OlConfigProxy*
@@ -291,6 +664,7 @@ ol_config_proxy_set (OlConfigProxy *config,
     if (ret)
     {
       g_variant_unref (ret);
+      _refresh_cached_value (config, key);
       return TRUE;
     }
     else
@@ -487,15 +861,25 @@ ol_config_proxy_get (OlConfigProxy *config,
   }
   else
   {
-    value = g_dbus_proxy_call_sync (G_DBUS_PROXY (config),
-                                    method,
-                                    g_variant_new ("(s)", key),
-                                    G_DBUS_CALL_FLAGS_NO_AUTO_START,
-                                    -1,   /* timeout_secs */
-                                    NULL, /* cancellable */
-                                    &error);
+    ret = _get_cached (config, method, key, &value);
+    if (ret == GET_RESULT_NOT_CACHED)
+    {
+      ret = GET_RESULT_OK;
+      value = g_dbus_proxy_call_sync (G_DBUS_PROXY (config),
+                                      method,
+                                      g_variant_new ("(s)", key),
+                                      G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                      -1,   /* timeout_secs */
+                                      NULL, /* cancellable */
+                                      &error);
+    }
   }
-  if (!value)
+  if (value)
+  {
+    g_variant_get (value, format_string, retval);
+    g_variant_unref (value);
+  }
+  else if (error)
   {
     if (g_dbus_error_is_remote_error (error))
     {
@@ -520,10 +904,10 @@ ol_config_proxy_get (OlConfigProxy *config,
     }
     g_error_free (error);
   }
-  else
+  else if (ret != GET_RESULT_FAILED)
   {
-    g_variant_get (value, format_string, retval);
-    g_variant_unref (value);
+    ol_debugf ("Key %s not exists, use default value\n", key);
+    ret = GET_RESULT_MISSING;
   }
   return ret;
 }
@@ -607,13 +991,26 @@ ol_config_proxy_get_str_list (OlConfigProxy *config,
   ol_assert_ret (OL_IS_CONFIG_PROXY (config), NULL);
   ol_assert_ret (key != NULL, NULL);
   GError *error = NULL;
-  GVariant *value = g_dbus_proxy_call_sync (G_DBUS_PROXY (config),
-                                            "GetStringList",
-                                            g_variant_new ("(s)", key),
-                                            G_DBUS_CALL_FLAGS_NO_AUTO_START,
-                                            -1,   /* timeout_secs */
-                                            NULL, /* cancellable */
-                                            &error);
+  GVariant *value = NULL;
+  switch (_get_cached (config, "GetStringList", key, &value))
+  {
+  case GET_RESULT_NOT_CACHED:
+    value = g_dbus_proxy_call_sync (G_DBUS_PROXY (config),
+                                    "GetStringList",
+                                    g_variant_new ("(s)", key),
+                                    G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                    -1,   /* timeout_secs */
+                                    NULL, /* cancellable */
+                                    &error);
+    break;
+  case GET_RESULT_MISSING:
+    ol_debugf ("Key %s not exists\n", key);
+    return NULL;
+  case GET_RESULT_FAILED:
+    return NULL;
+  default:
+    break;
+  }
   if (!value)
   {
     ol_errorf ("%s failed. Cannot get value %s from config: %s\n",
@@ -638,3 +1035,145 @@ ol_config_proxy_get_str_list (OlConfigProxy *config,
     return retval;
   }
 }
+
+void
+ol_config_proxy_get_cache_stats (OlConfigProxy *config,
+                                 guint *hits,
+                                 guint *misses)
+{
+  ol_assert (OL_IS_CONFIG_PROXY (config));
+  OlConfigProxyPrivate *priv = OL_CONFIG_PROXY_GET_PRIVATE (config);
+  if (hits)
+    *hits = priv->cache_hits;
+  if (misses)
+    *misses = priv->cache_misses;
+}
+
+OlConfigBatch *
+ol_config_batch_new (OlConfigProxy *config)
+{
+  ol_assert_ret (OL_IS_CONFIG_PROXY (config), NULL);
+  OlConfigProxyPrivate *priv = OL_CONFIG_PROXY_GET_PRIVATE (config);
+  OlConfigBatch *batch = g_new (OlConfigBatch, 1);
+  batch->config = g_object_ref (config);
+  batch->values = g_hash_table_new_full (g_str_hash,
+                                         g_str_equal,
+                                         g_free,
+                                         (GDestroyNotify) g_variant_unref);
+  priv->batches = g_list_prepend (priv->batches, batch);
+  return batch;
+}
+
+static gboolean
+ol_config_batch_set (OlConfigBatch *batch,
+                     const gchar *method,
+                     const gchar *key,
+                     GVariant *value)
+{
+  ol_assert_ret (key != NULL && key[0] != '\0', FALSE);
+  /* Temporary values are not sent to the config daemon */
+  if (key[0] == '.')
+    return ol_config_proxy_set (batch->config, method, key, value);
+  g_hash_table_insert (batch->values,
+                       g_strdup (key),
+                       g_variant_ref_sink (value));
+  return TRUE;
+}
+
+gboolean
+ol_config_batch_set_bool (OlConfigBatch *batch,
+                          const gchar *key,
+                          gboolean value)
+{
+  ol_assert_ret (batch != NULL, FALSE);
+  ol_assert_ret (key != NULL, FALSE);
+  return ol_config_batch_set (batch,
+                              "SetBool",
+                              key,
+                              g_variant_new ("b", value));
+}
+
+gboolean
+ol_config_batch_set_int (OlConfigBatch *batch,
+                         const gchar *key,
+                         gint value)
+{
+  ol_assert_ret (batch != NULL, FALSE);
+  ol_assert_ret (key != NULL, FALSE);
+  return ol_config_batch_set (batch,
+                              "SetInt",
+                              key,
+                              g_variant_new ("i", value));
+}
+
+gboolean
+ol_config_batch_set_double (OlConfigBatch *batch,
+                            const gchar *key,
+                            gdouble value)
+{
+  ol_assert_ret (batch != NULL, FALSE);
+  ol_assert_ret (key != NULL, FALSE);
+  return ol_config_batch_set (batch,
+                              "SetDouble",
+                              key,
+                              g_variant_new ("d", value));
+}
+
+gboolean
+ol_config_batch_set_string (OlConfigBatch *batch,
+                            const gchar *key,
+                            const gchar *value)
+{
+  ol_assert_ret (batch != NULL, FALSE);
+  ol_assert_ret (key != NULL, FALSE);
+  ol_assert_ret (value != NULL, FALSE);
+  return ol_config_batch_set (batch,
+                              "SetString",
+                              key,
+                              g_variant_new ("s", value));
+}
+
+gboolean
+ol_config_batch_commit (OlConfigBatch *batch)
+{
+  ol_assert_ret (batch != NULL, FALSE);
+  OlConfigProxy *config = batch->config;
+  OlConfigProxyPrivate *priv = OL_CONFIG_PROXY_GET_PRIVATE (config);
+  gboolean ret = TRUE;
+  priv->batches = g_list_remove (priv->batches, batch);
+  if (g_hash_table_size (batch->values) > 0)
+  {
+    GVariantBuilder *builder = g_variant_builder_new (G_VARIANT_TYPE ("a{sv}"));
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init (&iter, batch->values);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+      g_variant_builder_add (builder, "{sv}", key, value);
+    GError *error = NULL;
+    GVariant *reply = g_dbus_proxy_call_sync (G_DBUS_PROXY (config),
+                                              "SetValues",
+                                              g_variant_new ("(a{sv})", builder),
+                                              G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                              -1,   /* timeout_secs */
+                                              NULL, /* cancellable */
+                                              &error);
+    g_variant_builder_unref (builder);
+    if (reply)
+    {
+      g_variant_unref (reply);
+      g_hash_table_iter_init (&iter, batch->values);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        _refresh_cached_value (config, key);
+    }
+    else
+    {
+      ol_errorf ("Cannot set config values: %s\n", error->message);
+      g_error_free (error);
+      ret = FALSE;
+    }
+  }
+  g_hash_table_destroy (batch->values);
+  g_object_unref (config);
+  g_free (batch);
+  return ret;
+}
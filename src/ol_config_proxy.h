@@ -38,6 +38,7 @@
 
 typedef struct _OlConfigProxy OlConfigProxy;
 typedef struct _OlConfigProxyClass OlConfigProxyClass;
+typedef struct _OlConfigBatch OlConfigBatch;
 
 struct _OlConfigProxy
 {
@@ -335,4 +336,97 @@ void ol_config_proxy_unload (void);
  */
 void ol_config_proxy_sync (OlConfigProxy *config);
 
+/**
+ * @brief Starts a batch of config values to set
+ *
+ * Values set in the batch are sent to the config daemon with one call when
+ * the batch is committed, and are applied and saved together. Until then,
+ * gets return the values set in the batch. Values set with
+ * ol_config_proxy_set_* are not affected by the batch and are set
+ * immediately.
+ *
+ * @param config An OlConfigProxy
+ *
+ * @return The batch, which must be committed with ol_config_batch_commit
+ */
+OlConfigBatch *ol_config_batch_new (OlConfigProxy *config);
+
+/**
+ * @brief Sets a boolean value in a batch
+ *
+ * @param batch An OlConfigBatch
+ * @param key The key of the config value. Temporary keys starting with a dot
+ *            are set immediately.
+ * @param value The value
+ *
+ * @return If succeed, returns TRUE
+ */
+gboolean ol_config_batch_set_bool (OlConfigBatch *batch,
+                                   const gchar *key,
+                                   gboolean value);
+
+/**
+ * @brief Sets an int value in a batch
+ *
+ * @param batch An OlConfigBatch
+ * @param key The key of the config value
+ * @param value The value
+ *
+ * @return If succeed, returns TRUE
+ */
+gboolean ol_config_batch_set_int (OlConfigBatch *batch,
+                                  const gchar *key,
+                                  gint value);
+
+/**
+ * @brief Sets a double value in a batch
+ *
+ * @param batch An OlConfigBatch
+ * @param key The key of the config value
+ * @param value The value
+ *
+ * @return If succeed, returns TRUE
+ */
+gboolean ol_config_batch_set_double (OlConfigBatch *batch,
+                                     const gchar *key,
+                                     gdouble value);
+
+/**
+ * @brief Sets a string value in a batch
+ *
+ * @param batch An OlConfigBatch
+ * @param key The key of the config value
+ * @param value The value
+ *
+ * @return If succeed, returns TRUE
+ */
+gboolean ol_config_batch_set_string (OlConfigBatch *batch,
+                                     const gchar *key,
+                                     const gchar *value);
+
+/**
+ * @brief Sends the values set in a batch to the config daemon, and frees it
+ *
+ * @param batch An OlConfigBatch
+ *
+ * @return If the values are set, returns TRUE
+ */
+gboolean ol_config_batch_commit (OlConfigBatch *batch);
+
+/**
+ * Gets the statistics of the cache of config values.
+ *
+ * Values are cached with one call to the config daemon, and the values that
+ * are changed are got again one by one. The get that loads the values counts
+ * as a miss.
+ *
+ * @param config An OlConfigProxy
+ * @param hits Return location of the number of gets from the cache, or NULL.
+ * @param misses Return location of the number of gets that call the config
+ *               daemon, or NULL.
+ */
+void ol_config_proxy_get_cache_stats (OlConfigProxy *config,
+                                      guint *hits,
+                                      guint *misses);
+
 #endif /* _OL_CONFIG_PROXY_H_ */
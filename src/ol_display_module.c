@@ -38,6 +38,7 @@ static void _set_data (struct OlDisplayModule *module, void *data);
 static void _register_class (struct OlDisplayClass *klass);
 
 static GPtrArray *classes = NULL;
+static OlDisplayFrameRequestFunc frame_request_func = NULL;
 
 
 void
@@ -124,6 +125,20 @@ ol_display_module_get_data (struct OlDisplayModule *module)
   return module->data;
 }
 
+void
+ol_display_module_set_frame_request_func (OlDisplayFrameRequestFunc func)
+{
+  frame_request_func = func;
+}
+
+void
+ol_display_module_request_frame (struct OlDisplayModule *module)
+{
+  ol_assert (module != NULL);
+  if (frame_request_func != NULL)
+    frame_request_func ();
+}
+
 struct OlDisplayModule*
 ol_display_module_new (const char *name,
                        OlPlayer *player)
@@ -206,3 +221,13 @@ ol_display_module_clear_message (struct OlDisplayModule *module)
   ol_assert (module != NULL);
   call (module->klass->clear_message, module);
 }
+
+gint
+ol_display_module_get_next_frame_delay (struct OlDisplayModule *module,
+                                        guint64 played_time)
+{
+  ol_assert_ret (module != NULL, -1);
+  if (module->klass->get_next_frame_delay == NULL)
+    return OL_DISPLAY_DEFAULT_FRAME_DELAY;
+  return module->klass->get_next_frame_delay (module, played_time);
+}
@@ -37,6 +37,10 @@ struct OlDisplayModule
 typedef void* (*OlDisplayInitFunc) (struct OlDisplayModule *module,
                                     OlPlayer *player);
 typedef void (*OlDisplayFreeFunc) (struct OlDisplayModule *module);
+typedef void (*OlDisplayFrameRequestFunc) (void);
+
+/** The frame delay assumed for modules that don't report their own */
+#define OL_DISPLAY_DEFAULT_FRAME_DELAY 100
 
 struct OlDisplayClass
 {
@@ -57,6 +61,14 @@ struct OlDisplayClass
   void (*download_fail_message) (struct OlDisplayModule *module,
                                  const char *message);
   void (*clear_message) (struct OlDisplayModule *module);
+  /**
+   * Returns the delay in milliseconds after which the module needs the next
+   * call of set_played_time to keep its display up to date, assuming the
+   * player keeps playing from played_time. Returns -1 if nothing will change
+   * until the lyrics or the state of the module changes.
+   */
+  gint (*get_next_frame_delay) (struct OlDisplayModule *module,
+                                guint64 played_time);
 };
 
 /** functions for implementing concrete modules **/
@@ -80,6 +92,16 @@ struct OlDisplayClass* ol_display_class_new (const char *name,
 
 void* ol_display_module_get_data (struct OlDisplayModule *module);
 
+/**
+ * @brief Asks for a set_played_time call as soon as possible
+ *
+ * Modules that returned -1 from get_next_frame_delay should call this when
+ * their display needs to be updated again, e.g. when they are shown.
+ *
+ * @param module The display module
+ */
+void ol_display_module_request_frame (struct OlDisplayModule *module);
+
 /** functions for display module controlling **/
 
 /** 
@@ -103,6 +125,12 @@ struct OlDisplayModule *ol_display_module_new (const char *name,
                                                OlPlayer *player);
 
 void ol_display_module_free (struct OlDisplayModule *module);
+/**
+ * @brief Sets the function to be called when a module requests a frame
+ *
+ * @param func The function called by ol_display_module_request_frame
+ */
+void ol_display_module_set_frame_request_func (OlDisplayFrameRequestFunc func);
 void ol_display_module_set_played_time (struct OlDisplayModule *module,
                                         guint64 played_time);
 void ol_display_module_set_lrc (struct OlDisplayModule *module,
@@ -117,5 +145,16 @@ void ol_display_module_search_fail_message (struct OlDisplayModule *module,
 void ol_display_module_download_fail_message (struct OlDisplayModule *module,
                                               const char *message);
 void ol_display_module_clear_message (struct OlDisplayModule *module);
+/**
+ * @brief Gets how long the display can stay unchanged while playing
+ *
+ * @param module The display module
+ * @param played_time The played time passed to the last set_played_time
+ *
+ * @return The delay in milliseconds until the next set_played_time call is
+ *         needed, or -1 if the module doesn't need any.
+ */
+gint ol_display_module_get_next_frame_delay (struct OlDisplayModule *module,
+                                             guint64 played_time);
 
 #endif /* _OL_DISPLAY_MODULE_H_ */
@@ -24,70 +24,110 @@
 #include <ol_debug.h>
 #include "ol_gussian_blur.h"
 
-struct _pixel
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define OL_BLUR_X86 1
+#include <immintrin.h>
+#endif
+
+/* Width of the square tiles used when transposing the surface */
+#define TRANSPOSE_BLOCK 16
+
+/**
+ * Convolves pixels in [start, end) of a row whose neighbours are all inside
+ * the row, i.e. start >= kernel_size / 2 and end <= len - kernel_size / 2.
+ * The i-th output pixel is stored at dst[i * dst_stride].
+ */
+typedef void (*_convolve_func) (const guint32 *src,
+                                guint32 *dst,
+                                int dst_stride,
+                                int start,
+                                int end,
+                                const int *kernel,
+                                int kernel_size,
+                                guint32 kernel_sum);
+
+/**
+ * Scratch memory reused between blurs. Each thread owns its own arena so
+ * that surfaces can be blurred off the main thread.
+ */
+struct _blur_arena
 {
-  guint64 alpha;
-  guint64 red;
-  guint64 green;
-  guint64 blue;
+  guint32 *buffer;              /* The transposed surface */
+  gsize buffer_len;
+  guint32 *line;                /* A copy of the row being convolved */
+  gsize line_len;
 };
 
 static int *_calc_kernel (double sigma, int *size);
 static void _apply_kernel (cairo_surface_t *surface,
                            const int *kernel,
                            int kernel_size);
-static inline int _pos_to_index (int x, int y, int width, int height);
-static inline struct _pixel _num_to_pixel_with_factor (guint32 value,
-                                                       int factor);
-static inline guint32 _pixel_to_num_with_divisor (struct _pixel *pixel,
-                                                  int divisor);
-static inline void _pixel_plus (struct _pixel *adder_sum,
-                                const struct _pixel *adder2);
-
-static inline int
-_pos_to_index (int x, int y, int width, int height)
-{
-  if (x >= width || y >= height || x < 0 || y < 0)
-    return -1;
-  return y * width + x;
-}
+static void _arena_free (gpointer data);
+static struct _blur_arena *_arena_get (gsize buffer_len, gsize line_len);
+static void _transpose (const guint32 *src,
+                        int src_stride,
+                        int width,
+                        int height,
+                        guint32 *dst);
+static void _convolve_row (const guint32 *src,
+                           int len,
+                           guint32 *dst,
+                           int dst_stride,
+                           const int *kernel,
+                           int kernel_size,
+                           guint32 kernel_sum,
+                           _convolve_func convolve);
+static inline guint32 _convolve_pixel (const guint32 *src,
+                                       int offset,
+                                       const int *kernel,
+                                       int first,
+                                       int last);
+static void _convolve_scalar (const guint32 *src,
+                              guint32 *dst,
+                              int dst_stride,
+                              int start,
+                              int end,
+                              const int *kernel,
+                              int kernel_size,
+                              guint32 kernel_sum);
+static _convolve_func _select_convolve (enum OlBlurImpl impl,
+                                        const int *kernel,
+                                        int kernel_size);
 
-static inline struct _pixel
-_num_to_pixel_with_factor (guint32 value,
-                           int factor)
-{
-  /* This only works for type CAIRO_FORMAT_ARGB32 */
-  struct _pixel pixel;
-  pixel.alpha = ((value >> 24) & 0xff) * factor;
-  pixel.red = ((value >> 16) & 0xff) * factor;
-  pixel.green = ((value >> 8) & 0xff) * factor;
-  pixel.blue = (value & 0xff) * factor;
-  return pixel;
-}
+static GPrivate arena_key = G_PRIVATE_INIT (_arena_free);
+static enum OlBlurImpl forced_impl = OL_BLUR_IMPL_AUTO;
 
-static inline guint32
-_pixel_to_num_with_divisor (struct _pixel *pixel,
-                            int divisor)
-{
-  guint32 alpha = pixel->alpha / divisor;
-  if (alpha > 0xff) alpha = 0xff;
-  guint32 red = pixel->red / divisor;
-  if (red > 0xff) red = 0xff;
-  guint32 green = pixel->green / divisor;
-  if (green > 0xff) green = 0xff;
-  guint32 blue = pixel->blue / divisor;
-  if (blue > 0xff) blue = 0xff;
-  return (alpha << 24) | (red << 16) | (green << 8) | blue;
+static void
+_arena_free (gpointer data)
+{
+  struct _blur_arena *arena = data;
+  g_free (arena->buffer);
+  g_free (arena->line);
+  g_free (arena);
 }
 
-static inline void
-_pixel_plus (struct _pixel *adder_sum,
-             const struct _pixel *adder2)
+static struct _blur_arena *
+_arena_get (gsize buffer_len, gsize line_len)
 {
-  adder_sum->alpha += adder2->alpha;
-  adder_sum->red += adder2->red;
-  adder_sum->green += adder2->green;
-  adder_sum->blue += adder2->blue;
+  struct _blur_arena *arena = g_private_get (&arena_key);
+  if (arena == NULL)
+  {
+    arena = g_new0 (struct _blur_arena, 1);
+    g_private_set (&arena_key, arena);
+  }
+  if (arena->buffer_len < buffer_len)
+  {
+    g_free (arena->buffer);
+    arena->buffer = g_new (guint32, buffer_len);
+    arena->buffer_len = buffer_len;
+  }
+  if (arena->line_len < line_len)
+  {
+    g_free (arena->line);
+    arena->line = g_new (guint32, line_len);
+    arena->line_len = line_len;
+  }
+  return arena;
 }
 
 static int *
@@ -118,52 +158,318 @@ _calc_kernel (double sigma, int *size)
   return kernel;
 }
 
+static void
+_transpose (const guint32 *src,
+            int src_stride,
+            int width,
+            int height,
+            guint32 *dst)
+{
+  int bx, by, x, y;
+  for (by = 0; by < height; by += TRANSPOSE_BLOCK)
+  {
+    int y_end = MIN (by + TRANSPOSE_BLOCK, height);
+    for (bx = 0; bx < width; bx += TRANSPOSE_BLOCK)
+    {
+      int x_end = MIN (bx + TRANSPOSE_BLOCK, width);
+      for (y = by; y < y_end; y++)
+      {
+        const guint32 *row = src + y * src_stride;
+        for (x = bx; x < x_end; x++)
+          dst[x * height + y] = row[x];
+      }
+    }
+  }
+}
+
+/**
+ * Convolves kernel[first, last) with src[offset + first, offset + last). The
+ * 32-bit fixed-point accumulators are normalized by the sum of the kernel
+ * values used, so that taps falling outside the surface are ignored.
+ */
+static inline guint32
+_convolve_pixel (const guint32 *src,
+                 int offset,
+                 const int *kernel,
+                 int first,
+                 int last)
+{
+  /* The kernel sums up to at most 1 << 16, so a channel never exceeds
+     0xff << 16 */
+  guint32 alpha = 0, red = 0, green = 0, blue = 0, sum = 0;
+  int i;
+  for (i = first; i < last; i++)
+  {
+    guint32 value = src[offset + i];
+    guint32 k = kernel[i];
+    sum += k;
+    alpha += (value >> 24) * k;
+    red += ((value >> 16) & 0xff) * k;
+    green += ((value >> 8) & 0xff) * k;
+    blue += (value & 0xff) * k;
+  }
+  alpha = MIN (alpha / sum, 0xff);
+  red = MIN (red / sum, 0xff);
+  green = MIN (green / sum, 0xff);
+  blue = MIN (blue / sum, 0xff);
+  return (alpha << 24) | (red << 16) | (green << 8) | blue;
+}
+
+static void
+_convolve_scalar (const guint32 *src,
+                  guint32 *dst,
+                  int dst_stride,
+                  int start,
+                  int end,
+                  const int *kernel,
+                  int kernel_size,
+                  guint32 kernel_sum)
+{
+  int orig = kernel_size / 2;
+  int j;
+  for (j = start; j < end; j++)
+    dst[j * dst_stride] = _convolve_pixel (src, j - orig, kernel,
+                                           0, kernel_size);
+}
+
+#ifdef OL_BLUR_X86
+
+/* The SIMD kernels divide by multiplying with the reciprocal of the kernel
+ * sum in double precision. Both the accumulator (< 2^24) and the kernel sum
+ * (<= 2^16) are small enough that the rounding error stays far below
+ * DIVISION_BIAS, which in turn is below 1 / kernel_sum, so truncating
+ * acc * (1 / sum) + DIVISION_BIAS gives exactly acc / sum. */
+#define DIVISION_BIAS (1.0 / (1 << 20))
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+_sse2_divide (__m128i acc, __m128d recip, __m128d bias)
+{
+  __m128d lo = _mm_cvtepi32_pd (acc);
+  __m128d hi = _mm_cvtepi32_pd (_mm_srli_si128 (acc, 8));
+  lo = _mm_add_pd (_mm_mul_pd (lo, recip), bias);
+  hi = _mm_add_pd (_mm_mul_pd (hi, recip), bias);
+  return _mm_unpacklo_epi64 (_mm_cvttpd_epi32 (lo), _mm_cvttpd_epi32 (hi));
+}
+
+/* Requires every kernel value to fit in 16 bits, see _select_convolve */
+__attribute__ ((target ("sse2")))
+static void
+_convolve_sse2 (const guint32 *src,
+                guint32 *dst,
+                int dst_stride,
+                int start,
+                int end,
+                const int *kernel,
+                int kernel_size,
+                guint32 kernel_sum)
+{
+  int orig = kernel_size / 2;
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128d recip = _mm_set1_pd (1.0 / kernel_sum);
+  const __m128d bias = _mm_set1_pd (DIVISION_BIAS);
+  int i, j;
+  /* Two pixels a time. Each channel is widened to 16 bits and multiplied
+     with the low and high halves of the 32-bit products computed
+     separately. */
+  for (j = start; j + 2 <= end; j += 2)
+  {
+    const guint32 *p = src + j - orig;
+    __m128i acc0 = zero, acc1 = zero;
+    for (i = 0; i < kernel_size; i++)
+    {
+      __m128i pixels = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) (p + i)),
+                                          zero);
+      __m128i k = _mm_set1_epi16 ((short) kernel[i]);
+      __m128i lo = _mm_mullo_epi16 (pixels, k);
+      __m128i hi = _mm_mulhi_epu16 (pixels, k);
+      acc0 = _mm_add_epi32 (acc0, _mm_unpacklo_epi16 (lo, hi));
+      acc1 = _mm_add_epi32 (acc1, _mm_unpackhi_epi16 (lo, hi));
+    }
+    __m128i packed = _mm_packs_epi32 (_sse2_divide (acc0, recip, bias),
+                                      _sse2_divide (acc1, recip, bias));
+    packed = _mm_packus_epi16 (packed, packed);
+    if (dst_stride == 1)
+    {
+      _mm_storel_epi64 ((__m128i *) (dst + j), packed);
+    }
+    else
+    {
+      dst[j * dst_stride] = _mm_cvtsi128_si32 (packed);
+      dst[(j + 1) * dst_stride] = _mm_cvtsi128_si32 (_mm_srli_si128 (packed, 4));
+    }
+  }
+  _convolve_scalar (src, dst, dst_stride, j, end,
+                    kernel, kernel_size, kernel_sum);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m128i
+_avx2_divide (__m128i acc, __m256d recip, __m256d bias)
+{
+  __m256d value = _mm256_add_pd (_mm256_mul_pd (_mm256_cvtepi32_pd (acc), recip),
+                                 bias);
+  return _mm256_cvttpd_epi32 (value);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+_convolve_avx2 (const guint32 *src,
+                guint32 *dst,
+                int dst_stride,
+                int start,
+                int end,
+                const int *kernel,
+                int kernel_size,
+                guint32 kernel_sum)
+{
+  int orig = kernel_size / 2;
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256d recip = _mm256_set1_pd (1.0 / kernel_sum);
+  const __m256d bias = _mm256_set1_pd (DIVISION_BIAS);
+  int i, j;
+  /* Four pixels a time, two in each 256-bit accumulator */
+  for (j = start; j + 4 <= end; j += 4)
+  {
+    const guint32 *p = src + j - orig;
+    __m256i acc0 = zero, acc1 = zero;
+    for (i = 0; i < kernel_size; i++)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) (p + i));
+      __m256i k = _mm256_set1_epi32 (kernel[i]);
+      acc0 = _mm256_add_epi32 (acc0,
+                               _mm256_mullo_epi32 (_mm256_cvtepu8_epi32 (pixels), k));
+      acc1 = _mm256_add_epi32 (acc1,
+                               _mm256_mullo_epi32 (_mm256_cvtepu8_epi32 (_mm_srli_si128 (pixels, 8)),
+                                                   k));
+    }
+    __m128i q0 = _avx2_divide (_mm256_castsi256_si128 (acc0), recip, bias);
+    __m128i q1 = _avx2_divide (_mm256_extracti128_si256 (acc0, 1), recip, bias);
+    __m128i q2 = _avx2_divide (_mm256_castsi256_si128 (acc1), recip, bias);
+    __m128i q3 = _avx2_divide (_mm256_extracti128_si256 (acc1, 1), recip, bias);
+    __m128i packed = _mm_packus_epi16 (_mm_packs_epi32 (q0, q1),
+                                       _mm_packs_epi32 (q2, q3));
+    if (dst_stride == 1)
+    {
+      _mm_storeu_si128 ((__m128i *) (dst + j), packed);
+    }
+    else
+    {
+      dst[j * dst_stride] = _mm_cvtsi128_si32 (packed);
+      dst[(j + 1) * dst_stride] = _mm_cvtsi128_si32 (_mm_srli_si128 (packed, 4));
+      dst[(j + 2) * dst_stride] = _mm_cvtsi128_si32 (_mm_srli_si128 (packed, 8));
+      dst[(j + 3) * dst_stride] = _mm_cvtsi128_si32 (_mm_srli_si128 (packed, 12));
+    }
+  }
+  _convolve_scalar (src, dst, dst_stride, j, end,
+                    kernel, kernel_size, kernel_sum);
+}
+
+#endif  /* OL_BLUR_X86 */
+
+static _convolve_func
+_select_convolve (enum OlBlurImpl impl,
+                  const int *kernel,
+                  int kernel_size)
+{
+#ifdef OL_BLUR_X86
+  if ((impl == OL_BLUR_IMPL_AUTO || impl == OL_BLUR_IMPL_AVX2) &&
+      __builtin_cpu_supports ("avx2"))
+    return _convolve_avx2;
+  if (impl == OL_BLUR_IMPL_AUTO || impl == OL_BLUR_IMPL_SSE2)
+  {
+    int i;
+    gboolean fits_16bit = __builtin_cpu_supports ("sse2");
+    for (i = 0; i < kernel_size && fits_16bit; i++)
+      if (kernel[i] > G_MAXUINT16)
+        fits_16bit = FALSE;
+    if (fits_16bit)
+      return _convolve_sse2;
+  }
+#endif
+  return _convolve_scalar;
+}
+
+static void
+_convolve_row (const guint32 *src,
+               int len,
+               guint32 *dst,
+               int dst_stride,
+               const int *kernel,
+               int kernel_size,
+               guint32 kernel_sum,
+               _convolve_func convolve)
+{
+  int orig = kernel_size / 2;
+  int start = MIN (orig, len);
+  int end = MAX (len - orig, start);
+  int j;
+  /* Pixels near the border only have part of their neighbours */
+  for (j = 0; j < start; j++)
+    dst[j * dst_stride] = _convolve_pixel (src, j - orig, kernel,
+                                           orig - j,
+                                           MIN (kernel_size, len - j + orig));
+  convolve (src, dst, dst_stride, start, end, kernel, kernel_size, kernel_sum);
+  for (j = end; j < len; j++)
+    dst[j * dst_stride] = _convolve_pixel (src, j - orig, kernel,
+                                           MAX (0, orig - j),
+                                           len - j + orig);
+}
+
 static void _apply_kernel (cairo_surface_t *surface,
                            const int *kernel,
                            int kernel_size)
 {
   ol_assert (kernel_size > 0 && kernel_size % 2 == 1);
   ol_assert (kernel != NULL);
-  static const int DIR[2][2] = {{0, 1}, {1, 0}};
   guint32 *pixels = (guint32*) cairo_image_surface_get_data (surface);
   int width = cairo_image_surface_get_width (surface);
   int height = cairo_image_surface_get_height (surface);
+  int stride = cairo_image_surface_get_stride (surface) / sizeof (guint32);
   if (pixels == NULL || width <= 0 || height <= 0)
   {
     ol_errorf ("Invalid image surface");
     return;
   }
-  int kernel_orig = kernel_size / 2;
-  int d, i, x, y;
-  for (d = 0; d < 2; d++)
+  guint32 kernel_sum = 0;
+  int i, x, y;
+  for (i = 0; i < kernel_size; i++)
+    kernel_sum += kernel[i];
+  _convolve_func convolve = _select_convolve (forced_impl, kernel, kernel_size);
+  struct _blur_arena *arena = _arena_get ((gsize) width * height,
+                                          MAX (width, height));
+  /* Vertical pass: columns are transposed into rows of the scratch buffer so
+     that the convolution reads memory sequentially, and the results are
+     written back to the columns of the surface. */
+  _transpose (pixels, stride, width, height, arena->buffer);
+  for (x = 0; x < width; x++)
+    _convolve_row (arena->buffer + x * height, height, pixels + x, stride,
+                   kernel, kernel_size, kernel_sum, convolve);
+  /* Horizontal pass */
+  for (y = 0; y < height; y++)
   {
-    guint32 *old_pixels = g_new (guint32, width * height);
-    memcpy (old_pixels, pixels, sizeof (guint32) * width * height);
-    for (x = 0; x < width; x++)
-      for (y = 0; y < height; y++)
-      {
-        struct _pixel final_value = {0};
-        int sum = 0;
-        for (i = 0; i < kernel_size; i++)
-        {
-          int x1 = x + (i - kernel_orig) * DIR[d][0];
-          int y1 = y + (i - kernel_orig) * DIR[d][1];
-          int index1 = _pos_to_index (x1, y1, width, height);
-          if (index1 > 0)
-          {
-            sum += kernel[i];
-            struct _pixel value = _num_to_pixel_with_factor (old_pixels[index1],
-                                                             kernel[i]);
-            _pixel_plus (&final_value, &value);
-          }
-        }
-        int index = _pos_to_index (x, y, width, height);
-        pixels[index] = _pixel_to_num_with_divisor (&final_value, sum);
-      }
-    g_free (old_pixels);
+    guint32 *row = pixels + y * stride;
+    memcpy (arena->line, row, sizeof (guint32) * width);
+    _convolve_row (arena->line, width, row, 1,
+                   kernel, kernel_size, kernel_sum, convolve);
   }
 }
 
+int
+ol_gussian_blur_set_impl (enum OlBlurImpl impl)
+{
+#ifdef OL_BLUR_X86
+  if ((impl == OL_BLUR_IMPL_SSE2 && !__builtin_cpu_supports ("sse2")) ||
+      (impl == OL_BLUR_IMPL_AVX2 && !__builtin_cpu_supports ("avx2")))
+    return 0;
+#else
+  if (impl == OL_BLUR_IMPL_SSE2 || impl == OL_BLUR_IMPL_AVX2)
+    return 0;
+#endif
+  forced_impl = impl;
+  return 1;
+}
+
 void
 ol_gussian_blur (cairo_surface_t *surface,
                  double sigma)
@@ -182,4 +488,3 @@ ol_gussian_blur (cairo_surface_t *surface,
   _apply_kernel (surface, kernel, kernel_size);
   g_free (kernel);
 }
-
@@ -18,8 +18,18 @@
  * along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>. 
  */
 
+#ifndef _OL_GUSSIAN_BLUR_H_
+#define _OL_GUSSIAN_BLUR_H_
+
 #include <cairo.h>
 
+enum OlBlurImpl {
+  OL_BLUR_IMPL_AUTO = 0,
+  OL_BLUR_IMPL_SCALAR,
+  OL_BLUR_IMPL_SSE2,
+  OL_BLUR_IMPL_AVX2,
+};
+
 /** 
  * Apply Gussian blur to a cairo image surface
  *
@@ -29,3 +39,15 @@
  */
 void ol_gussian_blur (cairo_surface_t *surface,
                       double sigma);
+
+/** 
+ * Forces the blur engine to use a particular implementation instead of the
+ * fastest one supported by the CPU. Mainly used by tests and benchmarks.
+ *
+ * @param impl The implementation to use. OL_BLUR_IMPL_AUTO restores the
+ *        runtime detection.
+ * @return 1 if the implementation is available on this machine, or 0 if not.
+ */
+int ol_gussian_blur_set_impl (enum OlBlurImpl impl);
+
+#endif /* _OL_GUSSIAN_BLUR_H_ */
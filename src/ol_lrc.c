@@ -21,6 +21,7 @@
 #include <string.h>
 #include <glib.h>
 #include "ol_lrc.h"
+#include "ol_utils.h"
 #include "ol_debug.h"
 
 static const int DEFAULT_LAST_DURATION = 5000;
@@ -31,12 +32,6 @@ struct _OlLrcIter
   OlLrc *lrc;
 };
 
-struct OlLrcItem
-{
-  int timestamp;
-  char *text;
-};
-
 typedef struct _OlLrcPrivate OlLrcPrivate;
 
 struct _OlLrcPrivate
@@ -44,7 +39,15 @@ struct _OlLrcPrivate
   char *uri;
   int offset;
   GHashTable *metadata;
-  GPtrArray *items;
+  /* Lines are stored as arrays in one block of memory, with texts in an
+     arena of nul-terminated strings. */
+  guint count;
+  guint capacity;
+  gint64 *timestamps;
+  guint32 *text_offsets;
+  guint *next_nonempty;       /* next_nonempty[i] is the first non-empty line
+                                 from i, or count if none. */
+  GString *texts;
   guint64 duration;
   OlLyrics *lyric_proxy;
   guint save_offset_timer;
@@ -61,12 +64,42 @@ struct SaveOffsetData
 
 /* -------------- OlLrc private methods ------------------*/
 static void ol_lrc_finalize (GObject *object);
-/* -------------- OlLrcItem private methods --------------*/
-static struct OlLrcItem *ol_lrc_item_new (gint64 timestamp, const gchar *text);
-static void ol_lrc_item_free (struct OlLrcItem *item);
+/* -------------- Line storage methods -------------------*/
+static void ol_lrc_clear_lines (OlLrc *lrc,
+                                guint capacity,
+                                gsize text_capacity);
+static void ol_lrc_reserve_lines (OlLrc *lrc, guint capacity);
+static void ol_lrc_append_line (OlLrc *lrc,
+                                gint64 timestamp,
+                                const gchar *text);
+static void ol_lrc_update_next_nonempty (OlLrc *lrc);
+/* -------------- LRC parsing methods -------------------*/
+static void ol_lrc_update_offset_from_attributes (OlLrc *lrc);
+static const gchar *ol_lrc_find_tag_end (const gchar *tag,
+                                         const gchar *line_end);
+static gboolean ol_lrc_parse_timestamp (const gchar *tag,
+                                        const gchar *tag_end,
+                                        gint64 *timestamp);
+static gboolean ol_lrc_parse_attribute (OlLrc *lrc,
+                                        const gchar *tag,
+                                        const gchar *tag_end);
+static gsize ol_lrc_get_line_break_len (const gchar *p,
+                                        const gchar *end);
+static void ol_lrc_parse_line (OlLrc *lrc,
+                               const gchar *line,
+                               const gchar *line_end);
+static void ol_lrc_sort_lines (OlLrc *lrc);
 /* -------------- OlLrcIter private methods --------------*/
 static OlLrcIter *ol_lrc_iter_new (OlLrc *lrc, guint index);
-static struct OlLrcItem *ol_lrc_iter_get_item (OlLrcIter *iter);
+static gboolean ol_lrc_iter_check (OlLrcIter *iter);
+/* -------------- Line accessors by id ------------------ */
+static const char *ol_lrc_get_line_text (OlLrc *lrc, guint id);
+static guint ol_lrc_search_timestamp (OlLrc *lrc, gint64 timestamp);
+static gint64 ol_lrc_get_line_timestamp (OlLrc *lrc, guint id);
+static guint64 ol_lrc_get_line_duration (OlLrc *lrc, guint id);
+static gdouble ol_lrc_compute_line_percentage (OlLrc *lrc,
+                                               guint id,
+                                               gint64 time_ms);
 /* ---------------Save offset functions ----------------- */
 static gboolean _save_offset_timeout (OlLrc *lrc);
 
@@ -89,9 +122,10 @@ ol_lrc_init (OlLrc *lrc)
   if((OL_LRC(lrc))->priv != NULL)
   {
     OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
-    priv->items = g_ptr_array_new_with_free_func ((GDestroyNotify) ol_lrc_item_free);
     /* ensure there is at lease one line */
-    g_ptr_array_add (priv->items, ol_lrc_item_new (0, ""));
+    ol_lrc_clear_lines (lrc, 1, 1);
+    ol_lrc_append_line (lrc, 0, "");
+    ol_lrc_update_next_nonempty (lrc);
 
     priv->metadata = g_hash_table_new_full (g_str_hash,
                                             g_str_equal,
@@ -145,7 +179,12 @@ ol_lrc_finalize (GObject *object)
                           priv->uri,
                           priv->offset);
   }
-  g_ptr_array_free (priv->items, TRUE);
+  g_free (priv->timestamps);
+  g_string_free (priv->texts, TRUE);
+  priv->timestamps = NULL;
+  priv->text_offsets = NULL;
+  priv->next_nonempty = NULL;
+  priv->texts = NULL;
   g_hash_table_destroy (priv->metadata);
   g_free (priv->uri);
   if (priv->lyric_proxy)
@@ -153,7 +192,6 @@ ol_lrc_finalize (GObject *object)
     g_object_unref (priv->lyric_proxy);
     priv->lyric_proxy = NULL;
   }
-  priv->items = NULL;
   priv->metadata = NULL;
   priv->uri = NULL;
   G_OBJECT_CLASS (ol_lrc_parent_class)->finalize (object);
@@ -176,6 +214,13 @@ ol_lrc_set_attributes_from_variant (OlLrc *lrc,
     ol_debugf ("LRC attribute: %s -> %s\n", key, value);
   }
   g_variant_iter_free (iter);
+  ol_lrc_update_offset_from_attributes (lrc);
+}
+
+static void
+ol_lrc_update_offset_from_attributes (OlLrc *lrc)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
   const char *offset = NULL;
   if ((offset = g_hash_table_lookup (priv->metadata, "offset")) != NULL)
     priv->offset = atoi (offset);
@@ -189,31 +234,35 @@ ol_lrc_set_content_from_variant (OlLrc *lrc,
 {
   ol_assert (OL_IS_LRC (lrc));
   ol_assert (content != NULL);
-  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
-  g_ptr_array_remove_range (priv->items, 0, priv->items->len);
-  GVariantIter *iter = NULL;
-  g_variant_get (content, "aa{sv}", &iter);
-  GVariantIter *dict_iter = NULL;
-  while (g_variant_iter_loop (iter, "a{sv}", &dict_iter))
+  /* The serialized content is larger than the texts in it, so the arena
+     never grows while filling. */
+  ol_lrc_clear_lines (lrc,
+                      MAX (g_variant_n_children (content), 1),
+                      g_variant_get_size (content) + 1);
+  GVariantIter iter;
+  GVariantIter dict_iter;
+  GVariant *dict = NULL;
+  g_variant_iter_init (&iter, content);
+  while ((dict = g_variant_iter_next_value (&iter)) != NULL)
   {
-    gchar *key = NULL;
+    const gchar *key = NULL;
     GVariant *value = NULL;
-    if (g_variant_iter_n_children (dict_iter) < 3)
+    g_variant_iter_init (&dict_iter, dict);
+    if (g_variant_iter_n_children (&dict_iter) < 3)
     {
       ol_errorf ("The attributes of a lyric line is not enough, expect 3 attributes "
                  "(id, timestame, text) but there are only %d attributes.\n",
-                 g_variant_iter_n_children (dict_iter));
+                 (int) g_variant_iter_n_children (&dict_iter));
+      g_variant_unref (dict);
       continue;
     }
-    guint id = 0;
     gint64 timestamp = 0;
     const gchar *text = NULL;
     gboolean has_id = FALSE, has_timestamp = FALSE;
-    while (g_variant_iter_loop (dict_iter, "{sv}", &key, &value))
+    while (g_variant_iter_next (&dict_iter, "{&sv}", &key, &value))
     {
       if (strcmp (key, "id") == 0)
       {
-        id = g_variant_get_uint32 (value);
         has_id = TRUE;
       }
       else if (strcmp (key, "timestamp") == 0)
@@ -223,17 +272,18 @@ ol_lrc_set_content_from_variant (OlLrc *lrc,
       }
       else if (strcmp (key, "text") == 0)
       {
+        /* The string is owned by the content, which outlives value */
         text = g_variant_get_string (value, NULL);
       }
       else
       {
         ol_errorf ("Unknown line attribute: %s\n", key);
       }
+      g_variant_unref (value);
     } /* for dict_iter */
     if (has_id && has_timestamp && text != NULL)
     {
-      g_ptr_array_add (priv->items, ol_lrc_item_new (timestamp, text));
-      ol_infof ("new lyric item: %d, %d: %s\n", (int)id, (int)timestamp, text);
+      ol_lrc_append_line (lrc, timestamp, text);
     }
     else
     {
@@ -244,11 +294,385 @@ ol_lrc_set_content_from_variant (OlLrc *lrc,
       if (!text)
         ol_errorf ("missing text in lyric line\n");
     } /* if */
+    g_variant_unref (dict);
   } /* for iter */
-  g_variant_iter_free (iter);
   /* Ensure there are at least one item */
-  if (priv->items->len == 0)
-    g_ptr_array_add (priv->items, ol_lrc_item_new (0, ""));
+  if (ol_lrc_get_item_count (lrc) == 0)
+    ol_lrc_append_line (lrc, 0, "");
+  ol_lrc_update_next_nonempty (lrc);
+  ol_debugf ("%u lines of lyrics, %" G_GSIZE_FORMAT " bytes of text\n",
+             ol_lrc_get_item_count (lrc),
+             OL_LRC_GET_PRIVATE (lrc)->texts->len);
+}
+
+static void
+ol_lrc_clear_lines (OlLrc *lrc,
+                    guint capacity,
+                    gsize text_capacity)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  priv->count = 0;
+  if (capacity > priv->capacity)
+  {
+    g_free (priv->timestamps);
+    priv->timestamps = NULL;
+    priv->capacity = 0;
+    ol_lrc_reserve_lines (lrc, capacity);
+  }
+  if (priv->texts == NULL || priv->texts->allocated_len < text_capacity)
+  {
+    if (priv->texts != NULL)
+      g_string_free (priv->texts, TRUE);
+    priv->texts = g_string_sized_new (text_capacity);
+  }
+  else
+  {
+    g_string_truncate (priv->texts, 0);
+  }
+}
+
+static void
+ol_lrc_reserve_lines (OlLrc *lrc,
+                      guint capacity)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  if (capacity <= priv->capacity)
+    return;
+  gint64 *timestamps = g_malloc (capacity * (sizeof (gint64) +
+                                             sizeof (guint32) +
+                                             sizeof (guint)));
+  guint32 *text_offsets = (guint32 *) (timestamps + capacity);
+  guint *next_nonempty = (guint *) (text_offsets + capacity);
+  if (priv->count > 0)
+  {
+    memcpy (timestamps, priv->timestamps, priv->count * sizeof (gint64));
+    memcpy (text_offsets, priv->text_offsets, priv->count * sizeof (guint32));
+    memcpy (next_nonempty, priv->next_nonempty, priv->count * sizeof (guint));
+  }
+  g_free (priv->timestamps);
+  priv->timestamps = timestamps;
+  priv->text_offsets = text_offsets;
+  priv->next_nonempty = next_nonempty;
+  priv->capacity = capacity;
+}
+
+static void
+ol_lrc_append_line (OlLrc *lrc,
+                    gint64 timestamp,
+                    const gchar *text)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  if (text == NULL)
+    text = "";
+  if (priv->count == priv->capacity)
+    ol_lrc_reserve_lines (lrc, MAX (priv->capacity * 2, 16));
+  priv->timestamps[priv->count] = timestamp;
+  priv->text_offsets[priv->count] = priv->texts->len;
+  /* Keep the terminating nul of each text in the arena */
+  g_string_append_len (priv->texts, text, strlen (text) + 1);
+  priv->count++;
+}
+
+static void
+ol_lrc_update_next_nonempty (OlLrc *lrc)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  guint next = priv->count;
+  gint i;
+  for (i = priv->count - 1; i >= 0; i--)
+  {
+    if (!ol_is_string_empty (ol_lrc_get_line_text (lrc, i)))
+      next = i;
+    priv->next_nonempty[i] = next;
+  }
+}
+
+gboolean
+ol_lrc_set_content_from_raw (OlLrc *lrc,
+                             const gchar *content,
+                             gssize len,
+                             const gchar *charset)
+{
+  ol_assert_ret (OL_IS_LRC (lrc), FALSE);
+  ol_assert_ret (content != NULL, FALSE);
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  gchar *converted = NULL;
+  if (len < 0)
+    len = strlen (content);
+  if (charset != NULL && g_ascii_strcasecmp (charset, "UTF-8") != 0)
+  {
+    GError *error = NULL;
+    gsize converted_len = 0;
+    converted = g_convert_with_fallback (content, len, "UTF-8", charset,
+                                         NULL, NULL, &converted_len, &error);
+    if (converted == NULL)
+    {
+      ol_errorf ("Cannot convert LRC from %s: %s\n", charset, error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+    content = converted;
+    len = converted_len;
+  }
+  const gchar *end = content + len;
+  const gchar *line = content;
+  /* Skip the UTF-8 BOM */
+  if (len >= 3 && memcmp (content, "\xef\xbb\xbf", 3) == 0)
+    line += 3;
+  /* The texts are not longer than the content, and there is usually one
+     timestamp a line */
+  guint line_count = 1;
+  const gchar *p;
+  for (p = memchr (line, '\n', end - line); p != NULL;
+       p = memchr (p + 1, '\n', end - p - 1))
+    line_count++;
+  g_hash_table_remove_all (priv->metadata);
+  ol_lrc_clear_lines (lrc, line_count, len + 1);
+  while (line < end)
+  {
+    const gchar *line_end = line;
+    gsize break_len = 0;
+    while (line_end < end &&
+           (break_len = ol_lrc_get_line_break_len (line_end, end)) == 0)
+      line_end++;
+    ol_lrc_parse_line (lrc, line, line_end);
+    line = line_end + break_len;
+  }
+  if (priv->count == 0)
+    ol_lrc_append_line (lrc, 0, "");
+  ol_lrc_sort_lines (lrc);
+  ol_lrc_update_next_nonempty (lrc);
+  ol_lrc_update_offset_from_attributes (lrc);
+  ol_debugf ("%u lines of lyrics parsed from %" G_GSSIZE_FORMAT " bytes\n",
+             priv->count, len);
+  g_free (converted);
+  return TRUE;
+}
+
+/**
+ * Finds the ']' that closes the tag starting at tag, which points to a '['.
+ *
+ * @return The position of the ']', or NULL if the tag is not closed in the
+ *         line or there is a '[' in it.
+ */
+static const gchar *
+ol_lrc_find_tag_end (const gchar *tag,
+                     const gchar *line_end)
+{
+  const gchar *p;
+  for (p = tag + 1; p < line_end; p++)
+  {
+    if (*p == ']')
+      return p;
+    if (*p == '[')
+      return NULL;
+  }
+  return NULL;
+}
+
+/**
+ * Parses tags like [ss], [mm:ss.xx] or [h:mm:ss.xx]. tag and tag_end point to
+ * the brackets.
+ */
+static gboolean
+ol_lrc_parse_timestamp (const gchar *tag,
+                        const gchar *tag_end,
+                        gint64 *timestamp)
+{
+  static const gint64 FACTORS[] = { 1000, 60 * 1000, 60 * 60 * 1000 };
+  gint64 fields[G_N_ELEMENTS (FACTORS)];
+  guint field_count = 0;
+  gint64 ms = 0;
+  const gchar *p = tag + 1;
+  while (TRUE)
+  {
+    gint64 value = 0;
+    const gchar *digits = p;
+    for (; p < tag_end && g_ascii_isdigit (*p); p++)
+    {
+      if (value > G_MAXINT64 / 10 / FACTORS[G_N_ELEMENTS (FACTORS) - 1])
+        return FALSE;
+      value = value * 10 + (*p - '0');
+    }
+    if (p == digits || field_count >= G_N_ELEMENTS (fields))
+      return FALSE;
+    fields[field_count++] = value;
+    if (p < tag_end && *p == ':')
+      p++;
+    else
+      break;
+  }
+  if (p < tag_end && *p == '.')
+  {
+    /* Fractions of second, precise to milliseconds */
+    gint factor = 100;
+    const gchar *digits = ++p;
+    for (; p < tag_end && g_ascii_isdigit (*p); p++)
+    {
+      ms += (*p - '0') * factor;
+      factor /= 10;
+    }
+    if (p == digits)
+      return FALSE;
+  }
+  if (p != tag_end)
+    return FALSE;
+  guint i;
+  for (i = 0; i < field_count; i++)
+    ms += fields[field_count - 1 - i] * FACTORS[i];
+  *timestamp = ms;
+  return TRUE;
+}
+
+/**
+ * Parses tags like [key:value], where key consists of letters, digits and
+ * underscores. tag and tag_end point to the brackets.
+ */
+static gboolean
+ol_lrc_parse_attribute (OlLrc *lrc,
+                        const gchar *tag,
+                        const gchar *tag_end)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  const gchar *key = tag + 1;
+  const gchar *p = key;
+  while (p < tag_end && *p != ':')
+  {
+    gunichar c = g_utf8_get_char_validated (p, tag_end - p);
+    if (c == (gunichar) -1 || c == (gunichar) -2 ||
+        !(g_unichar_isalnum (c) || c == '_'))
+      return FALSE;
+    p = g_utf8_next_char (p);
+  }
+  if (p == key || p >= tag_end)
+    return FALSE;
+  g_hash_table_replace (priv->metadata,
+                        g_strndup (key, p - key),
+                        g_strndup (p + 1, tag_end - p - 1));
+  return TRUE;
+}
+
+/**
+ * Gets the length of the line break at p in UTF-8 content.
+ *
+ * The line breaks are the ones that str.splitlines() in Python breaks lines
+ * at, so that the content is split into the same lines as
+ * osdlyrics.lrc.parse_lrc does.
+ *
+ * @return The length of the line break in bytes, or 0 if p is not at a line
+ *         break.
+ */
+static gsize
+ol_lrc_get_line_break_len (const gchar *p,
+                           const gchar *end)
+{
+  switch ((guchar) p[0])
+  {
+  case '\r':
+    return p + 1 < end && p[1] == '\n' ? 2 : 1;
+  case '\n':
+  case '\v':
+  case '\f':
+  case 0x1c:
+  case 0x1d:
+  case 0x1e:
+    return 1;
+  case 0xc2:
+    /* U+0085 NEXT LINE */
+    return p + 1 < end && (guchar) p[1] == 0x85 ? 2 : 0;
+  case 0xe2:
+    /* U+2028 LINE SEPARATOR and U+2029 PARAGRAPH SEPARATOR */
+    return (p + 2 < end && (guchar) p[1] == 0x80 &&
+            ((guchar) p[2] == 0xa8 || (guchar) p[2] == 0xa9)) ? 3 : 0;
+  default:
+    return 0;
+  }
+}
+
+static void
+ol_lrc_parse_line (OlLrc *lrc,
+                   const gchar *line,
+                   const gchar *line_end)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  guint first = priv->count;
+  const gchar *p = line;
+  while (p < line_end && *p == '[')
+  {
+    const gchar *tag_end = ol_lrc_find_tag_end (p, line_end);
+    gint64 timestamp;
+    if (tag_end == NULL)
+      break;
+    if (ol_lrc_parse_timestamp (p, tag_end, &timestamp))
+    {
+      if (priv->count == priv->capacity)
+        ol_lrc_reserve_lines (lrc, MAX (priv->capacity * 2, 16));
+      priv->timestamps[priv->count++] = timestamp;
+    }
+    else if (!ol_lrc_parse_attribute (lrc, p, tag_end))
+    {
+      break;
+    }
+    p = tag_end + 1;
+  }
+  if (priv->count == first)
+    return;
+  /* All the timestamps of the line share the text */
+  guint32 text_offset = priv->texts->len;
+  guint i;
+  g_string_append_len (priv->texts, p, line_end - p);
+  g_string_append_c (priv->texts, '\0');
+  for (i = first; i < priv->count; i++)
+    priv->text_offsets[i] = text_offset;
+}
+
+static gint
+_compare_lines (gconstpointer a,
+                gconstpointer b,
+                gpointer user_data)
+{
+  gint64 ta = *(const gint64 *) a;
+  gint64 tb = *(const gint64 *) b;
+  return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+static void
+ol_lrc_sort_lines (OlLrc *lrc)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  struct { gint64 timestamp; guint32 text_offset; } *lines;
+  guint i;
+  for (i = 1; i < priv->count; i++)
+    if (priv->timestamps[i] < priv->timestamps[i - 1])
+      break;
+  if (i >= priv->count)
+    return;
+  lines = g_malloc (priv->count * sizeof (*lines));
+  for (i = 0; i < priv->count; i++)
+  {
+    lines[i].timestamp = priv->timestamps[i];
+    lines[i].text_offset = priv->text_offsets[i];
+  }
+  /* g_qsort_with_data is stable, lines with the same timestamps keep their
+     order in the file */
+  g_qsort_with_data (lines, priv->count, sizeof (*lines), _compare_lines, NULL);
+  for (i = 0; i < priv->count; i++)
+  {
+    priv->timestamps[i] = lines[i].timestamp;
+    priv->text_offsets[i] = lines[i].text_offset;
+  }
+  g_free (lines);
+}
+
+gint
+ol_lrc_get_next_nonempty_id (OlLrc *lrc,
+                             guint id)
+{
+  ol_assert_ret (OL_IS_LRC (lrc), -1);
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  if (id >= priv->count || priv->next_nonempty[id] >= priv->count)
+    return -1;
+  return priv->next_nonempty[id];
 }
 
 const char *
@@ -266,7 +690,7 @@ ol_lrc_get_item_count (OlLrc *lrc)
 {
   ol_assert_ret (OL_IS_LRC (lrc), 0);
   OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
-  return priv->items->len;
+  return priv->count;
 }
 
 static gboolean
@@ -326,28 +750,77 @@ ol_lrc_iter_from_timestamp (OlLrc *lrc,
                             gint64 timestamp)
 {
   ol_assert_ret (OL_IS_LRC (lrc), NULL);
-  int low = 0;
-  int high = ol_lrc_get_item_count (lrc) - 1;
-  OlLrcIter *iter = ol_lrc_iter_from_id (lrc, 0);
+  return ol_lrc_iter_new (lrc, ol_lrc_search_timestamp (lrc, timestamp));
+}
+
+static guint
+ol_lrc_search_timestamp (OlLrc *lrc,
+                         gint64 timestamp)
+{
+  guint low = 0;
+  guint high = ol_lrc_get_item_count (lrc) - 1;
   /* Binary search */
   while (low < high)
   {
-    int mid = (low + high + 1) / 2;
-    ol_lrc_iter_move_to (iter, mid);
-    if (ol_lrc_iter_get_timestamp (iter) <= timestamp)
+    guint mid = (low + high + 1) / 2;
+    if (ol_lrc_get_line_timestamp (lrc, mid) <= timestamp)
       low = mid;
     else
       high = mid - 1;
   }
-  if (low == high)                    /* found */
+  return low;
+}
+
+static gint64
+ol_lrc_get_line_timestamp (OlLrc *lrc,
+                           guint id)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  return priv->timestamps[id] - priv->offset;
+}
+
+static const char *
+ol_lrc_get_line_text (OlLrc *lrc,
+                      guint id)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  return priv->texts->str + priv->text_offsets[id];
+}
+
+static guint64
+ol_lrc_get_line_duration (OlLrc *lrc,
+                          guint id)
+{
+  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (lrc);
+  if (id + 1 < priv->count)
   {
-    ol_lrc_iter_move_to (iter, low);
+    /* Not the last one */
+    return priv->timestamps[id + 1] - priv->timestamps[id];
   }
   else
   {
-    ol_errorf ("low(%d) != high(%d), this should not happen\n", low, high);
+    gint64 duration = priv->duration;
+    gint64 timestamp = ol_lrc_get_line_timestamp (lrc, id);
+    if (duration <= timestamp)
+      return DEFAULT_LAST_DURATION;
+    else
+      return duration - timestamp;
   }
-  return iter;
+}
+
+static gdouble
+ol_lrc_compute_line_percentage (OlLrc *lrc,
+                                guint id,
+                                gint64 time_ms)
+{
+  gint64 timestamp = ol_lrc_get_line_timestamp (lrc, id);
+  if (time_ms <= timestamp)
+    return 0.0;
+  /* use int64 instead of uint64 to avoid negative sum problem */
+  gint64 duration = ol_lrc_get_line_duration (lrc, id);
+  if (time_ms >= timestamp + duration)
+    return 1.0;
+  return (gdouble) (time_ms - timestamp) / (gdouble) duration;
 }
 
 const char *
@@ -373,26 +846,6 @@ ol_lrc_get_duration (OlLrc *lrc)
   return priv->duration;
 }
 
-static struct OlLrcItem *
-ol_lrc_item_new (gint64 timestamp, const gchar *text)
-{
-  if (text == NULL)
-    text = "";
-  struct OlLrcItem *item = g_new (struct OlLrcItem, 1);
-  item->timestamp = timestamp;
-  item->text = g_strdup (text);
-  return item;
-}
-
-static void
-ol_lrc_item_free (struct OlLrcItem *item)
-{
-  if (item == NULL)
-    return;
-  g_free (item->text);
-  g_free (item);
-}
-
 static OlLrcIter *
 ol_lrc_iter_new (OlLrc *lrc, guint index)
 {
@@ -469,36 +922,32 @@ ol_lrc_iter_get_id (OlLrcIter *iter)
   return iter->id;
 }
 
-static struct OlLrcItem *
-ol_lrc_iter_get_item (OlLrcIter *iter)
+static gboolean
+ol_lrc_iter_check (OlLrcIter *iter)
 {
-  ol_assert_ret (iter != NULL, NULL);
+  ol_assert_ret (iter != NULL, FALSE);
   if (iter->id >= ol_lrc_get_item_count (iter->lrc))
   {
     ol_errorf ("LRC Iter is out of range. Don't use the iter after resetting the content or reaching the end.\n");
-    return NULL;
+    return FALSE;
   }
-  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (iter->lrc);
-  struct OlLrcItem *item = g_ptr_array_index (priv->items, iter->id);
-  return item;
+  return TRUE;
 }
 
 gint64
 ol_lrc_iter_get_timestamp (OlLrcIter *iter)
 {
-  struct OlLrcItem *item = ol_lrc_iter_get_item (iter);
-  if (!item)
+  if (!ol_lrc_iter_check (iter))
     return 0;
-  return item->timestamp - ol_lrc_get_offset (iter->lrc);
+  return ol_lrc_get_line_timestamp (iter->lrc, iter->id);
 }
 
 const char *
 ol_lrc_iter_get_text(OlLrcIter *iter)
 {
-  struct OlLrcItem *item = ol_lrc_iter_get_item (iter);
-  if (!item)
+  if (!ol_lrc_iter_check (iter))
     return NULL;
-  return item->text;
+  return ol_lrc_get_line_text (iter->lrc, iter->id);
 }
 
 gboolean
@@ -511,38 +960,124 @@ ol_lrc_iter_is_valid (OlLrcIter *iter)
 guint64
 ol_lrc_iter_get_duration (OlLrcIter *iter)
 {
-  struct OlLrcItem *curr = ol_lrc_iter_get_item (iter);
-  if (!curr)
+  if (!ol_lrc_iter_check (iter))
     return 0;
-  OlLrcPrivate *priv = OL_LRC_GET_PRIVATE (iter->lrc);
-  if (iter->id < ol_lrc_get_item_count (iter->lrc) - 1)
+  return ol_lrc_get_line_duration (iter->lrc, iter->id);
+}
+
+gdouble
+ol_lrc_iter_compute_percentage (OlLrcIter *iter,
+                                gint64 time_ms)
+{
+  ol_assert_ret (ol_lrc_iter_is_valid (iter), 0.0);
+  return ol_lrc_compute_line_percentage (iter->lrc, iter->id, time_ms);
+}
+
+void
+ol_lrc_cursor_init (OlLrcCursor *cursor,
+                    OlLrc *lrc)
+{
+  ol_assert (cursor != NULL);
+  cursor->lrc = lrc;
+  cursor->id = 0;
+  cursor->seek_id = 0;
+}
+
+void
+ol_lrc_cursor_seek (OlLrcCursor *cursor,
+                    gint64 timestamp)
+{
+  ol_assert (cursor != NULL);
+  ol_assert (OL_IS_LRC (cursor->lrc));
+  OlLrc *lrc = cursor->lrc;
+  guint count = ol_lrc_get_item_count (lrc);
+  guint id = cursor->seek_id;
+  /* The line found by the last seek is the right line if it starts before
+     the timestamp and the next line starts after it. Playback moves
+     forward, so checking the line and the next one is enough most of the
+     time. */
+  if (id < count &&
+      (id == 0 || ol_lrc_get_line_timestamp (lrc, id) <= timestamp))
   {
-    /* Not the last one */
-    struct OlLrcItem *next = g_ptr_array_index (priv->items, iter->id + 1);
-    return next->timestamp - curr->timestamp;
+    if (id + 1 < count && ol_lrc_get_line_timestamp (lrc, id + 1) <= timestamp)
+    {
+      id++;
+      if (id + 1 < count && ol_lrc_get_line_timestamp (lrc, id + 1) <= timestamp)
+        id = ol_lrc_search_timestamp (lrc, timestamp);
+    }
   }
   else
   {
-    gint64 duration = ol_lrc_get_duration (iter->lrc);
-    gint64 timestamp = ol_lrc_iter_get_timestamp (iter);
-    if (duration <= timestamp)
-      return DEFAULT_LAST_DURATION;
-    else
-      return duration - timestamp;
+    id = ol_lrc_search_timestamp (lrc, timestamp);
   }
+  cursor->id = id;
+  cursor->seek_id = id;
+}
+
+gboolean
+ol_lrc_cursor_move_to (OlLrcCursor *cursor,
+                       guint id)
+{
+  ol_assert_ret (cursor != NULL, FALSE);
+  if (id >= ol_lrc_get_item_count (cursor->lrc))
+    return FALSE;
+  cursor->id = id;
+  cursor->seek_id = id;
+  return TRUE;
+}
+
+gboolean
+ol_lrc_cursor_seek_nonempty (OlLrcCursor *cursor,
+                             gint64 timestamp)
+{
+  ol_assert_ret (cursor != NULL, FALSE);
+  ol_lrc_cursor_seek (cursor, timestamp);
+  gint id = ol_lrc_get_next_nonempty_id (cursor->lrc, cursor->id);
+  if (id < 0)
+    return FALSE;
+  /* Only the line pointed to moves ahead. Next seeks still start from the
+     line that fits the timestamp, so that they stay fast in a gap of empty
+     lines. */
+  cursor->id = id;
+  return TRUE;
+}
+
+guint
+ol_lrc_cursor_get_id (const OlLrcCursor *cursor)
+{
+  ol_assert_ret (cursor != NULL, 0);
+  return cursor->id;
+}
+
+gint64
+ol_lrc_cursor_get_timestamp (const OlLrcCursor *cursor)
+{
+  ol_assert_ret (cursor != NULL, 0);
+  ol_assert_ret (cursor->id < ol_lrc_get_item_count (cursor->lrc), 0);
+  return ol_lrc_get_line_timestamp (cursor->lrc, cursor->id);
+}
+
+const char *
+ol_lrc_cursor_get_text (const OlLrcCursor *cursor)
+{
+  ol_assert_ret (cursor != NULL, NULL);
+  ol_assert_ret (cursor->id < ol_lrc_get_item_count (cursor->lrc), NULL);
+  return ol_lrc_get_line_text (cursor->lrc, cursor->id);
+}
+
+guint64
+ol_lrc_cursor_get_duration (const OlLrcCursor *cursor)
+{
+  ol_assert_ret (cursor != NULL, 0);
+  ol_assert_ret (cursor->id < ol_lrc_get_item_count (cursor->lrc), 0);
+  return ol_lrc_get_line_duration (cursor->lrc, cursor->id);
 }
 
 gdouble
-ol_lrc_iter_compute_percentage (OlLrcIter *iter,
-                                gint64 time_ms)
+ol_lrc_cursor_compute_percentage (const OlLrcCursor *cursor,
+                                  gint64 time_ms)
 {
-  ol_assert_ret (ol_lrc_iter_is_valid (iter), 0.0);
-  gint64 timestamp = ol_lrc_iter_get_timestamp (iter);
-  if (time_ms <= timestamp)
-    return 0.0;
-  /* use int64 instead of uint64 to avoid negative sum problem */
-  gint64 duration = ol_lrc_iter_get_duration (iter);
-  if (time_ms >= timestamp + duration)
-    return 1.0;
-  return (gdouble) (time_ms - timestamp) / (gdouble) duration;
+  ol_assert_ret (cursor != NULL, 0.0);
+  ol_assert_ret (cursor->id < ol_lrc_get_item_count (cursor->lrc), 0.0);
+  return ol_lrc_compute_line_percentage (cursor->lrc, cursor->id, time_ms);
 }
@@ -64,6 +64,25 @@ GType ol_lrc_get_type (void);
 typedef struct _OlLrcIter OlLrcIter;
 struct _OlLrcIter;
 
+/**
+ * @brief A cursor to follow the playing line of an LRC file
+ *
+ * Unlike OlLrcIter, a cursor doesn't allocate memory and can be embedded in
+ * other structures or put on the stack. It remembers the last line it found,
+ * so seeking to an increasing timestamp costs constant time in common cases.
+ * A binary search is performed only if the timestamp jumps.
+ *
+ * A cursor doesn't hold a reference of the lrc. It stays usable after the
+ * content or offset of the lrc changes.
+ */
+typedef struct _OlLrcCursor OlLrcCursor;
+struct _OlLrcCursor
+{
+  OlLrc *lrc;
+  guint id;
+  guint seek_id;                /* The line that fits the last timestamp */
+};
+
 /**
  * @brief Create a new OlLrc instance
  *
@@ -107,6 +126,26 @@ void ol_lrc_set_attributes_from_variant (OlLrc *lrc,
 void ol_lrc_set_content_from_variant (OlLrc *lrc,
                                       GVariant *content);
 
+/**
+ * Parses the content of an LRC file and sets it as the LRC content
+ *
+ * The syntax is the same as osdlyrics.lrc.parse_lrc in the daemon. The
+ * attributes of the lrc are replaced by the ones in the content. If there is
+ * no lyric line in the content, the lrc will contain one empty line.
+ *
+ * @param lrc
+ * @param content The content of the LRC file.
+ * @param len The length of content in bytes, or -1 if it is nul-terminated.
+ * @param charset The encoding of content, or NULL if it is UTF-8.
+ *
+ * @return FALSE if the content cannot be converted from charset. The lrc is
+ *         not changed in that case.
+ */
+gboolean ol_lrc_set_content_from_raw (OlLrc *lrc,
+                                      const gchar *content,
+                                      gssize len,
+                                      const gchar *charset);
+
 /**
  * Gets the value of an attribute of an LRC file
  *
@@ -180,6 +219,20 @@ guint64 ol_lrc_get_duration (OlLrc *lrc);
 const char *ol_lrc_get_uri (OlLrc *lrc);
 
 
+/**
+ * Gets the ID of the first line that has non-empty text, starting from a line.
+ *
+ * The result is looked up from a precomputed table.
+ *
+ * @param lrc
+ * @param id The ID of the line to start from.
+ *
+ * @return The ID of the line, which may be id itself. If there is no non-empty
+ *         line at or after id, returns -1.
+ */
+gint ol_lrc_get_next_nonempty_id (OlLrc *lrc,
+                                  guint id);
+
 /**
  * Frees an iterator.
  *
@@ -353,4 +406,99 @@ gdouble ol_lrc_iter_compute_percentage (OlLrcIter *iter,
  */
 gboolean ol_lrc_iter_is_valid (OlLrcIter *iter);
 
+/**
+ * Initializes a cursor to the first line of an LRC file.
+ *
+ * @param cursor
+ * @param lrc The lrc. It is not referenced by the cursor.
+ */
+void ol_lrc_cursor_init (OlLrcCursor *cursor,
+                         OlLrc *lrc);
+
+/**
+ * Moves the cursor to the line that fits the given timestamp.
+ *
+ * The line is the same as the one returned by ol_lrc_iter_from_timestamp().
+ *
+ * @param cursor
+ * @param timestamp The timestamp, in milliseconds.
+ */
+void ol_lrc_cursor_seek (OlLrcCursor *cursor,
+                         gint64 timestamp);
+
+/**
+ * Moves the cursor to the line of the given ID
+ *
+ * @param cursor
+ * @param id
+ *
+ * @return TRUE if success, or FALSE if the id is out of range.
+ */
+gboolean ol_lrc_cursor_move_to (OlLrcCursor *cursor,
+                                guint id);
+
+/**
+ * Moves the cursor to the first non-empty line at or after the line that fits
+ * the given timestamp.
+ *
+ * @param cursor
+ * @param timestamp The timestamp, in milliseconds.
+ *
+ * @return FALSE if there is no non-empty line from the timestamp. In this case
+ *         the cursor points to the line that fits the timestamp.
+ */
+gboolean ol_lrc_cursor_seek_nonempty (OlLrcCursor *cursor,
+                                      gint64 timestamp);
+
+/**
+ * Gets the ID of the line the cursor points to.
+ *
+ * @param cursor
+ *
+ * @return
+ */
+guint ol_lrc_cursor_get_id (const OlLrcCursor *cursor);
+
+/**
+ * Gets the timestamp of the line the cursor points to, in milliseconds.
+ *
+ * The time is calculated with offset of LRC
+ *
+ * @param cursor
+ *
+ * @return
+ */
+gint64 ol_lrc_cursor_get_timestamp (const OlLrcCursor *cursor);
+
+/**
+ * Gets the text of the line the cursor points to.
+ *
+ * @param cursor
+ *
+ * @return The text owned by the lrc. Should NOT be modified or freed.
+ */
+const char *ol_lrc_cursor_get_text (const OlLrcCursor *cursor);
+
+/**
+ * Gets the duration of the line the cursor points to.
+ *
+ * @see ol_lrc_iter_get_duration
+ * @param cursor
+ *
+ * @return
+ */
+guint64 ol_lrc_cursor_get_duration (const OlLrcCursor *cursor);
+
+/**
+ * Figure out how much of the line the cursor points to has been played.
+ *
+ * @see ol_lrc_iter_compute_percentage
+ * @param cursor
+ * @param time_ms The position of the track, in milliseconds.
+ *
+ * @return A value in the range of [0.0, 1.0].
+ */
+gdouble ol_lrc_cursor_compute_percentage (const OlLrcCursor *cursor,
+                                          gint64 time_ms);
+
 #endif /* _OL_LRC_H_ */
@@ -75,12 +75,21 @@ ol_lyric_candidate_list_init (GtkTreeView *list,
 void
 ol_lyric_candidate_list_set_list (GtkTreeView *list,
                                   GList *candidates)
+{
+  ol_assert (list != NULL);
+  ol_lyric_candidate_list_clear (list);
+  ol_lyric_candidate_list_append_list (list, candidates);
+}
+
+void
+ol_lyric_candidate_list_append_list (GtkTreeView *list,
+                                     GList *candidates)
 {
   ol_assert (list != NULL);
   GtkTreeIter iter;
   GtkTreeStore *store = GTK_TREE_STORE (gtk_tree_view_get_model (list));
-  gboolean first = TRUE;
-  ol_lyric_candidate_list_clear (list);
+  GtkTreeSelection *selection = gtk_tree_view_get_selection (list);
+  gboolean first = gtk_tree_selection_count_selected_rows (selection) == 0;
   for (; candidates; candidates = g_list_next (candidates))
   {
     OlLyricSourceCandidate *candidate = OL_LYRIC_SOURCE_CANDIDATE (candidates->data);
@@ -30,6 +30,12 @@ void ol_lyric_candidate_list_init (GtkTreeView *list,
                                    GCallback select_change_callback);
 void ol_lyric_candidate_list_set_list (GtkTreeView *list,
                                      GList *candidates);
+/**
+ * Appends candidates to the list. The first candidate is selected if no one
+ * is selected.
+ */
+void ol_lyric_candidate_list_append_list (GtkTreeView *list,
+                                          GList *candidates);
 OlLyricSourceCandidate *ol_lyric_candidate_list_get_selected (GtkTreeView *list);
 void ol_lyric_candidate_list_clear (GtkTreeView *list);
 
@@ -81,6 +81,7 @@ struct _OlLyricSourceTaskPrivate
 enum {
   SEARCH_SIGNAL_COMPLETE = 0,
   SEARCH_SIGNAL_STARTED,
+  SEARCH_SIGNAL_PARTIAL_RESULTS,
   SEARCH_SIGNAL_LAST,
 };
 
@@ -126,6 +127,10 @@ static void ol_lyric_source_search_complete_cb (OlLyricSource *source,
                                                 GVariant *parameters);
 static void ol_lyric_source_search_started_cb (OlLyricSource *source,
                                                 GVariant *parameters);
+static void ol_lyric_source_search_partial_results_cb (OlLyricSource *source,
+                                                       GVariant *parameters);
+static GList *ol_lyric_source_candidates_new_with_iter (GVariantIter *iter);
+static void ol_lyric_source_candidates_free (GList *candidates);
 static void ol_lyric_source_download_complete_cb (OlLyricSource *source,
                                                   GVariant *parameters);
 
@@ -295,7 +300,6 @@ ol_lyric_source_search_complete_cb (OlLyricSource *source,
                                     GVariant *parameters)
 {
   GVariantIter *iter = NULL;
-  GVariant *dict = NULL;
   GList *result = NULL;
   gint taskid;
   gint statusid;
@@ -312,26 +316,42 @@ ol_lyric_source_search_complete_cb (OlLyricSource *source,
     ol_errorf ("Invalid search status %d\n", statusid);
     return;
   }
-  while (g_variant_iter_loop (iter, "@a{sv}", &dict))
-  {
-    OlLyricSourceCandidate *candidate;
-    candidate = ol_lyric_source_candidate_new_with_variant (dict);
-    result = g_list_prepend (result, candidate);
-  }
+  result = ol_lyric_source_candidates_new_with_iter (iter);
   g_variant_iter_free (iter);
-  result = g_list_reverse (result);
   g_signal_emit (task,
                  _search_signals[SEARCH_SIGNAL_COMPLETE],
                  0,
                  statusid,
                  result);
-  while (result)
+  ol_lyric_source_candidates_free (result);
+  ol_lyric_source_remove_search_task (source, taskid);
+}
+
+static void
+ol_lyric_source_search_partial_results_cb (OlLyricSource *source,
+                                           GVariant *parameters)
+{
+  GVariantIter *iter = NULL;
+  GList *result = NULL;
+  OlLyricSourceTask *task;
+  gint taskid;
+  gchar *sourceid;
+  g_variant_get (parameters, "(i&saa{sv})", &taskid, &sourceid, &iter);
+  task = ol_lyric_source_get_search_task (source, taskid);
+  if (task == NULL)
   {
-    OlLyricSourceCandidate *candidate = result->data;
-    g_object_unref (candidate);
-    result = g_list_delete_link (result, result);
+    ol_errorf ("Search task %d not exist\n", taskid);
+    g_variant_iter_free (iter);
+    return;
   }
-  ol_lyric_source_remove_search_task (source, taskid);
+  result = ol_lyric_source_candidates_new_with_iter (iter);
+  g_variant_iter_free (iter);
+  g_signal_emit (task,
+                 _search_signals[SEARCH_SIGNAL_PARTIAL_RESULTS],
+                 0,
+                 sourceid,
+                 result);
+  ol_lyric_source_candidates_free (result);
 }
 
 static void
@@ -411,6 +431,10 @@ ol_lyric_source_g_signal (GDBusProxy *proxy,
   {
     ol_lyric_source_search_started_cb (source, parameters);
   }
+  else if (strcmp (signal_name, "SearchPartialResults") == 0)
+  {
+    ol_lyric_source_search_partial_results_cb (source, parameters);
+  }
   else if (strcmp (signal_name, "DownloadComplete") == 0)
   {
     ol_lyric_source_download_complete_cb (source, parameters);
@@ -808,6 +832,31 @@ ol_lyric_source_candidate_new_with_variant (GVariant *dict)
   return candidate;
 }
 
+static GList *
+ol_lyric_source_candidates_new_with_iter (GVariantIter *iter)
+{
+  GList *result = NULL;
+  GVariant *dict = NULL;
+  while (g_variant_iter_loop (iter, "@a{sv}", &dict))
+  {
+    OlLyricSourceCandidate *candidate;
+    candidate = ol_lyric_source_candidate_new_with_variant (dict);
+    result = g_list_prepend (result, candidate);
+  }
+  return g_list_reverse (result);
+}
+
+static void
+ol_lyric_source_candidates_free (GList *candidates)
+{
+  while (candidates)
+  {
+    OlLyricSourceCandidate *candidate = candidates->data;
+    g_object_unref (candidate);
+    candidates = g_list_delete_link (candidates, candidates);
+  }
+}
+
 static void
 ol_lyric_source_candidate_finalize (GObject *object)
 {
@@ -1150,6 +1199,18 @@ ol_lyric_source_search_task_class_init (OlLyricSourceSearchTaskClass *klass)
                   2,
                   G_TYPE_STRING,
                   G_TYPE_STRING);
+  _search_signals[SEARCH_SIGNAL_PARTIAL_RESULTS] =
+    g_signal_new ("partial-results",
+                  OL_TYPE_LYRIC_SOURCE_SEARCH_TASK,
+                  G_SIGNAL_NO_HOOKS | G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE,
+                  0,            /* offset */
+                  NULL,         /* accumulator */
+                  NULL,         /* accu_data */
+                  ol_marshal_VOID__STRING_POINTER,
+                  G_TYPE_NONE,
+                  2,
+                  G_TYPE_STRING,
+                  G_TYPE_POINTER);
 }
 
 static void
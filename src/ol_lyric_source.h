@@ -177,6 +177,24 @@ typedef void (*OlSearchStartedFunc) (OlLyricSourceSearchTask *task,
                                      const gchar *sourcename,
                                      gpointer userdata);
 
+/**
+ * Prototype of callback function of 'partial-results' signal in
+ * OlLyricSourceSearchTask.
+ *
+ * The signal is emitted when a source finishes a search sent to all sources
+ * at once. The 'complete' signal is emitted after all the sources finish,
+ * with the results of all sources.
+ *
+ * @param task The task object that emits this signal.
+ * @param sourceid The id of the source that finishes.
+ * @param results A list of OlLyricSourceCandidate* objects found by the source.
+ * @param userdata
+ */
+typedef void (*OlSearchPartialResultsFunc) (OlLyricSourceSearchTask *task,
+                                            const gchar *sourceid,
+                                            GList *results,
+                                            gpointer userdata);
+
 /**
  * Prototype of callback function of 'complete' signal in
  * OlLyricSourceDownloadTask.
@@ -24,8 +24,6 @@ static void ol_lyrics_g_signal (GDBusProxy *proxy,
                                 const gchar *sender_name,
                                 const gchar *signal_name,
                                 GVariant *parameters);
-static OlLrc *ol_lyrics_get_lrc_from_variant (OlLyrics *proxy,
-                                              GVariant *variant);
 
 G_DEFINE_TYPE_WITH_PRIVATE (OlLyrics, ol_lyrics, G_TYPE_DBUS_PROXY);
 
@@ -136,23 +134,24 @@ ol_lyrics_proxy_new_finish (GAsyncResult *res,
     return NULL;
 }
 
+/**
+ * Parses the raw content of lyrics in the client, rather than letting the
+ * daemon parse it and transfer the parsed lines.
+ */
 static OlLrc *
-ol_lyrics_get_lrc_from_variant (OlLyrics *proxy, GVariant *variant)
+ol_lyrics_get_lrc_from_raw (OlLyrics *proxy,
+                            gboolean found,
+                            gchar *uri,
+                            gchar *content)
 {
   OlLrc *lrc = NULL;
-  gboolean found;
-  gchar *uri;
-  GVariant *metadata, *content;
-  g_variant_get (variant, "(bs@a{ss}@aa{sv})", &found, &uri, &metadata, &content);
   if (found)
   {
     lrc = ol_lrc_new (proxy, uri);
-    ol_lrc_set_attributes_from_variant (lrc, metadata);
-    ol_lrc_set_content_from_variant (lrc, content);
+    ol_lrc_set_content_from_raw (lrc, content, -1, NULL);
   }
   g_free (uri);
-  g_variant_unref (content);
-  g_variant_unref (metadata);
+  g_free (content);
   return lrc;
 }
 
@@ -160,26 +159,9 @@ OlLrc *
 ol_lyrics_get_current_lyrics (OlLyrics *proxy)
 {
   ol_assert_ret (OL_IS_LYRICS (proxy), NULL);
-  GError *error = NULL;
-  OlLrc *lrc = NULL;
-  GVariant *ret = g_dbus_proxy_call_sync (G_DBUS_PROXY (proxy),
-                                          "GetCurrentLyrics",
-                                          NULL,      /* parameters */
-                                          G_DBUS_CALL_FLAGS_NO_AUTO_START,
-                                          -1,        /* timeout_secs */
-                                          NULL,      /* cancellable */
-                                          &error);
-  if (ret)
-  {
-    lrc = ol_lyrics_get_lrc_from_variant (proxy, ret);
-    g_variant_unref (ret);
-  }
-  else
-  {
-    ol_errorf ("Cannot get current lyrics from daemon: %s\n", error->message);
-    g_error_free (error);
-  }
-  return lrc;
+  gchar *uri = NULL, *content = NULL;
+  gboolean found = ol_lyrics_get_current_raw_lyrics (proxy, &uri, &content);
+  return ol_lyrics_get_lrc_from_raw (proxy, found, uri, content);
 }
 
 OlLrc *
@@ -188,27 +170,9 @@ ol_lyrics_get_lyrics (OlLyrics *proxy,
 {
   ol_assert_ret (OL_IS_LYRICS (proxy), NULL);
   ol_assert_ret (metadata != NULL, NULL);
-  GError *error = NULL;
-  OlLrc *lrc = NULL;
-  GVariant *ret = g_dbus_proxy_call_sync (G_DBUS_PROXY (proxy),
-                                          "GetLyrics",
-                                          g_variant_new ("(@a{sv})",
-                                                         ol_metadata_to_variant (metadata)),
-                                          G_DBUS_CALL_FLAGS_NO_AUTO_START,
-                                          -1,        /* timeout_secs */
-                                          NULL,      /* cancellable */
-                                          &error);
-  if (ret)
-  {
-    lrc = ol_lyrics_get_lrc_from_variant (proxy, ret);
-    g_variant_unref (ret);
-  }
-  else
-  {
-    ol_errorf ("Cannot get lyrics from daemon: %s\n", error->message);
-    g_error_free (error);
-  }
-  return lrc;
+  gchar *uri = NULL, *content = NULL;
+  gboolean found = ol_lyrics_get_raw_lyrics (proxy, metadata, &uri, &content);
+  return ol_lyrics_get_lrc_from_raw (proxy, found, uri, content);
 }
 
 static gboolean
@@ -44,7 +44,12 @@
 #include "ol_debug.h"
 #include "ol_player_chooser.h"
 
-#define REFRESH_INTERVAL 100
+/* Bounds of the delay between two frames while playing. Modules report
+   when they need the next frame, but they are never updated more often than
+   MIN_FRAME_INTERVAL, and never wait longer than MAX_FRAME_INTERVAL so that
+   state changes they don't report are picked up. */
+#define MIN_FRAME_INTERVAL 16
+#define MAX_FRAME_INTERVAL 5000
 #define INFO_INTERVAL 500
 #define TIMEOUT_WAIT_LAUNCH 5000
 
@@ -65,6 +70,7 @@ static GOptionEntry cmdargs[] =
 
 static guint name_watch_id = 0;
 static guint position_timer = 0;
+static gboolean position_timer_running = FALSE;
 static OlLyricSource *lyric_source = NULL;
 static OlLyricSourceSearchTask *search_task = NULL;
 static OlLyricSourceDownloadTask *download_task = NULL;
@@ -131,6 +137,8 @@ static void _status_changed_cb (void);
 static void _player_lost_cb (void);
 static void _player_connected_cb (void);
 static void _update_position (void);
+static void _schedule_next_frame (guint64 time);
+static void _frame_requested_cb (void);
 static void _start_position_timer (void);
 static void _stop_position_timer (void);
 static void _change_lrc (void);
@@ -375,11 +383,14 @@ _status_changed_cb (void)
   switch (status)
   {
   case OL_PLAYER_PLAYING:
-  case OL_PLAYER_PAUSED:
     _start_position_timer ();
     break;
+  case OL_PLAYER_PAUSED:
   case OL_PLAYER_STOPPED:
+    /* Seeking while paused emits position-changed, which updates the
+       display once. */
     _stop_position_timer ();
+    _update_position ();
     break;
   default:
     /* In case of the daemon sent a wrong status but still playing, it's better
@@ -496,14 +507,15 @@ _player_connected_cb (void)
                                          OL_PLAYER_CHOOSER_STATE_CONNECTED);
 
   player_lost_action = ACTION_QUIT;
-  _start_position_timer ();
+  _status_changed_cb ();
 }
 
 static gint
 _position_timer_cb (gpointer data)
 {
+  position_timer = 0;
   _update_position ();
-  return TRUE;
+  return FALSE;
 }
 
 static void
@@ -515,6 +527,52 @@ _update_position (void)
   guint64 time = 0;
   ol_player_get_position (player, &time);
   CALL_DISPLAY_MODULES (ol_display_module_set_played_time, time);
+  _schedule_next_frame (time);
+}
+
+static gint
+_min_frame_delay (gint delay, struct OlDisplayModule *module, guint64 time)
+{
+  if (module == NULL)
+    return delay;
+  gint module_delay = ol_display_module_get_next_frame_delay (module, time);
+  if (module_delay < 0)
+    return delay;
+  if (delay < 0 || module_delay < delay)
+    return module_delay;
+  return delay;
+}
+
+/**
+ * Re-arms the position timer for the earliest frame any display module
+ * needs, instead of polling the position periodically.
+ */
+static void
+_schedule_next_frame (guint64 time)
+{
+  if (position_timer)
+  {
+    g_source_remove (position_timer);
+    position_timer = 0;
+  }
+  if (!position_timer_running)
+    return;
+  gint delay = -1;
+  delay = _min_frame_delay (delay, display_module_osd, time);
+  delay = _min_frame_delay (delay, display_module_scroll, time);
+  /* Even if no module needs a frame, wake up after MAX_FRAME_INTERVAL */
+  if (delay < 0)
+    delay = MAX_FRAME_INTERVAL;
+  delay = CLAMP (delay, MIN_FRAME_INTERVAL, MAX_FRAME_INTERVAL);
+  position_timer = g_timeout_add (delay, _position_timer_cb, NULL);
+}
+
+static void
+_frame_requested_cb (void)
+{
+  if (position_timer)
+    g_source_remove (position_timer);
+  position_timer = g_idle_add (_position_timer_cb, NULL);
 }
 
 OlPlayer*
@@ -551,6 +609,9 @@ ol_app_adjust_lyric_offset (int offset_ms)
   int old_offset = ol_lrc_get_offset (lrc);
   int new_offset = old_offset - offset_ms;
   ol_lrc_set_offset (lrc, new_offset);
+  /* Show the lyrics at the new offset now rather than on the next frame,
+     which may be seconds later or never if the player is paused. */
+  _update_position ();
 }
 
 static void
@@ -806,6 +867,10 @@ _init_player (void)
                     "player-connected",
                     _player_connected_cb,
                     NULL);
+  g_signal_connect (player,
+                    "position-changed",
+                    _frame_requested_cb,
+                    NULL);
 }
 
 static void
@@ -839,6 +904,7 @@ _init_dbus_connection_done (void)
   ol_notify_init ();
   ol_keybinding_init ();
   ol_display_module_init ();
+  ol_display_module_set_frame_request_func (_frame_requested_cb);
 
   /* Initialize display modules */
   OlConfigProxy *config = ol_config_proxy_get_instance ();
@@ -897,15 +963,17 @@ _uninitialize (void)
 static void
 _start_position_timer (void)
 {
-  if (!position_timer)
-    position_timer = g_timeout_add (REFRESH_INTERVAL,
-                                    _position_timer_cb,
-                                    NULL);
+  if (!position_timer_running)
+  {
+    position_timer_running = TRUE;
+    _update_position ();
+  }
 }
 
 static void
 _stop_position_timer (void)
 {
+  position_timer_running = FALSE;
   if (position_timer)
   {
     g_source_remove (position_timer);
@@ -38,6 +38,14 @@ extern void ol_marshal_VOID__ENUM_STRING_UINT (GClosure     *closure,
                                                gpointer      invocation_hint,
                                                gpointer      marshal_data);
 
+/* VOID:STRING,POINTER (marshal:5) */
+extern void ol_marshal_VOID__STRING_POINTER (GClosure     *closure,
+                                             GValue       *return_value,
+                                             guint         n_param_values,
+                                             const GValue *param_values,
+                                             gpointer      invocation_hint,
+                                             gpointer      marshal_data);
+
 G_END_DECLS
 
 #endif /* __ol_marshal_MARSHAL_H__ */
@@ -38,6 +38,7 @@ struct OlLrc;
 
 struct _OlOsdModule
 {
+  struct OlDisplayModule *display_module;
   OlPlayer *player;
   OlMetadata *metadata;
   gint lrc_id;
@@ -46,11 +47,17 @@ struct _OlOsdModule
   gint line_count;
   gboolean force_refresh_on_set_played_time;
   OlLrc *lrc;
+  OlLrcCursor cursor;
   OlOsdWindow *window;
   OlOsdToolbar *toolbar;
   guint message_source;
   GList *config_bindings;
   gboolean visible_when_stopped;
+  gint prerender_lines;
+  /* The batch of the config values of the window position and size, and the
+     idle source to commit it */
+  OlConfigBatch *config_batch;
+  guint config_commit_source;
 };
 
 typedef void (*_ConfigSetFunc) (OlConfigProxy *config,
@@ -80,10 +87,11 @@ static void _status_changed_cb (OlPlayer *player,
                                 OlOsdModule *module);
 static void _update_metadata (OlOsdModule *module);
 static void _update_status (OlOsdModule *module);
-static gboolean _advance_to_nonempty_lyric (OlLrcIter *iter);
 
 static void ol_osd_module_set_played_time (struct OlDisplayModule *module,
                                            guint64 played_time);
+static gint ol_osd_module_get_next_frame_delay (struct OlDisplayModule *module,
+                                                guint64 played_time);
 static void ol_osd_module_set_lrc (struct OlDisplayModule *module,
                                    OlLrc *lrc_file);
 static void ol_osd_module_set_message (struct OlDisplayModule *module,
@@ -108,8 +116,8 @@ static void ol_osd_module_clear_message (struct OlDisplayModule *module);
  * 
  * @return The real lyric of the lrc. returns NULL if not available
  */
-static void ol_osd_module_update_next_lyric (OlOsdModule *osd,
-                                             OlLrcIter *iter);
+static void ol_osd_module_update_next_lyric (OlOsdModule *osd, guint id);
+static void ol_osd_module_prerender_lyrics (OlOsdModule *osd, guint id);
 static void ol_osd_module_init_osd (OlOsdModule *osd);
 static gboolean hide_message (OlOsdModule *osd);
 static gboolean is_message_displayed (OlOsdModule *osd);
@@ -174,6 +182,12 @@ static void _outline_changed_cb (OlConfigProxy *config,
 static void _blur_changed_cb (OlConfigProxy *config,
                               const char *key,
                               OlOsdModule *osd);
+static void _surface_cache_size_changed_cb (OlConfigProxy *config,
+                                            const char *key,
+                                            OlOsdModule *osd);
+static void _prerender_lines_changed_cb (OlConfigProxy *config,
+                                         const char *key,
+                                         OlOsdModule *osd);
 
 static struct _ConfigMapping _config_mapping[] = {
   { "OSD/visible_when_stopped", _visible_changed_cb },
@@ -191,10 +205,39 @@ static struct _ConfigMapping _config_mapping[] = {
   { "OSD/translucent-on-mouse-over", _translucent_changed_cb },
   { "OSD/outline-width", _outline_changed_cb },
   { "OSD/blur-radius", _blur_changed_cb },
+  { "OSD/surface-cache-size", _surface_cache_size_changed_cb },
+  { "OSD/prerender-lines", _prerender_lines_changed_cb },
 };
 
 static gboolean _config_is_setting = FALSE;
 
+static gboolean
+_commit_config_cb (OlOsdModule *module)
+{
+  module->config_commit_source = 0;
+  ol_config_batch_commit (module->config_batch);
+  module->config_batch = NULL;
+  return FALSE;
+}
+
+/**
+ * Gets the config batch of the window, which is committed once idle.
+ *
+ * The window emits moved and resize at the end of dragging, so the position
+ * and the size are sent to the config daemon together.
+ */
+static OlConfigBatch *
+_get_config_batch (OlOsdModule *module)
+{
+  if (module->config_batch == NULL)
+  {
+    module->config_batch = ol_config_batch_new (ol_config_proxy_get_instance ());
+    module->config_commit_source = g_idle_add ((GSourceFunc) _commit_config_cb,
+                                               module);
+  }
+  return module->config_batch;
+}
+
 static void
 ol_osd_moved_handler (OlOsdWindow *osd, gpointer data)
 {
@@ -202,11 +245,11 @@ ol_osd_moved_handler (OlOsdWindow *osd, gpointer data)
   if (_config_is_setting)
     return;
   _config_is_setting = TRUE;
-  OlConfigProxy *config = ol_config_proxy_get_instance ();
+  OlConfigBatch *batch = _get_config_batch (data);
   int x, y;
   ol_osd_window_get_pos (osd, &x, &y);
-  ol_config_proxy_set_int (config, "OSD/x", x);
-  ol_config_proxy_set_int (config, "OSD/y", y);
+  ol_config_batch_set_int (batch, "OSD/x", x);
+  ol_config_batch_set_int (batch, "OSD/y", y);
   _config_is_setting = FALSE;
 }
 
@@ -216,9 +259,8 @@ ol_osd_resize_handler (OlOsdWindow *osd, gpointer data)
   ol_log_func ();
   if (_config_is_setting)
     return;
-  OlConfigProxy *config = ol_config_proxy_get_instance ();
   int width = ol_osd_window_get_width (osd);
-  ol_config_proxy_set_int (config, "OSD/width", width);
+  ol_config_batch_set_int (_get_config_batch (data), "OSD/width", width);
 }
 
 static gboolean
@@ -323,6 +365,7 @@ _font_changed_cb (OlConfigProxy *config,
 {
   gchar *font = ol_config_proxy_get_string (config, key);
   ol_assert (font != NULL);
+  ol_osd_window_clear_surface_cache (osd->window);
   ol_osd_window_set_font_name (osd->window, font);
   g_free (font);
 }
@@ -361,6 +404,7 @@ _active_color_changed_cb (OlConfigProxy *config,
   if (color_str != NULL)
   {
     OlColor *colors = ol_color_from_str_list ((const char**)color_str, NULL);
+    ol_osd_window_clear_surface_cache (osd->window);
     ol_osd_window_set_active_colors (osd->window, colors[0], colors[1], colors[2]);
     g_free (colors);
     g_strfreev (color_str);
@@ -379,6 +423,7 @@ _inactive_color_changed_cb (OlConfigProxy *config,
   if (color_str != NULL)
   {
     OlColor *colors = ol_color_from_str_list ((const char**)color_str, NULL);
+    ol_osd_window_clear_surface_cache (osd->window);
     ol_osd_window_set_inactive_colors (osd->window, colors[0], colors[1], colors[2]);
     g_free (colors);
     g_strfreev (color_str);
@@ -399,6 +444,7 @@ _outline_changed_cb (OlConfigProxy *config,
                      const char *key,
                      OlOsdModule *osd)
 {
+  ol_osd_window_clear_surface_cache (osd->window);
   ol_osd_window_set_outline_width (osd->window, ol_config_proxy_get_int (config, key));
 }
 
@@ -407,35 +453,74 @@ _blur_changed_cb (OlConfigProxy *config,
                   const char *key,
                   OlOsdModule *osd)
 {
+  ol_osd_window_clear_surface_cache (osd->window);
   ol_osd_window_set_blur_radius (osd->window, ol_config_proxy_get_double (config, key));
 }
 
 static void
-ol_osd_module_update_next_lyric (OlOsdModule *osd, OlLrcIter *iter)
+_surface_cache_size_changed_cb (OlConfigProxy *config,
+                                const char *key,
+                                OlOsdModule *osd)
+{
+  /* The size is in KiB */
+  int size = ol_config_proxy_get_int (config, key);
+  ol_osd_window_set_surface_cache_size (osd->window,
+                                        (gsize) MAX (size, 0) * 1024);
+}
+
+static void
+_prerender_lines_changed_cb (OlConfigProxy *config,
+                             const char *key,
+                             OlOsdModule *osd)
+{
+  osd->prerender_lines = ol_config_proxy_get_int (config, key);
+}
+
+/**
+ * Renders the non-empty lines after the line of the given id in background,
+ * so that switching to them doesn't need to render text in the main loop.
+ */
+static void
+ol_osd_module_prerender_lyrics (OlOsdModule *osd, guint id)
+{
+  int count;
+  OlLrcCursor cursor;
+  ol_lrc_cursor_init (&cursor, osd->lrc);
+  gint next_id = ol_lrc_get_next_nonempty_id (osd->lrc, id + 1);
+  for (count = 0; count < osd->prerender_lines && next_id >= 0; count++)
+  {
+    ol_lrc_cursor_move_to (&cursor, next_id);
+    ol_osd_window_prerender_lyric (osd->window,
+                                   ol_lrc_cursor_get_text (&cursor));
+    next_id = ol_lrc_get_next_nonempty_id (osd->lrc, next_id + 1);
+  }
+}
+
+/**
+ * Shows the first non-empty line after the line of the given id in the line
+ * of the OSD window that is not current.
+ */
+static void
+ol_osd_module_update_next_lyric (OlOsdModule *osd, guint id)
 {
   if (osd->line_count == 1)
   {
     osd->lrc_next_id = -1;
     return;
   }
-  if (ol_lrc_iter_next (iter))
-    _advance_to_nonempty_lyric (iter);
-  gint id;
-  const char *text = NULL;
-  if (ol_lrc_iter_is_valid (iter))
-  {
-    id = ol_lrc_iter_get_id (iter);
-    text = ol_lrc_iter_get_text (iter);
-  }
-  else
+  OlLrcCursor cursor;
+  const char *text = "";
+  ol_lrc_cursor_init (&cursor, osd->lrc);
+  gint next_id = ol_lrc_get_next_nonempty_id (osd->lrc, id + 1);
+  if (next_id >= 0)
   {
-    id = -1;
-    text = "";
+    ol_lrc_cursor_move_to (&cursor, next_id);
+    text = ol_lrc_cursor_get_text (&cursor);
   }
-  if (osd->lrc_next_id != id)
+  if (osd->lrc_next_id != next_id)
   {
     int next_line = 1 - osd->current_line;
-    osd->lrc_next_id = id;
+    osd->lrc_next_id = next_id;
     ol_osd_window_set_lyric (osd->window, next_line, text);
     ol_osd_window_set_percentage (osd->window, next_line, 0.0);
   }
@@ -513,10 +598,10 @@ ol_osd_module_init_osd (OlOsdModule *osd)
   
   g_signal_connect (osd->window, "moved",
                     G_CALLBACK (ol_osd_moved_handler),
-                    NULL);
+                    osd);
   g_signal_connect (osd->window, "resize",
                     G_CALLBACK (ol_osd_resize_handler),
-                    NULL);
+                    osd);
   g_signal_connect (osd->window, "button-release-event",
                     G_CALLBACK (ol_osd_button_release),
                     NULL);
@@ -532,6 +617,7 @@ ol_osd_module_new (struct OlDisplayModule *module,
   ol_log_func ();
   OlOsdModule *data = g_new (OlOsdModule, 1);
   g_object_ref (player);
+  data->display_module = module;
   data->player = player;
   data->window = NULL;
   data->lrc = NULL;
@@ -541,6 +627,9 @@ ol_osd_module_new (struct OlDisplayModule *module,
   data->metadata = ol_metadata_new ();
   data->config_bindings = NULL;
   data->visible_when_stopped = TRUE;
+  data->prerender_lines = 0;
+  data->config_batch = NULL;
+  data->config_commit_source = 0;
   ol_osd_module_init_osd (data);
   g_signal_connect (player,
                     "track-changed",
@@ -577,6 +666,11 @@ ol_osd_module_free (struct OlDisplayModule *module)
     gtk_widget_destroy (GTK_WIDGET (priv->window));
     priv->window = NULL;
   }
+  if (priv->config_commit_source > 0)
+  {
+    g_source_remove (priv->config_commit_source);
+    _commit_config_cb (priv);
+  }
   if (is_message_displayed (priv))
   {
     g_source_remove (priv->message_source);
@@ -642,6 +736,8 @@ _update_status (OlOsdModule *module)
   gboolean visible = (status != OL_PLAYER_STOPPED ||
                       module->visible_when_stopped);
 
+  if (visible && !gtk_widget_get_visible (GTK_WIDGET (module->window)))
+    ol_display_module_request_frame (module->display_module);
   gtk_widget_set_visible (GTK_WIDGET (module->window), visible);
   if (module->toolbar != NULL && visible)
     ol_osd_toolbar_set_status (module->toolbar, status);
@@ -656,11 +752,10 @@ ol_osd_module_set_played_time (struct OlDisplayModule *module,
   ol_assert (priv != NULL);
   if (priv->lrc != NULL && priv->window != NULL)
   {
-    OlLrcIter *iter = ol_lrc_iter_from_timestamp (priv->lrc,
-                                                  played_time);
-    if (_advance_to_nonempty_lyric (iter))
+    OlLrcCursor *cursor = &priv->cursor;
+    if (ol_lrc_cursor_seek_nonempty (cursor, played_time))
     {
-      gint id = ol_lrc_iter_get_id (iter);
+      gint id = ol_lrc_cursor_get_id (cursor);
       if (id != priv->lrc_id)
       {
         if (id == priv->lrc_next_id)
@@ -680,35 +775,63 @@ ol_osd_module_set_played_time (struct OlDisplayModule *module,
           priv->current_line = 0;
           ol_osd_window_set_current_line (priv->window, 0);
           ol_osd_window_set_lyric (priv->window, priv->current_line,
-                                   ol_lrc_iter_get_text (iter));
-          ol_osd_module_update_next_lyric (priv, iter);
+                                   ol_lrc_cursor_get_text (cursor));
+          ol_osd_module_update_next_lyric (priv, id);
         }
+        ol_osd_module_prerender_lyrics (priv, id);
       }
-      gdouble percentage = ol_lrc_iter_compute_percentage (iter, played_time);
+      gdouble percentage = ol_lrc_cursor_compute_percentage (cursor,
+                                                             played_time);
       ol_osd_window_set_current_percentage (priv->window, percentage);
       if (percentage > 0.5 && priv->lrc_next_id == -1)
-        ol_osd_module_update_next_lyric (priv, iter);
+        ol_osd_module_update_next_lyric (priv, id);
     }
     else if (priv->lrc_id != -1 || priv->force_refresh_on_set_played_time)
     {
       hide_lyrics (priv);
       reset_lyrics_state (priv);
     }
-    ol_lrc_iter_free (iter);
 
     priv->force_refresh_on_set_played_time = FALSE;
   }
 }
 
-static gboolean
-_advance_to_nonempty_lyric (OlLrcIter *iter)
+static gint
+ol_osd_module_get_next_frame_delay (struct OlDisplayModule *module,
+                                    guint64 played_time)
 {
-  for (; ol_lrc_iter_is_valid (iter); ol_lrc_iter_next (iter))
+  ol_assert_ret (module != NULL, -1);
+  OlOsdModule *priv = ol_display_module_get_data (module);
+  ol_assert_ret (priv != NULL, -1);
+  if (priv->lrc == NULL || priv->window == NULL ||
+      !gtk_widget_get_visible (GTK_WIDGET (priv->window)))
+    return -1;
+  gint delay = -1;
+  OlLrcCursor *cursor = &priv->cursor;
+  if (ol_lrc_cursor_seek_nonempty (cursor, played_time))
   {
-    if (!ol_is_string_empty (ol_lrc_iter_get_text (iter)))
-      return TRUE;
+    gint64 time = played_time;
+    gint64 start = ol_lrc_cursor_get_timestamp (cursor);
+    gint64 duration = ol_lrc_cursor_get_duration (cursor);
+    if (time < start)
+    {
+      /* Nothing changes until the line begins */
+      delay = start - time;
+    }
+    else if (time < start + duration)
+    {
+      delay = start + duration - time;
+      /* Sweep the line by one device pixel per frame */
+      gint width = ol_osd_window_get_lyric_width (priv->window,
+                                                  priv->current_line);
+      if (width > 0)
+        delay = MIN (delay, MAX (1, duration / width));
+      /* The next line is shown when half of the current line is played */
+      if (priv->lrc_next_id == -1 && time < start + duration / 2)
+        delay = MIN (delay, start + duration / 2 - time + 1);
+    }
   }
-  return FALSE;
+  return delay;
 }
 
 static void
@@ -722,6 +845,8 @@ ol_osd_module_set_lrc (struct OlDisplayModule *module, OlLrc *lrc_file)
     g_object_unref (priv->lrc);
   if (lrc_file)
     g_object_ref (lrc_file);
+  if (priv->window != NULL)
+    ol_osd_window_cancel_prerender (priv->window);
 
   if (is_message_displayed (priv))
   {
@@ -739,6 +864,7 @@ ol_osd_module_set_lrc (struct OlDisplayModule *module, OlLrc *lrc_file)
   }
 
   priv->lrc = lrc_file;
+  ol_lrc_cursor_init (&priv->cursor, lrc_file);
   reset_lyrics_state (priv);
 }
 
@@ -850,5 +976,6 @@ ol_osd_module_get_class ()
   klass->set_lrc = ol_osd_module_set_lrc;
   klass->set_message = ol_osd_module_set_message;
   klass->set_played_time = ol_osd_module_set_played_time;
+  klass->get_next_frame_delay = ol_osd_module_get_next_frame_delay;
   return klass;
 }
@@ -51,6 +51,66 @@ ol_osd_render_context_new ()
   return context;
 }
 
+OlOsdRenderSettings *
+ol_osd_render_get_settings (OlOsdRenderContext *context)
+{
+  ol_assert_ret (context != NULL, NULL);
+  OlOsdRenderSettings *settings = g_new (OlOsdRenderSettings, 1);
+  settings->font_name = g_strdup (context->font_name);
+  settings->outline_width = context->outline_width;
+  memcpy (settings->linear_colors, context->linear_colors,
+          sizeof (settings->linear_colors));
+  settings->blur_radius = context->blur_radius;
+  settings->font_height = context->font_height;
+  settings->resolution = pango_cairo_context_get_resolution (context->pango_context);
+  const cairo_font_options_t *font_options =
+    pango_cairo_context_get_font_options (context->pango_context);
+  settings->font_options = font_options != NULL ?
+    cairo_font_options_copy (font_options) : NULL;
+  return settings;
+}
+
+void
+ol_osd_render_settings_free (OlOsdRenderSettings *settings)
+{
+  ol_assert (settings != NULL);
+  g_free (settings->font_name);
+  if (settings->font_options != NULL)
+    cairo_font_options_destroy (settings->font_options);
+  g_free (settings);
+}
+
+OlOsdRenderContext *
+ol_osd_render_context_new_from_settings (const OlOsdRenderSettings *settings,
+                                         PangoFontMap *font_map)
+{
+  ol_assert_ret (settings != NULL, NULL);
+  ol_assert_ret (font_map != NULL, NULL);
+  OlOsdRenderContext *context = g_new (OlOsdRenderContext, 1);
+  context->font_name = g_strdup (settings->font_name);
+  context->outline_width = settings->outline_width;
+  memcpy (context->linear_colors, settings->linear_colors,
+          sizeof (context->linear_colors));
+  context->linear_pos[0] = 0.0;
+  context->linear_pos[1] = 0.5;
+  context->linear_pos[2] = 1.0;
+  context->text = NULL;
+  context->blur_radius = settings->blur_radius;
+  context->pango_context = pango_font_map_create_context (font_map);
+  pango_cairo_context_set_resolution (context->pango_context,
+                                      settings->resolution);
+  pango_cairo_context_set_font_options (context->pango_context,
+                                        settings->font_options);
+  context->pango_layout = pango_layout_new (context->pango_context);
+  PangoFontDescription *font_desc = pango_font_description_from_string (context->font_name);
+  pango_layout_set_font_description (context->pango_layout, font_desc);
+  pango_font_description_free (font_desc);
+  /* font_height is copied, so there is no need to load font metrics from
+     the font map here. */
+  context->font_height = settings->font_height;
+  return context;
+}
+
 void
 ol_osd_render_context_destroy (OlOsdRenderContext *context)
 {
@@ -123,6 +183,25 @@ ol_osd_render_paint_text (OlOsdRenderContext *context,
   cairo_restore (cr);
 }
 
+cairo_surface_t *
+ol_osd_render_create_text_surface (OlOsdRenderContext *context,
+                                   const char *text)
+{
+  ol_assert_ret (context != NULL, NULL);
+  ol_assert_ret (text != NULL, NULL);
+  int w, h;
+  ol_osd_render_get_pixel_size (context, text, &w, &h);
+  cairo_surface_t *surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                                         w, h);
+  cairo_t *cr = cairo_create (surface);
+  cairo_set_source_rgba (cr, 1.0, 1.0, 1.0, 0.0);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  cairo_paint (cr);
+  ol_osd_render_paint_text (context, cr, text, 0, 0);
+  cairo_destroy (cr);
+  return surface;
+}
+
 void
 ol_osd_render_get_pixel_size (OlOsdRenderContext *context,
                               const char *text,
@@ -41,6 +41,21 @@ typedef struct
   int font_height;
 } OlOsdRenderContext;
 
+/**
+ * Plain settings of an OlOsdRenderContext, without any Pango object, so that
+ * they can be passed to another thread.
+ */
+typedef struct
+{
+  char *font_name;
+  int outline_width;
+  OlColor linear_colors[OL_LINEAR_COLOR_COUNT];
+  double blur_radius;
+  int font_height;
+  double resolution;
+  cairo_font_options_t *font_options; /* NULL if not set */
+} OlOsdRenderSettings;
+
 /**
  * @brief Creates a new context
  * The new context should be destroyed by ol_osd_render_context_destroy
@@ -48,6 +63,33 @@ typedef struct
  * @return The new context
  */
 OlOsdRenderContext* ol_osd_render_context_new ();
+/**
+ * @brief Gets the settings of a context
+ *
+ * @param context An OlOsdRenderContext
+ *
+ * @return The settings, should be freed by ol_osd_render_settings_free
+ */
+OlOsdRenderSettings* ol_osd_render_get_settings (OlOsdRenderContext *context);
+/**
+ * @brief Frees the settings got by ol_osd_render_get_settings
+ *
+ * @param settings The settings to be freed
+ */
+void ol_osd_render_settings_free (OlOsdRenderSettings *settings);
+/**
+ * @brief Creates a new context from settings and a font map
+ *
+ * The context can be used to render in another thread than the one of
+ * ol_osd_render_context_new, as long as font_map is used by that thread only.
+ *
+ * @param settings The settings of the context
+ * @param font_map The font map of the PangoContext of the context
+ *
+ * @return The new context, should be destroyed by ol_osd_render_context_destroy
+ */
+OlOsdRenderContext* ol_osd_render_context_new_from_settings (const OlOsdRenderSettings *settings,
+                                                             PangoFontMap *font_map);
 /**
  * @brief Destroys an OlOsdRenderContext
  *
@@ -125,6 +167,17 @@ void ol_osd_render_paint_text (OlOsdRenderContext *context,
                                double x,
                                double y);
 
+/**
+ * @brief Renders text into a new image surface that fits its size
+ *
+ * @param context The context of the renderer
+ * @param text The text to be painted
+ *
+ * @return A new ARGB32 image surface, should be destroyed by cairo_surface_destroy
+ */
+cairo_surface_t *ol_osd_render_create_text_surface (OlOsdRenderContext *context,
+                                                    const char *text);
+
 /**
  * @brief Gets the width and height of the text
  *
@@ -0,0 +1,184 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of OSD Lyrics.
+ * 
+ * OSD Lyrics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OSD Lyrics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>. 
+ */
+#include "ol_osd_surface_cache.h"
+#include "ol_debug.h"
+
+struct _OlOsdSurfaceCache
+{
+  GHashTable *entries;          /* key -> GList node in lru */
+  GQueue lru;                   /* Most recently used entry at head */
+  gsize bytes;
+  gsize max_bytes;
+  guint hits;
+  guint misses;
+};
+
+struct _Entry
+{
+  char *key;
+  cairo_surface_t *active;
+  cairo_surface_t *inactive;
+  gsize bytes;
+};
+
+static gsize _surface_bytes (cairo_surface_t *surface);
+static void _entry_free (struct _Entry *entry);
+static void _remove_link (OlOsdSurfaceCache *cache, GList *link);
+static void _shrink (OlOsdSurfaceCache *cache, gsize max_bytes);
+
+static gsize
+_surface_bytes (cairo_surface_t *surface)
+{
+  return (gsize) cairo_image_surface_get_stride (surface) *
+    cairo_image_surface_get_height (surface);
+}
+
+static void
+_entry_free (struct _Entry *entry)
+{
+  g_free (entry->key);
+  cairo_surface_destroy (entry->active);
+  cairo_surface_destroy (entry->inactive);
+  g_free (entry);
+}
+
+static void
+_remove_link (OlOsdSurfaceCache *cache, GList *link)
+{
+  struct _Entry *entry = link->data;
+  g_hash_table_remove (cache->entries, entry->key);
+  g_queue_delete_link (&cache->lru, link);
+  cache->bytes -= entry->bytes;
+  _entry_free (entry);
+}
+
+static void
+_shrink (OlOsdSurfaceCache *cache, gsize max_bytes)
+{
+  while (cache->bytes > max_bytes && cache->lru.tail != NULL)
+    _remove_link (cache, cache->lru.tail);
+}
+
+OlOsdSurfaceCache *
+ol_osd_surface_cache_new (gsize max_bytes)
+{
+  OlOsdSurfaceCache *cache = g_new0 (OlOsdSurfaceCache, 1);
+  cache->entries = g_hash_table_new (g_str_hash, g_str_equal);
+  g_queue_init (&cache->lru);
+  cache->max_bytes = max_bytes;
+  return cache;
+}
+
+void
+ol_osd_surface_cache_free (OlOsdSurfaceCache *cache)
+{
+  ol_assert (cache != NULL);
+  ol_osd_surface_cache_clear (cache);
+  g_hash_table_destroy (cache->entries);
+  g_free (cache);
+}
+
+void
+ol_osd_surface_cache_set_max_bytes (OlOsdSurfaceCache *cache,
+                                    gsize max_bytes)
+{
+  ol_assert (cache != NULL);
+  cache->max_bytes = max_bytes;
+  _shrink (cache, max_bytes);
+}
+
+gsize
+ol_osd_surface_cache_get_max_bytes (OlOsdSurfaceCache *cache)
+{
+  ol_assert_ret (cache != NULL, 0);
+  return cache->max_bytes;
+}
+
+gboolean
+ol_osd_surface_cache_lookup (OlOsdSurfaceCache *cache,
+                             const char *key,
+                             cairo_surface_t **active,
+                             cairo_surface_t **inactive)
+{
+  ol_assert_ret (cache != NULL, FALSE);
+  ol_assert_ret (key != NULL, FALSE);
+  ol_assert_ret (active != NULL && inactive != NULL, FALSE);
+  if (cache->max_bytes == 0)
+    return FALSE;
+  GList *link = g_hash_table_lookup (cache->entries, key);
+  if (link == NULL)
+  {
+    cache->misses++;
+    ol_debugf ("Lyric surface cache miss: %u hits, %u misses, %lu bytes\n",
+               cache->hits, cache->misses, (unsigned long) cache->bytes);
+    return FALSE;
+  }
+  cache->hits++;
+  ol_debugf ("Lyric surface cache hit: %u hits, %u misses, %lu bytes\n",
+             cache->hits, cache->misses, (unsigned long) cache->bytes);
+  g_queue_unlink (&cache->lru, link);
+  g_queue_push_head_link (&cache->lru, link);
+  struct _Entry *entry = link->data;
+  *active = cairo_surface_reference (entry->active);
+  *inactive = cairo_surface_reference (entry->inactive);
+  return TRUE;
+}
+
+gboolean
+ol_osd_surface_cache_contains (OlOsdSurfaceCache *cache,
+                               const char *key)
+{
+  ol_assert_ret (cache != NULL, FALSE);
+  ol_assert_ret (key != NULL, FALSE);
+  return g_hash_table_lookup (cache->entries, key) != NULL;
+}
+
+void
+ol_osd_surface_cache_insert (OlOsdSurfaceCache *cache,
+                             const char *key,
+                             cairo_surface_t *active,
+                             cairo_surface_t *inactive)
+{
+  ol_assert (cache != NULL);
+  ol_assert (key != NULL);
+  ol_assert (active != NULL && inactive != NULL);
+  gsize bytes = _surface_bytes (active) + _surface_bytes (inactive);
+  GList *link = g_hash_table_lookup (cache->entries, key);
+  if (link != NULL)
+    _remove_link (cache, link);
+  if (bytes > cache->max_bytes)
+    return;
+  _shrink (cache, cache->max_bytes - bytes);
+  struct _Entry *entry = g_new (struct _Entry, 1);
+  entry->key = g_strdup (key);
+  entry->active = cairo_surface_reference (active);
+  entry->inactive = cairo_surface_reference (inactive);
+  entry->bytes = bytes;
+  g_queue_push_head (&cache->lru, entry);
+  g_hash_table_insert (cache->entries, entry->key, cache->lru.head);
+  cache->bytes += bytes;
+}
+
+void
+ol_osd_surface_cache_clear (OlOsdSurfaceCache *cache)
+{
+  ol_assert (cache != NULL);
+  _shrink (cache, 0);
+}
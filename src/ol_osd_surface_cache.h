@@ -0,0 +1,98 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of OSD Lyrics.
+ * 
+ * OSD Lyrics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OSD Lyrics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>. 
+ */
+#ifndef _OL_OSD_SURFACE_CACHE_H_
+#define _OL_OSD_SURFACE_CACHE_H_
+
+#include <glib.h>
+#include <cairo.h>
+
+/**
+ * A bounded LRU cache of rendered lyric lines.
+ *
+ * Each entry holds the active and inactive surfaces of a line. The key is
+ * built by the caller and must contain everything that affects the
+ * rendering, i.e. text, font, outline width, blur radius and colors.
+ */
+typedef struct _OlOsdSurfaceCache OlOsdSurfaceCache;
+
+/** 
+ * Creates a new cache.
+ * 
+ * @param max_bytes The maximum number of pixel bytes held by the cache. 0
+ *        disables caching.
+ * 
+ * @return The new cache, should be freed with ol_osd_surface_cache_free().
+ */
+OlOsdSurfaceCache *ol_osd_surface_cache_new (gsize max_bytes);
+
+void ol_osd_surface_cache_free (OlOsdSurfaceCache *cache);
+
+/** 
+ * Sets the byte budget of the cache.
+ *
+ * Least recently used entries are dropped until the cache fits in the new
+ * budget.
+ */
+void ol_osd_surface_cache_set_max_bytes (OlOsdSurfaceCache *cache,
+                                         gsize max_bytes);
+
+gsize ol_osd_surface_cache_get_max_bytes (OlOsdSurfaceCache *cache);
+
+/** 
+ * Looks up the surfaces of a line and marks them as most recently used.
+ * 
+ * @param cache 
+ * @param key The key of the line.
+ * @param active Return location of the active surface. The caller owns the
+ *        returned reference.
+ * @param inactive Return location of the inactive surface. The caller owns
+ *        the returned reference.
+ * 
+ * @return TRUE if the line is cached, in which case both surfaces are set.
+ */
+gboolean ol_osd_surface_cache_lookup (OlOsdSurfaceCache *cache,
+                                      const char *key,
+                                      cairo_surface_t **active,
+                                      cairo_surface_t **inactive);
+
+/** 
+ * Checks whether a line is cached, without affecting its LRU order or the
+ * hit/miss counters.
+ */
+gboolean ol_osd_surface_cache_contains (OlOsdSurfaceCache *cache,
+                                        const char *key);
+
+/** 
+ * Adds the surfaces of a line to the cache.
+ *
+ * The cache takes its own references of the surfaces. If the line is larger
+ * than the whole budget, it will not be cached.
+ */
+void ol_osd_surface_cache_insert (OlOsdSurfaceCache *cache,
+                                  const char *key,
+                                  cairo_surface_t *active,
+                                  cairo_surface_t *inactive);
+
+/** 
+ * Drops all cached lines.
+ */
+void ol_osd_surface_cache_clear (OlOsdSurfaceCache *cache);
+
+#endif /* _OL_OSD_SURFACE_CACHE_H_ */
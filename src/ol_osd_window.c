@@ -20,6 +20,7 @@
 #include <string.h>
 #include <math.h>
 #include "ol_osd_window.h"
+#include "ol_osd_surface_cache.h"
 #include "ol_utils.h"
 #include "ol_debug.h"
 
@@ -49,6 +50,7 @@ static const int BORDER_WIDTH = 5;
 static const int DEFAULT_WIDTH = 1024;
 static const int MAX_LYRIC_LEN = 256;
 static const int DEFAULT_FADE_IN_SIZE = 20;
+static const gsize DEFAULT_SURFACE_CACHE_SIZE = 8 * 1024 * 1024;
 
 enum DragState
 {
@@ -58,6 +60,33 @@ enum DragState
   DRAG_WEST,
 };
 
+/**
+ * State shared between an OSD window and the jobs prerendering its lyrics.
+ *
+ * Jobs hold a reference to it, so it outlives the window until every job
+ * has been handed back to the main loop.
+ */
+struct _OlOsdPrerender
+{
+  volatile gint ref_count;
+  volatile gint generation;     /* Bumped to cancel pending jobs */
+  OlOsdWindow *osd;             /* NULL if the window is destroyed */
+  PangoFontMap *font_map;       /* Created and used by the worker only */
+};
+
+struct _OlOsdPrerenderJob
+{
+  struct _OlOsdPrerender *shared;
+  gint generation;
+  char *key;
+  char *lyric;
+  OlOsdRenderSettings *settings;
+  OlColor active_colors[OL_LINEAR_COLOR_COUNT];
+  OlColor inactive_colors[OL_LINEAR_COLOR_COUNT];
+  cairo_surface_t *active_surface;
+  cairo_surface_t *inactive_surface;
+};
+
 typedef struct __OlOsdWindowPrivate OlOsdWindowPrivate;
 struct __OlOsdWindowPrivate
 {
@@ -83,7 +112,20 @@ struct __OlOsdWindowPrivate
   GtkRequisition child_requisition;
   cairo_surface_t *active_lyric_surfaces[OL_OSD_WINDOW_MAX_LINE_COUNT];
   cairo_surface_t *inactive_lyric_surfaces[OL_OSD_WINDOW_MAX_LINE_COUNT];
+  OlOsdSurfaceCache *surface_cache;
+  struct _OlOsdPrerender *prerender;
+  GThreadPool *prerender_pool;
+  GHashTable *prerender_pending; /* keys of lines being prerendered */
   GdkPixmap *shape_pixmap;
+  GdkGC *shape_gc;
+  /* 1-bit masks of the lyric surfaces, used to build the window shape */
+  GdkPixmap *lyric_masks[OL_OSD_WINDOW_MAX_LINE_COUNT];
+  /* Where each mask is placed in the shape combined into the window. A zero
+     width means the line is not in the shape. */
+  GdkRectangle shape_rects[OL_OSD_WINDOW_MAX_LINE_COUNT];
+  gboolean shape_committed;
+  guint64 repaint_pixels;       /* pixels repainted since repaint_stat_time */
+  gint64 repaint_stat_time;
   double blur_radius;
   enum OlOsdWindowMode mode;
   enum DragState drag_state;
@@ -153,18 +195,33 @@ static void ol_osd_window_move_resize (OlOsdWindow *osd,
                                        int width,
                                        int height,
                                        enum DragState drag_type);
-static void ol_osd_window_paint (OlOsdWindow *osd);
+static void ol_osd_window_paint (OlOsdWindow *osd, GdkRegion *region);
+static void ol_osd_window_count_repaint (OlOsdWindow *osd, GdkRegion *region);
+static void ol_osd_window_queue_sweep (OlOsdWindow *osd,
+                                       gint line,
+                                       double old_xpos,
+                                       double new_xpos,
+                                       double old_percentage,
+                                       double new_percentage);
 static void ol_osd_window_clear_cairo (cairo_t *cr);
 static void ol_osd_window_reset_shape_pixmap (OlOsdWindow *osd);
 static void ol_osd_window_update_shape (OlOsdWindow *osd);
 static void ol_osd_window_queue_reshape (OlOsdWindow *osd);
 static void ol_osd_window_set_input_shape_mask (OlOsdWindow *osd,
                                                 gboolean disable_input);
-static void ol_osd_draw_lyric_surface (OlOsdWindow *osd,
-                                       cairo_surface_t **surface,
-                                       const char *lyric);
+static cairo_surface_t *ol_osd_draw_lyric_surface (OlOsdWindow *osd,
+                                                    const char *lyric);
+static char *ol_osd_window_get_surface_key (OlOsdWindow *osd,
+                                            const char *lyric);
+static char *ol_osd_window_truncate_lyric (const char *lyric);
+static void ol_osd_window_prerender_func (struct _OlOsdPrerenderJob *job,
+                                          gpointer user_data);
+static gboolean ol_osd_window_prerender_done (struct _OlOsdPrerenderJob *job);
+static void ol_osd_window_prerender_job_free (struct _OlOsdPrerenderJob *job);
+static void ol_osd_window_prerender_unref (struct _OlOsdPrerender *prerender);
 static void ol_osd_window_update_lyric_surface (OlOsdWindow *osd, int line);
 static void ol_osd_window_update_lyric_rect (OlOsdWindow *osd, int line);
+static void ol_osd_window_update_lyric_mask (OlOsdWindow *osd, int line);
 static void ol_osd_window_update_colormap (OlOsdWindow *osd);
 static void ol_osd_window_screen_composited_changed (GdkScreen *screen,
                                                      gpointer userdata);
@@ -552,7 +609,7 @@ ol_osd_window_expose_before (GtkWidget *widget, GdkEventExpose *event)
   ol_assert_ret (OL_IS_OSD_WINDOW (widget), FALSE);
   OlOsdWindow *osd = OL_OSD_WINDOW (widget);
   if (ol_osd_window_panel_visible (osd))
-    ol_osd_window_paint (osd);
+    ol_osd_window_paint (osd, event->region);
   return FALSE;
 }
 
@@ -562,17 +619,27 @@ ol_osd_window_expose_after (GtkWidget *widget, GdkEventExpose *event)
   ol_assert_ret (OL_IS_OSD_WINDOW (widget), FALSE);
   OlOsdWindow *osd = OL_OSD_WINDOW (widget);
   if (!ol_osd_window_panel_visible (osd))
-    ol_osd_window_paint (osd);
+    ol_osd_window_paint (osd, event->region);
   return FALSE;
 }
 
+/**
+ * Paints the window. All painting is clipped to region, which is the area
+ * damaged since the last paint.
+ */
 static void
-ol_osd_window_paint (OlOsdWindow *osd)
+ol_osd_window_paint (OlOsdWindow *osd, GdkRegion *region)
 {
   ol_assert (OL_IS_OSD_WINDOW (osd));
   OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
   cairo_t *cr;
   cr = gdk_cairo_create (GTK_WIDGET (osd)->window);
+  if (region != NULL)
+  {
+    gdk_cairo_region (cr, region);
+    cairo_clip (cr);
+    ol_osd_window_count_repaint (osd, region);
+  }
   ol_osd_window_paint_bg (osd, cr);
   ol_osd_window_paint_lyrics (osd, cr);
   if (priv->update_shape)
@@ -580,6 +647,28 @@ ol_osd_window_paint (OlOsdWindow *osd)
   cairo_destroy (cr);
 }
 
+static void
+ol_osd_window_count_repaint (OlOsdWindow *osd, GdkRegion *region)
+{
+  OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
+  GdkRectangle *rects;
+  gint n_rects, i;
+  gdk_region_get_rectangles (region, &rects, &n_rects);
+  for (i = 0; i < n_rects; i++)
+    priv->repaint_pixels += (guint64) rects[i].width * rects[i].height;
+  g_free (rects);
+  gint64 now = g_get_monotonic_time ();
+  if (now - priv->repaint_stat_time >= G_USEC_PER_SEC)
+  {
+    if (priv->repaint_stat_time > 0)
+      ol_debugf ("OSD repainted %" G_GUINT64_FORMAT " pixels/s\n",
+                 priv->repaint_pixels * G_USEC_PER_SEC /
+                 (now - priv->repaint_stat_time));
+    priv->repaint_pixels = 0;
+    priv->repaint_stat_time = now;
+  }
+}
+
 static gboolean
 ol_osd_window_enter_notify (GtkWidget *widget, GdkEventCrossing *event)
 {
@@ -679,6 +768,8 @@ ol_osd_window_realize_cb (GtkWidget *widget,
                                                 G_CALLBACK (ol_osd_window_screen_composited_changed),
                                                 osd);
   }
+  /* The shape of the new GdkWindow is not set yet */
+  priv->shape_committed = FALSE;
   ol_osd_window_reset_shape_pixmap (osd);
   ol_osd_window_set_input_shape_mask (osd, priv->locked);
 }
@@ -1185,16 +1276,82 @@ ol_osd_window_set_percentage (OlOsdWindow *osd, gint line, double percentage)
     return;
   double old_percentage = osd->percentage[line];
   osd->percentage[line] = percentage;
+  OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
+  double old_x = ol_osd_window_compute_lyric_xpos (osd, line, old_percentage);
+  double new_x = ol_osd_window_compute_lyric_xpos (osd, line, percentage);
   /* update shape if line is too long */
+  if (!priv->composited && (int) old_x != (int) new_x)
+    priv->update_shape = TRUE;
+  ol_osd_window_queue_sweep (osd, line,
+                             old_x, new_x,
+                             old_percentage, percentage);
+}
+
+/**
+ * Converts a coordinate to the 24.8 fixed point numbers cairo draws with, so
+ * coordinates converted to the same value paint the same pixels.
+ */
+static gint
+ol_osd_window_to_cairo_fixed (double pos)
+{
+  return (gint) floor (pos * 256.0 + 0.5);
+}
+
+/**
+ * Invalidates the part of a line that changes when its percentage changes.
+ *
+ * If the line doesn't move, only the pixels between the old and new sweep
+ * positions are repainted, or nothing if they are painted at the same
+ * position. Otherwise the whole line is.
+ */
+static void
+ol_osd_window_queue_sweep (OlOsdWindow *osd,
+                           gint line,
+                           double old_xpos,
+                           double new_xpos,
+                           double old_percentage,
+                           double new_percentage)
+{
   OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
-  if (!priv->composited && percentage != old_percentage)
+  GtkWidget *widget = GTK_WIDGET (osd);
+  if (!gtk_widget_get_realized (widget))
+    return;
+  if (priv->active_lyric_surfaces[line] == NULL)
+    return;
+  if (osd->line_count == 1 && line != osd->current_line)
+    return;
+  gint w, h;
+  ol_osd_window_get_osd_size (osd, &w, &h);
+  int width = cairo_image_surface_get_width (priv->active_lyric_surfaces[line]);
+  int height = cairo_image_surface_get_height (priv->active_lyric_surfaces[line]);
+  int font_height = ol_osd_render_get_font_height (osd->render_context);
+  /* Accumulate the position as ol_osd_window_paint_lyrics does */
+  double ypos = ol_osd_window_compute_lyric_ypos (osd);
+  if (osd->line_count > 1)
   {
-    int old_x = ol_osd_window_compute_lyric_xpos (osd, line, old_percentage);
-    int new_x = ol_osd_window_compute_lyric_xpos (osd, line, percentage);
-    if (old_x != new_x)
-      priv->update_shape = TRUE;
+    int i;
+    for (i = 0; i < line; i++)
+      ypos += font_height * (1 + LINE_PADDING);
   }
-  gtk_widget_queue_draw (GTK_WIDGET (osd));
+  int left = BORDER_WIDTH;
+  int right = BORDER_WIDTH + w;
+  if (ol_osd_window_to_cairo_fixed (old_xpos) ==
+      ol_osd_window_to_cairo_fixed (new_xpos))
+  {
+    double old_sweep = BORDER_WIDTH + new_xpos + width * old_percentage;
+    double new_sweep = BORDER_WIDTH + new_xpos + width * new_percentage;
+    if (ol_osd_window_to_cairo_fixed (old_sweep) ==
+        ol_osd_window_to_cairo_fixed (new_sweep))
+      return;
+    /* Antialiasing touches the pixels on both sides of the sweep position */
+    left = MAX (left, floor (MIN (old_sweep, new_sweep)) - 1);
+    right = MIN (right, ceil (MAX (old_sweep, new_sweep)) + 1);
+  }
+  if (right <= left)
+    return;
+  int top = floor (ypos);
+  int bottom = ceil (ypos + height);
+  gtk_widget_queue_draw_area (widget, left, top, right - left, bottom - top);
 }
 
 void
@@ -1224,34 +1381,52 @@ gint ol_osd_window_get_current_line (OlOsdWindow *osd)
   return osd->current_line;
 }
 
-static void
-ol_osd_draw_lyric_surface (OlOsdWindow *osd, cairo_surface_t **surface, const char *lyric)
+gint
+ol_osd_window_get_lyric_width (OlOsdWindow *osd, gint line)
 {
-  if (*surface != NULL)
-  {
-    cairo_surface_destroy (*surface);
-    *surface = NULL;
-  }
-  if (!ol_is_string_empty (lyric) && *surface == NULL)
+  ol_assert_ret (OL_IS_OSD_WINDOW (osd), 0);
+  ol_assert_ret (line >= 0 && line < OL_OSD_WINDOW_MAX_LINE_COUNT, 0);
+  OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
+  if (priv->active_lyric_surfaces[line] == NULL)
+    return 0;
+  return cairo_image_surface_get_width (priv->active_lyric_surfaces[line]);
+}
+
+static cairo_surface_t *
+ol_osd_draw_lyric_surface (OlOsdWindow *osd, const char *lyric)
+{
+  if (!gtk_widget_get_realized (GTK_WIDGET (osd)))
+    gtk_widget_realize (GTK_WIDGET (osd));
+  return ol_osd_render_create_text_surface (osd->render_context, lyric);
+}
+
+/**
+ * Builds the key of a lyric line in the surface cache.
+ *
+ * The key contains everything that affects how the line is rendered.
+ */
+static char *
+ol_osd_window_get_surface_key (OlOsdWindow *osd, const char *lyric)
+{
+  OlOsdRenderContext *context = osd->render_context;
+  GString *key = g_string_new (NULL);
+  int i;
+  g_string_append_printf (key, "%s\n%d\n%.3lf\n",
+                          context->font_name,
+                          context->outline_width,
+                          context->blur_radius);
+  for (i = 0; i < OL_LINEAR_COLOR_COUNT; i++)
   {
-    int w, h;
-    if (!gtk_widget_get_realized (GTK_WIDGET (osd)))
-      gtk_widget_realize (GTK_WIDGET (osd));
-    ol_osd_render_get_pixel_size (osd->render_context,
-                                  lyric,
-                                  &w, &h);
-    *surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, w, h);
-    cairo_t *cr = cairo_create (*surface);
-    cairo_set_source_rgba (cr, 1.0, 1.0, 1.0, 0.0);
-    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
-    cairo_paint (cr);
-    ol_osd_render_paint_text (osd->render_context,
-                              cr,
-                              lyric,
-                              0,
-                              0);
-    cairo_destroy (cr);
+    g_string_append_printf (key, "%.4lf,%.4lf,%.4lf;%.4lf,%.4lf,%.4lf\n",
+                            osd->active_colors[i].r,
+                            osd->active_colors[i].g,
+                            osd->active_colors[i].b,
+                            osd->inactive_colors[i].r,
+                            osd->inactive_colors[i].g,
+                            osd->inactive_colors[i].b);
   }
+  g_string_append (key, lyric);
+  return g_string_free (key, FALSE);
 }
 
 static void
@@ -1261,29 +1436,92 @@ ol_osd_window_update_lyric_surface (OlOsdWindow *osd, int line)
   if (!gtk_widget_get_realized (GTK_WIDGET (osd)))
     return;
   OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
-  /* draws the inactive surfaces */
-  for (i = 0; i < OL_LINEAR_COLOR_COUNT; i++)
+  if (priv->inactive_lyric_surfaces[line] != NULL)
   {
-    ol_osd_render_set_linear_color (osd->render_context,
-                                    i,
-                                    osd->inactive_colors[i]);
+    cairo_surface_destroy (priv->inactive_lyric_surfaces[line]);
+    priv->inactive_lyric_surfaces[line] = NULL;
   }
-  ol_osd_draw_lyric_surface (osd,
-                             &priv->inactive_lyric_surfaces[line],
-                             osd->lyrics[line]);
-  /* draws the active surfaces */
-  for (i = 0; i < OL_LINEAR_COLOR_COUNT; i++)
+  if (priv->active_lyric_surfaces[line] != NULL)
+  {
+    cairo_surface_destroy (priv->active_lyric_surfaces[line]);
+    priv->active_lyric_surfaces[line] = NULL;
+  }
+  if (priv->lyric_masks[line] != NULL)
   {
-    ol_osd_render_set_linear_color (osd->render_context,
-                                    i,
-                                    osd->active_colors[i]);
+    g_object_unref (priv->lyric_masks[line]);
+    priv->lyric_masks[line] = NULL;
+  }
+  if (!ol_is_string_empty (osd->lyrics[line]))
+  {
+    char *key = ol_osd_window_get_surface_key (osd, osd->lyrics[line]);
+    if (!ol_osd_surface_cache_lookup (priv->surface_cache,
+                                      key,
+                                      &priv->active_lyric_surfaces[line],
+                                      &priv->inactive_lyric_surfaces[line]))
+    {
+      /* draws the inactive surfaces */
+      for (i = 0; i < OL_LINEAR_COLOR_COUNT; i++)
+      {
+        ol_osd_render_set_linear_color (osd->render_context,
+                                        i,
+                                        osd->inactive_colors[i]);
+      }
+      priv->inactive_lyric_surfaces[line] =
+        ol_osd_draw_lyric_surface (osd, osd->lyrics[line]);
+      /* draws the active surfaces */
+      for (i = 0; i < OL_LINEAR_COLOR_COUNT; i++)
+      {
+        ol_osd_render_set_linear_color (osd->render_context,
+                                        i,
+                                        osd->active_colors[i]);
+      }
+      priv->active_lyric_surfaces[line] =
+        ol_osd_draw_lyric_surface (osd, osd->lyrics[line]);
+      ol_osd_surface_cache_insert (priv->surface_cache,
+                                   key,
+                                   priv->active_lyric_surfaces[line],
+                                   priv->inactive_lyric_surfaces[line]);
+    }
+    g_free (key);
+    if (!priv->composited)
+      ol_osd_window_update_lyric_mask (osd, line);
   }
-  ol_osd_draw_lyric_surface (osd,
-                             &priv->active_lyric_surfaces[line],
-                             osd->lyrics[line]);
   ol_osd_window_update_lyric_rect (osd, line);
 }
 
+/**
+ * Renders the 1-bit mask of the lyric surfaces of the line, which is blitted
+ * into the window shape on non-composited screens.
+ */
+static void
+ol_osd_window_update_lyric_mask (OlOsdWindow *osd, int line)
+{
+  OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
+  if (priv->lyric_masks[line] != NULL)
+  {
+    g_object_unref (priv->lyric_masks[line]);
+    priv->lyric_masks[line] = NULL;
+  }
+  priv->shape_committed = FALSE;
+  if (priv->active_lyric_surfaces[line] == NULL ||
+      priv->inactive_lyric_surfaces[line] == NULL)
+    return;
+  int width = cairo_image_surface_get_width (priv->active_lyric_surfaces[line]);
+  int height = cairo_image_surface_get_height (priv->active_lyric_surfaces[line]);
+  GdkPixmap *mask = gdk_pixmap_new (GTK_WIDGET (osd)->window, width, height, 1);
+  cairo_t *cr = gdk_cairo_create (mask);
+  ol_osd_window_clear_cairo (cr);
+  /* The swept part of a line is painted with the active surface and the rest
+     with the inactive one, so the shape is the union of both. */
+  cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+  cairo_set_source_surface (cr, priv->active_lyric_surfaces[line], 0, 0);
+  cairo_paint (cr);
+  cairo_set_source_surface (cr, priv->inactive_lyric_surfaces[line], 0, 0);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+  priv->lyric_masks[line] = mask;
+}
+
 static void
 ol_osd_window_update_lyric_rect (OlOsdWindow *osd, int line)
 {
@@ -1305,6 +1543,17 @@ ol_osd_window_update_lyric_rect (OlOsdWindow *osd, int line)
   osd->lyric_rects[line].height = h;
 }
 
+static char *
+ol_osd_window_truncate_lyric (const char *lyric)
+{
+  if (lyric == NULL)
+    return g_strdup ("");
+  if (g_utf8_strlen (lyric, -1) > MAX_LYRIC_LEN)
+    return g_strndup (lyric,
+                      g_utf8_offset_to_pointer (lyric, MAX_LYRIC_LEN) - lyric);
+  return g_strdup (lyric);
+}
+
 void
 ol_osd_window_set_lyric (OlOsdWindow *osd, gint line, const char *lyric)
 {
@@ -1313,18 +1562,7 @@ ol_osd_window_set_lyric (OlOsdWindow *osd, gint line, const char *lyric)
   ol_assert (line >= 0 && line < OL_OSD_WINDOW_MAX_LINE_COUNT);
   if (osd->lyrics[line] != NULL)
     g_free (osd->lyrics[line]);
-  if (lyric != NULL)
-  {
-    if (g_utf8_strlen (lyric, -1) > MAX_LYRIC_LEN)
-      osd->lyrics[line] = g_strndup (lyric,
-                                     g_utf8_offset_to_pointer (lyric, MAX_LYRIC_LEN) - lyric);
-    else
-      osd->lyrics[line] = g_strdup (lyric);
-  }
-  else
-  {
-    osd->lyrics[line] = g_strdup ("");
-  }
+  osd->lyrics[line] = ol_osd_window_truncate_lyric (lyric);
   ol_osd_window_update_lyric_surface (osd, line);
   /* We have to call ol_osd_window_update_shape instead of
      ol_osd_window_queue_reshape here, because there might be empty shape
@@ -1380,6 +1618,10 @@ ol_osd_window_reset_shape_pixmap (OlOsdWindow *osd)
   cairo_t *cr = gdk_cairo_create (priv->shape_pixmap);
   ol_osd_window_clear_cairo (cr);
   cairo_destroy (cr);
+  if (priv->shape_gc != NULL)
+    g_object_unref (priv->shape_gc);
+  priv->shape_gc = gdk_gc_new (priv->shape_pixmap);
+  priv->shape_committed = FALSE;
   ol_osd_window_queue_reshape (osd);
 }
 
@@ -1408,22 +1650,77 @@ ol_osd_window_update_shape (OlOsdWindow *osd)
       empty_mask = TRUE;
       gdk_window_shape_combine_mask (widget->window, NULL, 0, 0);
     }
+    priv->shape_committed = FALSE;
     return;
   }
+  if (priv->shape_pixmap == NULL)
+    return;
   empty_mask = FALSE;
-  GdkPixmap *shape_mask = priv->shape_pixmap;
-  GdkGC *fg_gc = gdk_gc_new (shape_mask);
+  /* Place the mask of each visible line as ol_osd_window_paint_lyrics
+     places its surfaces */
+  GdkRectangle rects[OL_OSD_WINDOW_MAX_LINE_COUNT];
+  memset (rects, 0, sizeof (rects));
+  int font_height = ol_osd_render_get_font_height (osd->render_context);
+  int ypos = ol_osd_window_compute_lyric_ypos (osd);
+  int line, start, end;
+  if (osd->line_count == 1)
+  {
+    start = osd->current_line;
+    end = start + 1;
+  }
+  else
+  {
+    start = 0;
+    end = OL_OSD_WINDOW_MAX_LINE_COUNT;
+  }
+  for (line = start; line < end; line++)
+  {
+    if (priv->active_lyric_surfaces[line] != NULL &&
+        priv->inactive_lyric_surfaces[line] != NULL)
+    {
+      if (priv->lyric_masks[line] == NULL)
+        ol_osd_window_update_lyric_mask (osd, line);
+      double xpos = ol_osd_window_compute_lyric_xpos (osd,
+                                                      line,
+                                                      osd->percentage[line]);
+      rects[line].x = BORDER_WIDTH + (int) floor (xpos + 0.5);
+      rects[line].y = ypos;
+      gdk_drawable_get_size (priv->lyric_masks[line],
+                             &rects[line].width,
+                             &rects[line].height);
+    }
+    ypos += font_height * (1 + LINE_PADDING);
+  }
+  priv->update_shape = FALSE;
+  if (priv->shape_committed &&
+      memcmp (rects, priv->shape_rects, sizeof (rects)) == 0)
+    return;
+  GdkGC *gc = priv->shape_gc;
   GdkColor color;
+  gint w, h;
+  gdk_drawable_get_size (priv->shape_pixmap, &w, &h);
   color.pixel = 0;
-  gdk_gc_set_foreground (fg_gc, &color);
-  gdk_gc_set_background (fg_gc, &color);
-  cairo_t *cr = gdk_cairo_create (shape_mask);
-  ol_osd_window_clear_cairo (cr);
-  ol_osd_window_paint_lyrics (osd, cr);
-  cairo_destroy (cr);
-  gdk_window_shape_combine_mask (widget->window, shape_mask, 0, 0);
-  priv->update_shape = FALSE;
-  g_object_unref (fg_gc);
+  gdk_gc_set_foreground (gc, &color);
+  gdk_gc_set_function (gc, GDK_COPY);
+  gdk_gc_set_clip_rectangle (gc, NULL);
+  gdk_draw_rectangle (priv->shape_pixmap, gc, TRUE, 0, 0, w, h);
+  GdkRectangle clip;
+  ol_osd_window_get_osd_size (osd, &clip.width, &clip.height);
+  clip.x = BORDER_WIDTH;
+  clip.y = BORDER_WIDTH;
+  gdk_gc_set_clip_rectangle (gc, &clip);
+  gdk_gc_set_function (gc, GDK_OR);
+  for (line = start; line < end; line++)
+  {
+    if (rects[line].width > 0)
+      gdk_draw_drawable (priv->shape_pixmap, gc, priv->lyric_masks[line],
+                         0, 0,
+                         rects[line].x, rects[line].y,
+                         rects[line].width, rects[line].height);
+  }
+  gdk_window_shape_combine_mask (widget->window, priv->shape_pixmap, 0, 0);
+  memcpy (priv->shape_rects, rects, sizeof (rects));
+  priv->shape_committed = TRUE;
 }
 
 static void
@@ -1736,8 +2033,17 @@ ol_osd_window_init (OlOsdWindow *osd)
     }
     osd->render_context = ol_osd_render_context_new ();
     osd->translucent_on_mouse_over = FALSE;
+    priv->surface_cache = ol_osd_surface_cache_new (DEFAULT_SURFACE_CACHE_SIZE);
+    priv->prerender = g_new0 (struct _OlOsdPrerender, 1);
+    priv->prerender->ref_count = 1;
+    priv->prerender->osd = osd;
+    priv->prerender_pool = NULL;
+    priv->prerender_pending = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                     g_free, NULL);
     /* initilaize private data */
     priv->shape_pixmap = NULL;
+    priv->repaint_pixels = 0;
+    priv->repaint_stat_time = 0;
     priv->width = DEFAULT_WIDTH;
     priv->locked = TRUE;
     priv->composited = FALSE;
@@ -1752,6 +2058,10 @@ ol_osd_window_init (OlOsdWindow *osd)
     priv->raw_y = 0;
     priv->drag_state = DRAG_NONE;
     priv->update_shape = FALSE;
+    priv->shape_gc = NULL;
+    priv->shape_committed = FALSE;
+    for (i = 0; i < OL_OSD_WINDOW_MAX_LINE_COUNT; i++)
+      priv->lyric_masks[i] = NULL;
     priv->blur_radius = 0.0;
     /* ol_osd_window_set_mode (osd, OL_OSD_WINDOW_DOCK); */
     ol_osd_window_set_mode (osd, OL_OSD_WINDOW_NORMAL);
@@ -1845,6 +2155,38 @@ ol_osd_window_destroy (GtkObject *object)
     g_object_unref (priv->shape_pixmap);
     priv->shape_pixmap = NULL;
   }
+  if (priv->shape_gc != NULL)
+  {
+    g_object_unref (priv->shape_gc);
+    priv->shape_gc = NULL;
+  }
+  for (i = 0; i < OL_OSD_WINDOW_MAX_LINE_COUNT; i++)
+  {
+    if (priv->lyric_masks[i] != NULL)
+    {
+      g_object_unref (priv->lyric_masks[i]);
+      priv->lyric_masks[i] = NULL;
+    }
+  }
+  if (priv->prerender != NULL)
+  {
+    ol_osd_window_cancel_prerender (osd);
+    priv->prerender->osd = NULL;
+    /* Wait for the running job. Pending ones are skipped since they are
+       cancelled. */
+    if (priv->prerender_pool != NULL)
+      g_thread_pool_free (priv->prerender_pool, FALSE, TRUE);
+    priv->prerender_pool = NULL;
+    ol_osd_window_prerender_unref (priv->prerender);
+    priv->prerender = NULL;
+    g_hash_table_destroy (priv->prerender_pending);
+    priv->prerender_pending = NULL;
+  }
+  if (priv->surface_cache != NULL)
+  {
+    ol_osd_surface_cache_free (priv->surface_cache);
+    priv->surface_cache = NULL;
+  }
   if (osd->render_context != NULL)
   {
     ol_osd_render_context_destroy (osd->render_context);
@@ -2077,3 +2419,161 @@ ol_osd_window_get_blur_radius (OlOsdWindow *osd)
   OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
   return priv->blur_radius;
 }
+
+void
+ol_osd_window_set_surface_cache_size (OlOsdWindow *osd, gsize bytes)
+{
+  ol_assert (OL_IS_OSD_WINDOW (osd));
+  OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
+  ol_osd_surface_cache_set_max_bytes (priv->surface_cache, bytes);
+}
+
+void
+ol_osd_window_clear_surface_cache (OlOsdWindow *osd)
+{
+  ol_assert (OL_IS_OSD_WINDOW (osd));
+  OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
+  ol_osd_window_cancel_prerender (osd);
+  ol_osd_surface_cache_clear (priv->surface_cache);
+}
+
+static void
+ol_osd_window_prerender_unref (struct _OlOsdPrerender *prerender)
+{
+  if (g_atomic_int_dec_and_test (&prerender->ref_count))
+  {
+    /* No job holds it, so the worker is done with the font map */
+    if (prerender->font_map != NULL)
+      g_object_unref (prerender->font_map);
+    g_free (prerender);
+  }
+}
+
+static void
+ol_osd_window_prerender_job_free (struct _OlOsdPrerenderJob *job)
+{
+  if (job->settings != NULL)
+    ol_osd_render_settings_free (job->settings);
+  if (job->active_surface != NULL)
+    cairo_surface_destroy (job->active_surface);
+  if (job->inactive_surface != NULL)
+    cairo_surface_destroy (job->inactive_surface);
+  ol_osd_window_prerender_unref (job->shared);
+  g_free (job->key);
+  g_free (job->lyric);
+  g_free (job);
+}
+
+/**
+ * Renders a line in a worker thread, then hands the result back to the
+ * main loop.
+ */
+static void
+ol_osd_window_prerender_func (struct _OlOsdPrerenderJob *job,
+                              gpointer user_data)
+{
+  int i;
+  if (job->generation == g_atomic_int_get (&job->shared->generation))
+  {
+    /* Pango objects are not thread-safe, so the worker renders with its own
+       font map, and the context is only used in this thread */
+    if (job->shared->font_map == NULL)
+      job->shared->font_map = pango_cairo_font_map_new ();
+    OlOsdRenderContext *context =
+      ol_osd_render_context_new_from_settings (job->settings,
+                                               job->shared->font_map);
+    for (i = 0; i < OL_LINEAR_COLOR_COUNT; i++)
+      ol_osd_render_set_linear_color (context, i,
+                                      job->inactive_colors[i]);
+    job->inactive_surface = ol_osd_render_create_text_surface (context,
+                                                               job->lyric);
+    for (i = 0; i < OL_LINEAR_COLOR_COUNT; i++)
+      ol_osd_render_set_linear_color (context, i,
+                                      job->active_colors[i]);
+    job->active_surface = ol_osd_render_create_text_surface (context,
+                                                             job->lyric);
+    ol_osd_render_context_destroy (context);
+  }
+  g_idle_add ((GSourceFunc) ol_osd_window_prerender_done, job);
+}
+
+static gboolean
+ol_osd_window_prerender_done (struct _OlOsdPrerenderJob *job)
+{
+  OlOsdWindow *osd = job->shared->osd;
+  if (osd != NULL &&
+      job->generation == g_atomic_int_get (&job->shared->generation))
+  {
+    OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
+    g_hash_table_remove (priv->prerender_pending, job->key);
+    if (job->active_surface != NULL && job->inactive_surface != NULL)
+      ol_osd_surface_cache_insert (priv->surface_cache,
+                                   job->key,
+                                   job->active_surface,
+                                   job->inactive_surface);
+  }
+  ol_osd_window_prerender_job_free (job);
+  return FALSE;
+}
+
+void
+ol_osd_window_prerender_lyric (OlOsdWindow *osd, const char *lyric)
+{
+  ol_assert (OL_IS_OSD_WINDOW (osd));
+  OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
+  if (ol_is_string_empty (lyric) ||
+      ol_osd_surface_cache_get_max_bytes (priv->surface_cache) == 0 ||
+      !gtk_widget_get_realized (GTK_WIDGET (osd)))
+    return;
+  char *text = ol_osd_window_truncate_lyric (lyric);
+  char *key = ol_osd_window_get_surface_key (osd, text);
+  if (ol_osd_surface_cache_contains (priv->surface_cache, key) ||
+      g_hash_table_lookup (priv->prerender_pending, key) != NULL)
+  {
+    g_free (key);
+    g_free (text);
+    return;
+  }
+  if (priv->prerender_pool == NULL)
+  {
+    GError *error = NULL;
+    /* A single worker, so that the font map is never used by two threads */
+    priv->prerender_pool = g_thread_pool_new ((GFunc) ol_osd_window_prerender_func,
+                                              NULL,
+                                              1,
+                                              FALSE,
+                                              &error);
+    if (priv->prerender_pool == NULL)
+    {
+      ol_errorf ("Cannot create prerender thread: %s\n", error->message);
+      g_error_free (error);
+      g_free (key);
+      g_free (text);
+      return;
+    }
+  }
+  struct _OlOsdPrerenderJob *job = g_new0 (struct _OlOsdPrerenderJob, 1);
+  g_atomic_int_inc (&priv->prerender->ref_count);
+  job->shared = priv->prerender;
+  job->generation = g_atomic_int_get (&priv->prerender->generation);
+  job->key = key;
+  job->lyric = text;
+  job->settings = ol_osd_render_get_settings (osd->render_context);
+  memcpy (job->active_colors, osd->active_colors, sizeof (job->active_colors));
+  memcpy (job->inactive_colors, osd->inactive_colors,
+          sizeof (job->inactive_colors));
+  g_hash_table_insert (priv->prerender_pending, g_strdup (key),
+                       GINT_TO_POINTER (TRUE));
+  g_thread_pool_push (priv->prerender_pool, job, NULL);
+}
+
+void
+ol_osd_window_cancel_prerender (OlOsdWindow *osd)
+{
+  ol_assert (OL_IS_OSD_WINDOW (osd));
+  OlOsdWindowPrivate *priv = OL_OSD_WINDOW_GET_PRIVATE (osd);
+  if (priv->prerender == NULL)
+    return;
+  g_atomic_int_inc (&priv->prerender->generation);
+  g_hash_table_remove_all (priv->prerender_pending);
+}
@@ -161,6 +161,15 @@ void ol_osd_window_set_current_line (OlOsdWindow *osd, gint line);
  * @return The line number of the current lyric.
  */
 gint ol_osd_window_get_current_line (OlOsdWindow *osd);
+/**
+ * @brief Gets the width of the rendered lyric of certain line
+ *
+ * @param osd An OlOsdWindow
+ * @param line The line number, can be 0 or 1
+ *
+ * @return The width in pixels, or 0 if the line has no lyric.
+ */
+gint ol_osd_window_get_lyric_width (OlOsdWindow *osd, gint line);
 
 /**
  * @brief Set the lyric of certain line
@@ -323,4 +332,43 @@ void ol_osd_window_set_blur_radius (OlOsdWindow *osd, double radius);
  * @return
  */
 double ol_osd_window_get_blur_radius (OlOsdWindow *osd);
+
+/**
+ * Sets the size of the cache of rendered lyric lines.
+ *
+ * Lines that have been rendered with the same text, font, outline, blur
+ * radius and colors are reused from the cache instead of being rendered
+ * again.
+ * @param osd
+ * @param bytes The maximum number of bytes of cached surfaces. 0 disables
+ *              the cache.
+ */
+void ol_osd_window_set_surface_cache_size (OlOsdWindow *osd, gsize bytes);
+
+/**
+ * Drops all lines in the cache of rendered lyric lines.
+ *
+ * @param osd
+ */
+void ol_osd_window_clear_surface_cache (OlOsdWindow *osd);
+
+/**
+ * Renders a lyric line in a worker thread ahead of time.
+ *
+ * The rendered surfaces are put into the cache of rendered lyric lines, so
+ * that setting the lyric later with ol_osd_window_set_lyric does not render
+ * it again. Nothing happens if the line is already cached or the cache is
+ * disabled.
+ * @param osd
+ * @param lyric The lyric text to render.
+ */
+void ol_osd_window_prerender_lyric (OlOsdWindow *osd, const char *lyric);
+
+/**
+ * Cancels all lines queued by ol_osd_window_prerender_lyric that have not
+ * finished rendering.
+ *
+ * @param osd
+ */
+void ol_osd_window_cancel_prerender (OlOsdWindow *osd);
 #endif // __OSD_WINDOW_H__
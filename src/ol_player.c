@@ -37,6 +37,9 @@
   ((OlPlayerPrivate *)((OL_PLAYER(object))->priv))
 
 const int POSITION_ACCURACY_MS = 1000;
+/* Interval to poll the position while playing. The timeline uses it to
+ * correct its drift from the player. */
+static const guint POSITION_SYNC_INTERVAL_MS = 5000;
 
 enum {
   PLAYER_LOST,
@@ -44,6 +47,7 @@ enum {
   TRACK_CHANGED,
   STATUS_CHANGED,
   CAPS_CHANGED,
+  POSITION_CHANGED,
   LAST_SIGNAL,
 };
 
@@ -70,6 +74,8 @@ struct _OlPlayerPrivate
   gchar *player_name;
   gchar *player_icon;
   GCancellable *cancel_player_info;
+  GCancellable *cancel_position_sync;
+  guint position_sync_source;
   OlTimeline *timeline;
   gboolean initialized;
 };
@@ -126,7 +132,16 @@ static void ol_player_fetch_player_info_cb (GObject *source_object,
 static void ol_player_set_player_info (OlPlayer *player,
                                        GVariant *value);
 static void ol_player_update_position (OlPlayer *player,
-                                       GVariant *value);
+                                       GVariant *value,
+                                       gboolean seeked);
+static void ol_player_update_rate (OlPlayer *player,
+                                   GVariant *value);
+static void ol_player_start_position_sync (OlPlayer *player);
+static void ol_player_stop_position_sync (OlPlayer *player);
+static gboolean ol_player_position_sync_cb (gpointer user_data);
+static void ol_player_position_sync_finish_cb (GObject *source_object,
+                                               GAsyncResult *res,
+                                               gpointer user_data);
 static void ol_player_update_metadata (OlPlayer *player,
                                        GVariant *value);
 static void ol_player_update_status (OlPlayer *player,
@@ -198,6 +213,16 @@ ol_player_class_init (OlPlayerClass *klass)
                   g_cclosure_marshal_VOID__VOID,
                   G_TYPE_NONE,
                   0);
+  /* Emitted when the position jumps, e.g. the player seeks */
+  signals[POSITION_CHANGED] =
+    g_signal_new ("position-changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0,            /* class_offset */
+                  NULL, NULL,   /* accumulator, accu_data */
+                  g_cclosure_marshal_VOID__VOID,
+                  G_TYPE_NONE,
+                  0);
 }
 
 OlPlayer *
@@ -349,6 +374,7 @@ ol_player_finalize (GObject *object)
     private->player_icon = NULL;
   }
   _cancel_call (&private->cancel_player_info);
+  ol_player_stop_position_sync (OL_PLAYER (object));
   ol_timeline_free (private->timeline);
   private->timeline = NULL;
   G_OBJECT_CLASS (ol_player_parent_class)->finalize (object);
@@ -392,7 +418,7 @@ ol_player_mpris2_proxy_signal (GDBusProxy *proxy,
   {
     GVariant *value;
     g_variant_get (parameters, "(@x)", &value);
-    ol_player_update_position (player, value);
+    ol_player_update_position (player, value, TRUE);
     g_variant_unref (value);
   }
 }
@@ -420,6 +446,10 @@ ol_player_mpris2_proxy_properties_changed (GDBusProxy *proxy,
     {
       ol_player_update_status (player, value);
     }
+    else if (g_str_equal (key, "Rate"))
+    {
+      ol_player_update_rate (player, value);
+    }
     else
     {
       gint i;
@@ -567,11 +597,13 @@ ol_player_set_player_info (OlPlayer *player,
   private->player_icon = NULL;
   if (value == NULL)
   {
-    /* Player lost, clear the properties */
+    /* Player lost, clear the properties. The position sync is restarted by
+       the playback status once a player is connected again. */
+    ol_player_stop_position_sync (player);
     if (private->connected)
     {
       ol_player_update_metadata (player, NULL);
-      ol_player_update_position (player, NULL);
+      ol_player_update_position (player, NULL, FALSE);
       ol_player_update_status (player, NULL);
       ol_player_update_caps (player,
                              OL_PLAYER_PLAY | OL_PLAYER_NEXT | OL_PLAYER_PREV |
@@ -633,11 +665,12 @@ ol_player_set_player_info (OlPlayer *player,
                private->player_icon);
     g_variant_iter_free (iter);
     ol_player_update_metadata (player, NULL);
+    ol_player_update_rate (player, NULL);
     ol_player_update_status (player, NULL);
     ol_player_update_caps (player,
                            OL_PLAYER_NEXT | OL_PLAYER_PREV | OL_PLAYER_PLAY |
                            OL_PLAYER_PAUSE | OL_PLAYER_SEEK, NULL);
-    ol_player_update_position (player, NULL);
+    ol_player_update_position (player, NULL, FALSE);
     private->connected = TRUE;
   }
 }
@@ -681,7 +714,8 @@ ol_player_get_property (GDBusProxy *proxy,
 
 static void
 ol_player_update_position (OlPlayer *player,
-                           GVariant *value)
+                           GVariant *value,
+                           gboolean seeked)
 {
   OlPlayerPrivate *priv = OL_PLAYER_GET_PRIVATE (player);
   if (!value)
@@ -691,9 +725,120 @@ ol_player_update_position (OlPlayer *player,
     g_variant_ref (value);
   if (!value)
     return;
-  ol_timeline_maybe_set_time (priv->timeline,
-                              g_variant_get_int64 (value) / 1000);
+  gint64 position = g_variant_get_int64 (value) / 1000;
+  g_variant_unref (value);
+  if (seeked)
+    ol_timeline_set_time (priv->timeline, position);
+  else if (!ol_timeline_maybe_set_time (priv->timeline, position))
+    return;
+  g_signal_emit (player, signals[POSITION_CHANGED], 0);
+}
+
+static void
+ol_player_update_rate (OlPlayer *player,
+                       GVariant *value)
+{
+  OlPlayerPrivate *priv = OL_PLAYER_GET_PRIVATE (player);
+  if (!value)
+    value = g_dbus_proxy_get_cached_property (priv->mpris2_proxy, "Rate");
+  else
+    g_variant_ref (value);
+  if (!value)
+  {
+    /* Rate is optional for MPRIS2 players */
+    ol_timeline_set_rate (priv->timeline, 1.0);
+    return;
+  }
+  if (g_variant_is_of_type (value, G_VARIANT_TYPE_DOUBLE))
+    ol_timeline_set_rate (priv->timeline, g_variant_get_double (value));
+  else
+    ol_errorf ("Unknown type of Rate: %s\n", g_variant_get_type_string (value));
+  g_variant_unref (value);
+  g_signal_emit (player, signals[POSITION_CHANGED], 0);
+}
+
+static void
+ol_player_start_position_sync (OlPlayer *player)
+{
+  OlPlayerPrivate *priv = OL_PLAYER_GET_PRIVATE (player);
+  if (priv->position_sync_source)
+    return;
+  priv->position_sync_source = g_timeout_add (POSITION_SYNC_INTERVAL_MS,
+                                              ol_player_position_sync_cb,
+                                              player);
+}
+
+static void
+ol_player_stop_position_sync (OlPlayer *player)
+{
+  OlPlayerPrivate *priv = OL_PLAYER_GET_PRIVATE (player);
+  if (priv->position_sync_source)
+  {
+    g_source_remove (priv->position_sync_source);
+    priv->position_sync_source = 0;
+  }
+  _cancel_call (&priv->cancel_position_sync);
+}
+
+static gboolean
+ol_player_position_sync_cb (gpointer user_data)
+{
+  ol_assert_ret (OL_IS_PLAYER (user_data), FALSE);
+  OlPlayer *player = OL_PLAYER (user_data);
+  OlPlayerPrivate *priv = OL_PLAYER_GET_PRIVATE (player);
+  if (priv->cancel_position_sync || !priv->mpris2_proxy)
+    return TRUE;
+  /* Position is not notified by PropertiesChanged, so the cached value of
+   * the proxy is always outdated. */
+  priv->cancel_position_sync = g_cancellable_new ();
+  g_dbus_connection_call (g_dbus_proxy_get_connection (priv->mpris2_proxy),
+                          g_dbus_proxy_get_name (priv->mpris2_proxy),
+                          g_dbus_proxy_get_object_path (priv->mpris2_proxy),
+                          "org.freedesktop.DBus.Properties",
+                          "Get",
+                          g_variant_new ("(ss)",
+                                         OL_IFACE_MPRIS2_PLAYER,
+                                         "Position"),
+                          G_VARIANT_TYPE ("(v)"),
+                          G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                          -1,   /* timeout_msec */
+                          priv->cancel_position_sync,
+                          ol_player_position_sync_finish_cb,
+                          player);
+  return TRUE;
+}
+
+static void
+ol_player_position_sync_finish_cb (GObject *source_object,
+                                   GAsyncResult *res,
+                                   gpointer user_data)
+{
+  GError *error = NULL;
+  GVariant *result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object),
+                                                    res,
+                                                    &error);
+  if (!result && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+  {
+    /* The player may have been finalized */
+    g_error_free (error);
+    return;
+  }
+  ol_assert (OL_IS_PLAYER (user_data));
+  OlPlayer *player = OL_PLAYER (user_data);
+  OlPlayerPrivate *priv = OL_PLAYER_GET_PRIVATE (player);
+  _cancel_call (&priv->cancel_position_sync);
+  if (!result)
+  {
+    ol_debugf ("Cannot sync position: %s\n", error->message);
+    g_error_free (error);
+    return;
+  }
+  GVariant *value = NULL;
+  g_variant_get (result, "(v)", &value);
+  if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT64))
+    ol_player_update_position (player, value, FALSE);
   g_variant_unref (value);
+  g_variant_unref (result);
 }
 
 static void
@@ -714,7 +859,7 @@ ol_player_update_metadata (OlPlayer *player,
   g_signal_emit (player, signals[TRACK_CHANGED], 0);
   g_variant_unref (value);
   ol_timeline_set_time (priv->timeline, 0);
-  ol_player_update_position (player, NULL);
+  ol_player_update_position (player, NULL, TRUE);
 }
 
 static void
@@ -734,16 +879,19 @@ ol_player_update_status (OlPlayer *player,
   {
     priv->status = OL_PLAYER_PLAYING;
     ol_timeline_play (priv->timeline);
+    ol_player_start_position_sync (player);
   }
   else if (g_str_equal (status_str, "Paused"))
   {
     priv->status = OL_PLAYER_PAUSED;
     ol_timeline_pause (priv->timeline);
+    ol_player_stop_position_sync (player);
   }
   else if (g_str_equal (status_str, "Stopped"))
   {
     priv->status = OL_PLAYER_STOPPED;
     ol_timeline_stop (priv->timeline);
+    ol_player_stop_position_sync (player);
   }
   else
   {
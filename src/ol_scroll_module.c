@@ -36,16 +36,26 @@ typedef struct _OlScrollModule OlScrollModule;
 
 struct OlLrc;
 const int MESSAGE_TIMEOUT_MS = 5000;
+/* The window is configured continuously while dragged, the position and size
+   are sent to the config daemon at most once in the interval */
+const int CONFIG_COMMIT_INTERVAL_MS = 500;
 
 struct _OlScrollModule
 {
+  struct OlDisplayModule *display_module;
   OlPlayer *player;
   OlMetadata *metadata;
   guint64 duration;
   OlLrc *lrc;
+  OlLrcCursor cursor;
   OlScrollWindow *scroll;
   guint message_timer;
   GList *config_bindings;
+  gboolean iconified;
+  /* The batch of the config values of the window position and size, which
+     are set while the window is dragged, and the timeout to commit it */
+  OlConfigBatch *config_batch;
+  guint config_commit_source;
 };
 
 typedef void (*_ConfigSetFunc) (OlConfigProxy *config,
@@ -78,6 +88,8 @@ static void ol_scroll_module_set_played_time (struct OlDisplayModule *module,
                                               guint64 played_time);
 static void ol_scroll_module_set_lrc (struct OlDisplayModule *module,
                                       OlLrc *lrc);
+static gint ol_scroll_module_get_next_frame_delay (struct OlDisplayModule *module,
+                                                   guint64 played_time);
 
 static void ol_scroll_module_set_message (struct OlDisplayModule *module,
                                           const char *message);
@@ -88,6 +100,9 @@ static void ol_scroll_module_clear_message (struct OlDisplayModule *module);
 static gboolean _window_configure_cb (GtkWidget *widget,
                                       GdkEventConfigure *event,
                                       gpointer userdata);
+static gboolean _window_state_cb (GtkWidget *widget,
+                                  GdkEventWindowState *event,
+                                  gpointer userdata);
 static void _set_metadata_as_text (OlScrollModule *module);
 static GtkWidget* _toolbar_new (OlScrollModule *module);
 static gboolean _close_clicked_cb (GtkButton *button,
@@ -136,6 +151,12 @@ static void _opacity_changed_cb (OlConfigProxy *config,
 static void _scroll_mode_changed_cb (OlConfigProxy *config,
                                      const char *key,
                                      OlScrollModule *module);
+static void _tiled_changed_cb (OlConfigProxy *config,
+                               const char *key,
+                               OlScrollModule *module);
+static void _tile_budget_changed_cb (OlConfigProxy *config,
+                                     const char *key,
+                                     OlScrollModule *module);
 
 static struct _ConfigMapping _config_mapping[] = {
   { "ScrollMode/width", _size_changed_cb },
@@ -148,6 +169,8 @@ static struct _ConfigMapping _config_mapping[] = {
   { "ScrollMode/bg-color", _bg_color_changed_cb },
   { "ScrollMode/opacity", _opacity_changed_cb },
   { "ScrollMode/scroll-mode", _scroll_mode_changed_cb },
+  { "ScrollMode/tiled-rendering", _tiled_changed_cb },
+  { "ScrollMode/tile-budget", _tile_budget_changed_cb },
 };
 static gboolean _config_is_setting = FALSE;
 
@@ -186,6 +209,15 @@ _scroll_cb (OlScrollWindow *osd,
 }
 
 
+static gboolean
+_commit_config_cb (OlScrollModule *module)
+{
+  module->config_commit_source = 0;
+  ol_config_batch_commit (module->config_batch);
+  module->config_batch = NULL;
+  return FALSE;
+}
+
 static gboolean
 _window_configure_cb (GtkWidget *widget,
                       GdkEventConfigure *event,
@@ -199,17 +231,41 @@ _window_configure_cb (GtkWidget *widget,
     return FALSE;
   _config_is_setting = TRUE;
   gint width, height, x, y;
-  OlConfigProxy *config = ol_config_proxy_get_instance ();
   gtk_window_get_size (GTK_WINDOW (widget), &width, &height);
   gtk_window_get_position (GTK_WINDOW (widget), &x, &y);
-  ol_config_proxy_set_int (config, "ScrollMode/width", width);
-  ol_config_proxy_set_int (config, "ScrollMode/height", height);
-  ol_config_proxy_set_int (config, "ScrollMode/x", x);
-  ol_config_proxy_set_int (config, "ScrollMode/y", y);
+  if (module->config_batch == NULL)
+  {
+    module->config_batch = ol_config_batch_new (ol_config_proxy_get_instance ());
+    module->config_commit_source = g_timeout_add (CONFIG_COMMIT_INTERVAL_MS,
+                                                  (GSourceFunc) _commit_config_cb,
+                                                  module);
+  }
+  ol_config_batch_set_int (module->config_batch, "ScrollMode/width", width);
+  ol_config_batch_set_int (module->config_batch, "ScrollMode/height", height);
+  ol_config_batch_set_int (module->config_batch, "ScrollMode/x", x);
+  ol_config_batch_set_int (module->config_batch, "ScrollMode/y", y);
   _config_is_setting = FALSE;
   return FALSE;
 }
 
+static gboolean
+_window_state_cb (GtkWidget *widget,
+                  GdkEventWindowState *event,
+                  gpointer user_data)
+{
+  OlScrollModule *module = (OlScrollModule*) user_data;
+  if (module == NULL)
+    return FALSE;
+  if (event->changed_mask & GDK_WINDOW_STATE_ICONIFIED)
+  {
+    module->iconified =
+      (event->new_window_state & GDK_WINDOW_STATE_ICONIFIED) != 0;
+    if (!module->iconified)
+      ol_display_module_request_frame (module->display_module);
+  }
+  return FALSE;
+}
+
 static void _seek_cb (OlScrollWindow *scroll,
                       guint id,
                       gdouble percentage,
@@ -347,10 +403,29 @@ _scroll_mode_changed_cb (OlConfigProxy *config,
       mode = OL_SCROLL_WINDOW_BY_LINES;
     }
     ol_scroll_window_set_scroll_mode (module->scroll, mode);
+    ol_display_module_request_frame (module->display_module);
     g_free (scroll_mode);
   }
 }
 
+static void
+_tiled_changed_cb (OlConfigProxy *config,
+                   const char *key,
+                   OlScrollModule *module)
+{
+  ol_scroll_window_set_tiled (module->scroll,
+                              ol_config_proxy_get_bool (config, key));
+}
+
+static void
+_tile_budget_changed_cb (OlConfigProxy *config,
+                         const char *key,
+                         OlScrollModule *module)
+{
+  ol_scroll_window_set_tile_budget (module->scroll,
+                                    ol_config_proxy_get_int (config, key));
+}
+
 static gboolean
 _close_clicked_cb (GtkButton *button,
                    gpointer userdata)
@@ -446,6 +521,9 @@ ol_scroll_module_init_scroll (OlScrollModule *module)
   g_signal_connect (module->scroll, "configure-event",
                     G_CALLBACK (_window_configure_cb),
                     module);
+  g_signal_connect (module->scroll, "window-state-event",
+                    G_CALLBACK (_window_state_cb),
+                    module);
   g_signal_connect (module->scroll, "button-release-event",
                     G_CALLBACK (_button_release_cb),
                     module);
@@ -465,11 +543,15 @@ ol_scroll_module_new (struct OlDisplayModule *module,
 {
   OlScrollModule *priv = g_new (OlScrollModule, 1);
   g_object_ref (player);
+  priv->display_module = module;
   priv->player = player;
+  priv->iconified = FALSE;
   priv->scroll = NULL;
   priv->lrc = NULL;
   priv->metadata = ol_metadata_new ();
   priv->config_bindings = NULL;
+  priv->config_batch = NULL;
+  priv->config_commit_source = 0;
   ol_scroll_module_init_scroll (priv);
   g_signal_connect (player,
                     "track-changed",
@@ -501,6 +583,11 @@ ol_scroll_module_free (struct OlDisplayModule *module)
   }
   if (priv->message_timer > 0)
     g_source_remove (priv->message_timer);
+  if (priv->config_commit_source > 0)
+  {
+    g_source_remove (priv->config_commit_source);
+    _commit_config_cb (priv);
+  }
   if (priv->player != NULL)
   {
     g_signal_handlers_disconnect_by_func (priv->player,
@@ -617,13 +704,42 @@ ol_scroll_module_set_played_time (struct OlDisplayModule *module,
   ol_assert (priv != NULL);
   if (priv->lrc != NULL && priv->scroll != NULL)
   {
-    OlLrcIter *iter = ol_lrc_iter_from_timestamp (priv->lrc,
-                                                  played_time);
+    ol_lrc_cursor_seek (&priv->cursor, played_time);
     ol_scroll_window_set_progress (priv->scroll,
-                                   ol_lrc_iter_get_id (iter),
-                                   ol_lrc_iter_compute_percentage (iter, played_time));
-    ol_lrc_iter_free (iter);
+                                   ol_lrc_cursor_get_id (&priv->cursor),
+                                   ol_lrc_cursor_compute_percentage (&priv->cursor,
+                                                                     played_time));
+  }
+}
+
+static gint
+ol_scroll_module_get_next_frame_delay (struct OlDisplayModule *module,
+                                       guint64 played_time)
+{
+  ol_assert_ret (module != NULL, -1);
+  OlScrollModule *priv = ol_display_module_get_data (module);
+  ol_assert_ret (priv != NULL, -1);
+  if (priv->lrc == NULL || priv->scroll == NULL || priv->iconified ||
+      !gtk_widget_get_visible (GTK_WIDGET (priv->scroll)))
+    return -1;
+  ol_lrc_cursor_seek (&priv->cursor, played_time);
+  gint64 time = played_time;
+  gint64 start = ol_lrc_cursor_get_timestamp (&priv->cursor);
+  guint64 duration = ol_lrc_cursor_get_duration (&priv->cursor);
+  gint64 end = start + duration;
+  gint delay = -1;
+  if (time < start)
+  {
+    /* Before the first line */
+    delay = start - time;
+  }
+  else if (time < end)
+  {
+    delay = ol_scroll_window_get_frame_delay (priv->scroll, duration);
+    if (delay < 0 || delay > end - time)
+      delay = end - time;
   }
+  return delay;
 }
 
 void
@@ -638,6 +754,7 @@ ol_scroll_module_set_lrc (struct OlDisplayModule *module,
   if (priv->lrc != NULL)
     g_object_unref (priv->lrc);
   priv->lrc = lrc;
+  ol_lrc_cursor_init (&priv->cursor, lrc);
   if (priv->lrc == NULL)
     ol_scroll_window_set_whole_lyrics(priv->scroll, NULL);
   else
@@ -712,6 +829,7 @@ ol_scroll_module_get_class ()
   klass->set_lrc = ol_scroll_module_set_lrc;
   /* klass->set_message = ol_scroll_module_set_message; */
   klass->set_played_time = ol_scroll_module_set_played_time;
+  klass->get_next_frame_delay = ol_scroll_module_get_next_frame_delay;
   /* klass->set_player = ol_scroll_module_set_player; */
   /* klass->set_status = ol_scroll_module_set_status; */
   return klass;
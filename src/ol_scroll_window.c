@@ -45,6 +45,10 @@ static const gint DEFAULT_PADDING_Y = 5;
 static const gint DEFAULT_CORNER_RADIUS = 10;
 static const gint DEFAULT_FRAME_WIDTH = 7;
 static const double DEFAULT_BG_OPACITY = 0.9;
+static const gint TILE_HEIGHT = 512;
+static const guint DEFAULT_TILE_BUDGET = 8;
+/* The part of a line's duration spent on scrolling in BY_LINES mode */
+static const double BY_LINES_SCROLL_PERCENTAGE = 0.15;
 static const gchar *TOOLTIP_WITH_SEEK = N_ ("Drag to move the window\nHold CTRL to seek");
 static const gchar *TOOLTIP_WITHOUT_SEEK = N_ ("Drag to move the window");
 /**********************************************/
@@ -75,6 +79,29 @@ struct __OlScrollWindowPrivate
   gint saved_seek_offset;
   gint saved_pointer_y;
   gint current_pointer_y;
+  /* Layout cache, built once per lyrics, font and width */
+  PangoContext *pango_context;
+  gint font_height;                /* -1 if not computed */
+  GPtrArray *layouts;              /* PangoLayout of each lyric line */
+  gint *line_offsets;              /* prefix sums of line heights */
+  gint layout_width;
+  /* Tiled rendering: the lyrics are pre-rendered into alpha-only tiles of
+     TILE_HEIGHT pixels high, which are then painted with the line colors */
+  gboolean tiled;
+  guint tile_budget;
+  guint frame_tile_budget;         /* tile_budget, or more if the window
+                                      needs more tiles in the current frame */
+  GPtrArray *tiles;                /* struct _OlScrollTile */
+  guint64 tile_clock;
+  guint prefetch_source;
+  gint prefetch_index;
+};
+
+struct _OlScrollTile
+{
+  gint index;                      /* covers [index, index + 1) * TILE_HEIGHT */
+  cairo_surface_t *surface;
+  guint64 last_used;
 };
 
 enum {
@@ -86,6 +113,25 @@ static guint _signals[LAST_SIGNAL] = {0};
 
 static cairo_t* _get_cairo (OlScrollWindow *scroll, GtkWidget *widget);
 static PangoLayout* _get_pango (OlScrollWindow *scroll, cairo_t *cr);
+static PangoContext* _get_pango_context (OlScrollWindow *scroll);
+static void _invalidate_layouts (OlScrollWindow *scroll);
+static void _ensure_layouts (OlScrollWindow *scroll, gint width);
+static gint _get_line_offset (OlScrollWindow *scroll, gint id);
+static gint _find_first_visible_line (OlScrollWindow *scroll, gint offset);
+static void _tile_free (struct _OlScrollTile *tile);
+static void _clear_tiles (OlScrollWindow *scroll);
+static void _trim_tiles (OlScrollWindow *scroll, guint budget);
+static cairo_surface_t* _get_tile (OlScrollWindow *scroll, gint index);
+static void _mask_tiles (OlScrollWindow *scroll,
+                         cairo_t *cr,
+                         gint top,
+                         gint height);
+static gboolean _prefetch_tile_cb (gpointer userdata);
+static void _paint_lyrics_tiled (OlScrollWindow *scroll,
+                                 cairo_t *cr,
+                                 gint top,
+                                 gint width,
+                                 gint height);
 static void _paint_bg (OlScrollWindow *scroll, cairo_t *cr);
 static void _paint_lyrics (OlScrollWindow *scroll, cairo_t *cr);
 static void _paint_text (OlScrollWindow *scroll, cairo_t *cr);
@@ -101,7 +147,6 @@ static gboolean ol_scroll_window_expose (GtkWidget *widget,
                                          GdkEventExpose *event,
                                          gpointer userdata);
 
-static int ol_scroll_window_compute_line_count (OlScrollWindow *scroll);
 static int ol_scroll_window_get_font_height (OlScrollWindow *scroll);
 
 static PangoLayout* _get_pango (OlScrollWindow *scroll, cairo_t *cr);
@@ -164,6 +209,18 @@ ol_scroll_window_init (OlScrollWindow *self)
     priv->scroll_mode = OL_SCROLL_WINDOW_ALWAYS;
     priv->can_seek = FALSE;
     priv->seeking = FALSE;
+    priv->pango_context = NULL;
+    priv->font_height = -1;
+    priv->layouts = NULL;
+    priv->line_offsets = NULL;
+    priv->layout_width = -1;
+    priv->tiled = FALSE;
+    priv->tile_budget = DEFAULT_TILE_BUDGET;
+    priv->frame_tile_budget = DEFAULT_TILE_BUDGET;
+    priv->tiles = g_ptr_array_new_with_free_func ((GDestroyNotify) _tile_free);
+    priv->tile_clock = 0;
+    priv->prefetch_source = 0;
+    priv->prefetch_index = -1;
     /*set allocation*/
     gtk_window_resize(GTK_WINDOW(self), DEFAULT_WIDTH, DEFAULT_HEIGHT);
     gtk_widget_add_events (GTK_WIDGET (self),
@@ -273,6 +330,17 @@ ol_scroll_window_destroy (GtkObject *object)
     g_free (priv->font_name);
   if (priv->text != NULL)
     g_free (priv->text);
+  _invalidate_layouts (scroll);
+  if (priv->tiles != NULL)
+  {
+    g_ptr_array_free (priv->tiles, TRUE);
+    priv->tiles = NULL;
+  }
+  if (priv->pango_context != NULL)
+  {
+    g_object_unref (priv->pango_context);
+    priv->pango_context = NULL;
+  }
   if (scroll->current_lyric_id!= -1)
   {
     scroll->current_lyric_id = -1;
@@ -309,6 +377,7 @@ ol_scroll_window_set_whole_lyrics (OlScrollWindow *scroll,
   if (scroll->whole_lyrics != NULL)
     g_ptr_array_unref (scroll->whole_lyrics);
   scroll->whole_lyrics = whole_lyrics;
+  _invalidate_layouts (scroll);
   if (whole_lyrics != NULL)
   {
     g_ptr_array_ref (whole_lyrics);
@@ -339,6 +408,349 @@ _get_pango (OlScrollWindow *scroll, cairo_t *cr)
   return layout;
 }
 
+static PangoContext*
+_get_pango_context (OlScrollWindow *scroll)
+{
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  if (priv->pango_context == NULL)
+  {
+    priv->pango_context = gdk_pango_context_get ();
+    PangoFontDescription *desc = pango_font_description_from_string (priv->font_name);
+    pango_context_set_font_description (priv->pango_context, desc);
+    pango_font_description_free (desc);
+  }
+  return priv->pango_context;
+}
+
+static void
+_invalidate_layouts (OlScrollWindow *scroll)
+{
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  if (priv->layouts != NULL)
+  {
+    g_ptr_array_free (priv->layouts, TRUE);
+    priv->layouts = NULL;
+  }
+  g_free (priv->line_offsets);
+  priv->line_offsets = NULL;
+  priv->layout_width = -1;
+  _clear_tiles (scroll);
+}
+
+/**
+ * Lays out every lyric line for the given width, and computes the offset of
+ * each line from the top of the first one.
+ */
+static void
+_ensure_layouts (OlScrollWindow *scroll, gint width)
+{
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  if (scroll->whole_lyrics == NULL)
+    return;
+  if (priv->layouts != NULL && priv->layout_width == width)
+    return;
+  _invalidate_layouts (scroll);
+  PangoContext *context = _get_pango_context (scroll);
+  int font_height = ol_scroll_window_get_font_height (scroll);
+  int line_height = font_height + priv->line_margin;
+  guint count = scroll->whole_lyrics->len;
+  guint i;
+  priv->layouts = g_ptr_array_new_with_free_func (g_object_unref);
+  priv->line_offsets = g_new (gint, count + 1);
+  priv->line_offsets[0] = 0;
+  for (i = 0; i < count; i++)
+  {
+    PangoLayout *layout = pango_layout_new (context);
+    pango_layout_set_alignment (layout, PANGO_ALIGN_LEFT);
+    pango_layout_set_width (layout, width * PANGO_SCALE);
+    pango_layout_set_indent (layout, -20 * PANGO_SCALE);
+    pango_layout_set_text (layout,
+                           g_ptr_array_index (scroll->whole_lyrics, i),
+                           -1);
+    g_ptr_array_add (priv->layouts, layout);
+    priv->line_offsets[i + 1] = priv->line_offsets[i] + line_height;
+    /* There is more than one line, offset according to the number of
+       additional lines */
+    if (pango_layout_is_wrapped (layout))
+      priv->line_offsets[i + 1] += (pango_layout_get_line_count (layout) - 1)
+        * font_height;
+  }
+  priv->layout_width = width;
+}
+
+/**
+ * Gets the offset of the top of a line from the top of the first line. Lines
+ * out of the lyrics are assumed to be one line high.
+ */
+static gint
+_get_line_offset (OlScrollWindow *scroll, gint id)
+{
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  gint count = priv->layouts->len;
+  gint line_height = ol_scroll_window_get_font_height (scroll) + priv->line_margin;
+  if (id < 0)
+    return id * line_height;
+  if (id > count)
+    return priv->line_offsets[count] + (id - count) * line_height;
+  return priv->line_offsets[id];
+}
+
+/**
+ * Finds the first line whose bottom is below the given offset.
+ */
+static gint
+_find_first_visible_line (OlScrollWindow *scroll, gint offset)
+{
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  gint low = 0;
+  gint high = priv->layouts->len;
+  while (low < high)
+  {
+    gint mid = (low + high) / 2;
+    if (priv->line_offsets[mid + 1] > offset)
+      high = mid;
+    else
+      low = mid + 1;
+  }
+  return low;
+}
+
+static void
+_tile_free (struct _OlScrollTile *tile)
+{
+  cairo_surface_destroy (tile->surface);
+  g_free (tile);
+}
+
+static void
+_clear_tiles (OlScrollWindow *scroll)
+{
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  if (priv->prefetch_source != 0)
+  {
+    g_source_remove (priv->prefetch_source);
+    priv->prefetch_source = 0;
+  }
+  if (priv->tiles != NULL)
+    g_ptr_array_set_size (priv->tiles, 0);
+}
+
+/**
+ * Frees the least recently used tiles until at most budget tiles are left.
+ */
+static void
+_trim_tiles (OlScrollWindow *scroll, guint budget)
+{
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  while (priv->tiles->len > budget)
+  {
+    guint oldest = 0;
+    guint i;
+    for (i = 1; i < priv->tiles->len; i++)
+    {
+      struct _OlScrollTile *tile = g_ptr_array_index (priv->tiles, i);
+      struct _OlScrollTile *oldest_tile = g_ptr_array_index (priv->tiles, oldest);
+      if (tile->last_used < oldest_tile->last_used)
+        oldest = i;
+    }
+    g_ptr_array_remove_index_fast (priv->tiles, oldest);
+  }
+}
+
+/**
+ * Gets the tile of the given index, rendering it if it is not cached.
+ *
+ * When the tile budget is used up, the least recently used tile is recycled.
+ *
+ * @return The tile, or NULL if there are no lyrics in it.
+ */
+static cairo_surface_t*
+_get_tile (OlScrollWindow *scroll, gint index)
+{
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  gint count = priv->layouts->len;
+  if (index < 0 || index * TILE_HEIGHT >= priv->line_offsets[count] ||
+      priv->layout_width <= 0)
+    return NULL;
+  struct _OlScrollTile *tile = NULL;
+  guint i;
+  priv->tile_clock++;
+  for (i = 0; i < priv->tiles->len; i++)
+  {
+    struct _OlScrollTile *candidate = g_ptr_array_index (priv->tiles, i);
+    if (candidate->index == index)
+    {
+      candidate->last_used = priv->tile_clock;
+      return candidate->surface;
+    }
+    if (tile == NULL || candidate->last_used < tile->last_used)
+      tile = candidate;
+  }
+  cairo_t *cr;
+  if (priv->tiles->len < priv->frame_tile_budget)
+  {
+    tile = g_new (struct _OlScrollTile, 1);
+    tile->surface = cairo_image_surface_create (CAIRO_FORMAT_A8,
+                                                priv->layout_width,
+                                                TILE_HEIGHT);
+    g_ptr_array_add (priv->tiles, tile);
+    cr = cairo_create (tile->surface);
+  }
+  else
+  {
+    cr = cairo_create (tile->surface);
+    cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint (cr);
+    cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+  }
+  tile->index = index;
+  tile->last_used = priv->tile_clock;
+  gint top = index * TILE_HEIGHT;
+  for (i = _find_first_visible_line (scroll, top);
+       i < count && priv->line_offsets[i] < top + TILE_HEIGHT;
+       i++)
+  {
+    cairo_move_to (cr, 0, priv->line_offsets[i] - top);
+    pango_cairo_show_layout (cr, g_ptr_array_index (priv->layouts, i));
+  }
+  cairo_destroy (cr);
+  return tile->surface;
+}
+
+/**
+ * Paints the tiles covering the window with the current source, using the
+ * tiles as the mask.
+ *
+ * @param top The offset from the top of the first line to the top of the
+ *            window.
+ * @param height The height of the window.
+ */
+static void
+_mask_tiles (OlScrollWindow *scroll,
+             cairo_t *cr,
+             gint top,
+             gint height)
+{
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  gint first = top >= 0 ? top / TILE_HEIGHT : -1;
+  gint last = (top + height - 1) / TILE_HEIGHT;
+  gint index;
+  for (index = MAX (first, 0); index <= last; index++)
+  {
+    cairo_surface_t *tile = _get_tile (scroll, index);
+    if (tile != NULL)
+      cairo_mask_surface (cr, tile,
+                          priv->padding_x,
+                          index * TILE_HEIGHT - top);
+  }
+}
+
+static gboolean
+_prefetch_tile_cb (gpointer userdata)
+{
+  OlScrollWindow *scroll = OL_SCROLL_WINDOW (userdata);
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  priv->prefetch_source = 0;
+  if (priv->layouts != NULL)
+    _get_tile (scroll, priv->prefetch_index);
+  return FALSE;
+}
+
+static void
+_paint_lyrics_tiled (OlScrollWindow *scroll,
+                     cairo_t *cr,
+                     gint top,
+                     gint width,
+                     gint height)
+{
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  int line_height = ol_scroll_window_get_font_height (scroll) + priv->line_margin;
+  gint count = priv->layouts->len;
+  /* Keep the visible tiles and the next one in the budget of this frame.
+     The configured budget applies again once the window gets smaller. */
+  guint min_budget = height / TILE_HEIGHT + 3;
+  priv->frame_tile_budget = MAX (priv->tile_budget, min_budget);
+  _trim_tiles (scroll, priv->frame_tile_budget);
+  /* Lines being highlighted are painted with their own color */
+  gint current_lyric_id;
+  _calc_paint_pos (scroll, &current_lyric_id, NULL);
+  gint active[2] = { current_lyric_id, current_lyric_id + 1 };
+  double ratios[2];
+  int i;
+  cairo_push_group (cr);
+  cairo_save (cr);
+  cairo_new_path (cr);
+  cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+  cairo_rectangle (cr, 0, 0, width, height);
+  for (i = 0; i < G_N_ELEMENTS (active); i++)
+  {
+    ratios[i] = 0.0;
+    if (active[i] < 0 || active[i] >= count)
+      continue;
+    ratios[i] = _get_active_color_ratio (scroll, active[i]);
+    if (ratios[i] > 0.0)
+      cairo_rectangle (cr,
+                       0, priv->line_offsets[active[i]] - top,
+                       width,
+                       priv->line_offsets[active[i] + 1] - priv->line_offsets[active[i]]);
+  }
+  cairo_clip (cr);
+  cairo_set_source_rgb (cr,
+                        priv->inactive_color.r,
+                        priv->inactive_color.g,
+                        priv->inactive_color.b);
+  _mask_tiles (scroll, cr, top, height);
+  cairo_restore (cr);
+  for (i = 0; i < G_N_ELEMENTS (active); i++)
+  {
+    if (ratios[i] <= 0.0)
+      continue;
+    double ratio = ratios[i];
+    cairo_save (cr);
+    cairo_rectangle (cr,
+                     0, priv->line_offsets[active[i]] - top,
+                     width,
+                     priv->line_offsets[active[i] + 1] - priv->line_offsets[active[i]]);
+    cairo_clip (cr);
+    cairo_set_source_rgb (cr,
+                          priv->active_color.r * ratio +
+                          priv->inactive_color.r * (1 - ratio),
+                          priv->active_color.g * ratio +
+                          priv->inactive_color.g * (1 - ratio),
+                          priv->active_color.b * ratio +
+                          priv->inactive_color.b * (1 - ratio));
+    _mask_tiles (scroll, cr, top, height);
+    cairo_restore (cr);
+  }
+  cairo_pop_group_to_source (cr);
+  /* Fade out the lines near the top and bottom edges. The stops are where
+     the middle of a line gets the alpha _paint_lyrics gives the line. */
+  cairo_pattern_t *fade = cairo_pattern_create_linear (0, 0, 0, height);
+  double stops[4][2] = {
+    { priv->padding_y + line_height / 2.0, 0.0 },
+    { priv->padding_y + line_height, 1.0 },
+    { height - priv->padding_y - line_height, 1.0 },
+    { height - priv->padding_y - line_height / 2.0, 0.0 },
+  };
+  for (i = 0; i < G_N_ELEMENTS (stops); i++)
+    cairo_pattern_add_color_stop_rgba (fade,
+                                       CLAMP (stops[i][0] / height, 0.0, 1.0),
+                                       0, 0, 0, stops[i][1]);
+  cairo_mask (cr, fade);
+  cairo_pattern_destroy (fade);
+  /* Render the tile the lyrics are scrolling into while idle */
+  gint next = (top + height) / TILE_HEIGHT + 1;
+  if (next * TILE_HEIGHT < priv->line_offsets[count] &&
+      priv->prefetch_source == 0)
+  {
+    priv->prefetch_index = next;
+    priv->prefetch_source = g_idle_add_full (G_PRIORITY_LOW,
+                                             _prefetch_tile_cb,
+                                             scroll,
+                                             NULL);
+  }
+}
+
 static cairo_t*
 _get_cairo (OlScrollWindow *scroll, GtkWidget *widget)
 {
@@ -435,8 +847,8 @@ _calc_lrc_ypos (OlScrollWindow *scroll, double percentage)
   line_height = ol_scroll_window_get_font_height (scroll) + priv->line_margin;
   if (priv->scroll_mode == OL_SCROLL_WINDOW_BY_LINES)
   {
-    if (percentage < 0.15)
-      percentage = percentage / 0.15;
+    if (percentage < BY_LINES_SCROLL_PERCENTAGE)
+      percentage = percentage / BY_LINES_SCROLL_PERCENTAGE;
     else
       percentage = 1;
   }
@@ -495,16 +907,12 @@ _paint_lyrics (OlScrollWindow *scroll, cairo_t *cr)
   ol_assert (gtk_widget_get_realized (widget));
   OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
   int line_height = ol_scroll_window_get_font_height (scroll) + priv->line_margin;
-  int count = ol_scroll_window_compute_line_count (scroll);
   gint width, height;
   gdk_drawable_get_size (gtk_widget_get_window (GTK_WIDGET (scroll)),
                          &width, &height);
 
-  /* set the font */
-  PangoLayout *layout = _get_pango (scroll, cr);
-  pango_layout_set_alignment (layout, PANGO_ALIGN_LEFT);
-  pango_layout_set_width (layout, (width - priv->padding_x*2) * PANGO_SCALE);
-  pango_layout_set_indent (layout, -20 * PANGO_SCALE);
+  _ensure_layouts (scroll, width - priv->padding_x * 2);
+  pango_cairo_update_context (cr, _get_pango_context (scroll));
   /* paint the lyrics*/
   cairo_save (cr);
   cairo_new_path (cr);
@@ -520,52 +928,42 @@ _paint_lyrics (OlScrollWindow *scroll, cairo_t *cr)
   _calc_paint_pos (scroll,
                    &current_lyric_id,
                    &lrc_y);
-  int begin = current_lyric_id - count / 2;
-  int end = current_lyric_id + count / 2 + 1;
-  int ypos = height / 2  - lrc_y - (count / 2 + 1) * line_height;
-  cairo_set_source_rgb(cr,
-                       priv->inactive_color.r,
-                       priv->inactive_color.g,
-                       priv->inactive_color.b);
-  if (scroll->whole_lyrics != NULL) {
-    for (i = begin; i < end; i++) {
-      ypos += line_height;
-      if (i < 0) continue;
-      if (i >= scroll->whole_lyrics->len)
-        break;
-      pango_layout_set_text (layout,
-                             g_ptr_array_index (scroll->whole_lyrics, i),
-                             -1);
-      cairo_save (cr);
-      double ratio = _get_active_color_ratio (scroll, i);
-      double alpha = 1.0;
-      if (ypos < line_height / 2.0 + priv->padding_y)
-        alpha = 1.0 - (line_height / 2.0 + priv->padding_y - ypos) * 1.0 / line_height * 2;
-      else if (ypos > height - line_height * 1.5 - priv->padding_y)
-        alpha = (height - line_height - priv->padding_y - ypos) * 1.0 / line_height * 2;
-      if (alpha < 0.0) alpha = 0.0;
-      cairo_set_source_rgba (cr,
-                             priv->active_color.r * ratio +
-                             priv->inactive_color.r * (1 - ratio),
-                             priv->active_color.g * ratio +
-                             priv->inactive_color.g * (1 - ratio),
-                             priv->active_color.b * ratio +
-                             priv->inactive_color.b * (1 - ratio),
-                             alpha);
-      cairo_move_to (cr, priv->padding_x, ypos);
-      pango_cairo_update_layout (cr, layout);
-      pango_cairo_show_layout (cr, layout);
-      cairo_restore (cr);
-
-      if (pango_layout_is_wrapped (layout)) {
-        // There is more than one line, offset ypos according to the number of
-        // additional lines
-        ypos += (pango_layout_get_line_count (layout) - 1)
-                * ol_scroll_window_get_font_height (scroll);
-      }
-    }
+  /* The offset from the top of the first line to the top of the window */
+  gint top = _get_line_offset (scroll, current_lyric_id) - (height / 2 - lrc_y);
+  gint count = priv->layouts->len;
+  if (priv->tiled)
+  {
+    _paint_lyrics_tiled (scroll, cr, top, width, height);
+    cairo_reset_clip (cr);
+    cairo_restore (cr);
+    return;
+  }
+  for (i = _find_first_visible_line (scroll, top); i < count; i++)
+  {
+    int ypos = priv->line_offsets[i] - top;
+    if (ypos >= height)
+      break;
+    PangoLayout *layout = g_ptr_array_index (priv->layouts, i);
+    cairo_save (cr);
+    double ratio = _get_active_color_ratio (scroll, i);
+    double alpha = 1.0;
+    if (ypos < line_height / 2.0 + priv->padding_y)
+      alpha = 1.0 - (line_height / 2.0 + priv->padding_y - ypos) * 1.0 / line_height * 2;
+    else if (ypos > height - line_height * 1.5 - priv->padding_y)
+      alpha = (height - line_height - priv->padding_y - ypos) * 1.0 / line_height * 2;
+    if (alpha < 0.0) alpha = 0.0;
+    cairo_set_source_rgba (cr,
+                           priv->active_color.r * ratio +
+                           priv->inactive_color.r * (1 - ratio),
+                           priv->active_color.g * ratio +
+                           priv->inactive_color.g * (1 - ratio),
+                           priv->active_color.b * ratio +
+                           priv->inactive_color.b * (1 - ratio),
+                           alpha);
+    cairo_move_to (cr, priv->padding_x, ypos);
+    pango_cairo_show_layout (cr, layout);
+    cairo_restore (cr);
   }
-  g_object_unref (layout);
   cairo_reset_clip (cr);
   cairo_restore (cr);
 }
@@ -619,6 +1017,29 @@ ol_scroll_window_set_progress (OlScrollWindow *scroll,
     gtk_widget_queue_draw (GTK_WIDGET (scroll));
 }
 
+gint
+ol_scroll_window_get_frame_delay (OlScrollWindow *scroll,
+                                  guint64 duration)
+{
+  ol_assert_ret (OL_IS_SCROLL_WINDOW (scroll), -1);
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  if (!gtk_widget_get_realized (GTK_WIDGET (scroll)) ||
+      scroll->current_lyric_id < 0 ||
+      scroll->percentage >= 1.0)
+    return -1;
+  gint line_height = ol_scroll_window_get_font_height (scroll) + priv->line_margin;
+  if (line_height <= 0)
+    return -1;
+  gdouble scroll_part = 1.0;
+  if (priv->scroll_mode == OL_SCROLL_WINDOW_BY_LINES)
+  {
+    if (scroll->percentage >= BY_LINES_SCROLL_PERCENTAGE)
+      return -1;
+    scroll_part = BY_LINES_SCROLL_PERCENTAGE;
+  }
+  return MAX (1, (gint) (duration * scroll_part / line_height));
+}
+
 void
 ol_scroll_window_set_text (OlScrollWindow *scroll,
                            const char *text)
@@ -631,31 +1052,17 @@ ol_scroll_window_set_text (OlScrollWindow *scroll,
   gtk_widget_queue_draw (GTK_WIDGET (scroll));
 }
 
-static int
-ol_scroll_window_compute_line_count (OlScrollWindow *scroll)
-{
-  ol_assert_ret (OL_IS_SCROLL_WINDOW (scroll), 0);
-  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
-  int font_height = ol_scroll_window_get_font_height (scroll) + priv->line_margin;
-  gint width, height;
-  gtk_window_get_size (GTK_WINDOW (scroll), &width, &height);
-  int line_count = height - priv->padding_y * 2 / font_height;
-  return line_count;
-}
-
 static int
 ol_scroll_window_get_font_height (OlScrollWindow *scroll)
 {
   ol_assert_ret (OL_IS_SCROLL_WINDOW (scroll), 0);
   OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  if (priv->font_height >= 0)
+    return priv->font_height;
 
-  PangoContext *pango_context = gdk_pango_context_get ();
-  PangoLayout *pango_layout = pango_layout_new (pango_context);
-  PangoFontDescription *font_desc = pango_font_description_from_string (priv->font_name);
-  pango_layout_set_font_description (pango_layout, font_desc);
-
+  PangoContext *pango_context = _get_pango_context (scroll);
   PangoFontMetrics *metrics = pango_context_get_metrics (pango_context,
-                                                         pango_layout_get_font_description (pango_layout), /* font desc */
+                                                         pango_context_get_font_description (pango_context), /* font desc */
                                                          NULL); /* languague */
   int height = 0;
   int ascent, descent;
@@ -664,9 +1071,7 @@ ol_scroll_window_get_font_height (OlScrollWindow *scroll)
   pango_font_metrics_unref (metrics);
 
   height += PANGO_PIXELS (ascent + descent);
-  pango_font_description_free (font_desc);
-  g_object_unref (pango_layout);
-  g_object_unref (pango_context);
+  priv->font_height = height;
   return height;
 }
 
@@ -687,6 +1092,13 @@ ol_scroll_window_set_font_name (OlScrollWindow *scroll,
   if (priv->font_name != NULL)
     g_free (priv->font_name);
   priv->font_name = g_strdup (font_name);
+  if (priv->pango_context != NULL)
+  {
+    g_object_unref (priv->pango_context);
+    priv->pango_context = NULL;
+  }
+  priv->font_height = -1;
+  _invalidate_layouts (scroll);
   gtk_widget_queue_draw (GTK_WIDGET (scroll));
 }
 
@@ -1004,6 +1416,40 @@ ol_scroll_window_set_scroll_mode (OlScrollWindow *scroll,
   gtk_widget_queue_draw (GTK_WIDGET (scroll));
 }
 
+void
+ol_scroll_window_set_tiled (OlScrollWindow *scroll,
+                            gboolean tiled)
+{
+  ol_assert (OL_IS_SCROLL_WINDOW (scroll));
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  if (priv->tiled == tiled)
+    return;
+  priv->tiled = tiled;
+  if (!tiled)
+    _clear_tiles (scroll);
+  gtk_widget_queue_draw (GTK_WIDGET (scroll));
+}
+
+gboolean
+ol_scroll_window_get_tiled (OlScrollWindow *scroll)
+{
+  ol_assert_ret (OL_IS_SCROLL_WINDOW (scroll), FALSE);
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  return priv->tiled;
+}
+
+void
+ol_scroll_window_set_tile_budget (OlScrollWindow *scroll,
+                                  guint tile_count)
+{
+  ol_assert (OL_IS_SCROLL_WINDOW (scroll));
+  OlScrollWindowPrivate *priv = OL_SCROLL_WINDOW_GET_PRIVATE (scroll);
+  priv->tile_budget = tile_count;
+  priv->frame_tile_budget = tile_count;
+  _clear_tiles (scroll);
+  gtk_widget_queue_draw (GTK_WIDGET (scroll));
+}
+
 enum OlScrollWindowScrollMode
 ol_scroll_window_get_scroll_mode (OlScrollWindow *scroll)
 {
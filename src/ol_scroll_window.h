@@ -85,6 +85,18 @@ void ol_scroll_window_set_progress (OlScrollWindow *scroll,
                                     int lyric_id,
                                     double percentage);
 
+/**
+ * @brief Gets how long the lyrics stay at the same position
+ *
+ * @param scroll An OlScrollWindow
+ * @param duration The duration of the current lyric line in milliseconds
+ *
+ * @return The milliseconds until the lyrics scroll by one pixel from the
+ *         progress set by ol_scroll_window_set_progress, or -1 if they
+ *         don't move until the next line.
+ */
+gint ol_scroll_window_get_frame_delay (OlScrollWindow *scroll,
+                                       guint64 duration);
 
 /**
  * @brief Gets the current line number
@@ -155,6 +167,34 @@ void ol_scroll_window_set_scroll_mode (OlScrollWindow *scroll,
 
 enum OlScrollWindowScrollMode ol_scroll_window_get_scroll_mode (OlScrollWindow *scroll);
 
+/**
+ * @brief Sets whether to pre-render the lyrics into tiles
+ *
+ * In tiled mode, the lyrics are rendered once into a vertical strip of
+ * alpha-only tiles, and each frame only paints the visible tiles with the
+ * colors of the lines, instead of showing every visible layout.
+ *
+ * @param scroll An OlScrollWindow
+ * @param tiled Whether to use tiled rendering
+ */
+void ol_scroll_window_set_tiled (OlScrollWindow *scroll,
+                                 gboolean tiled);
+
+gboolean ol_scroll_window_get_tiled (OlScrollWindow *scroll);
+
+/**
+ * @brief Sets the maximum number of tiles kept in tiled mode
+ *
+ * If the window needs more tiles than it to be painted, the tiles it needs
+ * are kept while it is that large, and the budget applies again once the
+ * window gets smaller.
+ *
+ * @param scroll An OlScrollWindow
+ * @param tile_count The number of tiles
+ */
+void ol_scroll_window_set_tile_budget (OlScrollWindow *scroll,
+                                       guint tile_count);
+
 void ol_scroll_window_set_can_seek (OlScrollWindow *scroll,
                                     gboolean can_seek);
 
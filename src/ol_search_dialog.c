@@ -64,6 +64,10 @@ static void ol_search_dialog_search_started_cb (OlLyricSourceSearchTask *task,
                                                 const gchar *sourceid,
                                                 const gchar *sourcename,
                                                 gpointer userdata);
+static void ol_search_dialog_search_partial_results_cb (OlLyricSourceSearchTask *task,
+                                                        const gchar *sourceid,
+                                                        GList *results,
+                                                        gpointer userdata);
 static void ol_search_dialog_download_complete_cb (OlLyricSourceDownloadTask *task,
                                                    enum OlLyricSourceStatus status,
                                                    const gchar *content,
@@ -129,6 +133,7 @@ ol_search_dialog_search_click (GtkWidget *widget,
                             FALSE);
   gtk_widget_set_sensitive (widgets.download,
                             FALSE);
+  ol_lyric_candidate_list_clear (widgets.list);
   GList *sourceids = ol_lyric_source_list_get_active_id_list (GTK_TREE_VIEW(widgets.engine));
   search_task = ol_lyric_source_search (ol_app_get_lyric_source (),
                                         metadata,
@@ -141,6 +146,10 @@ ol_search_dialog_search_click (GtkWidget *widget,
                     "started",
                     G_CALLBACK (ol_search_dialog_search_started_cb),
                     NULL);
+  g_signal_connect (search_task,
+                    "partial-results",
+                    G_CALLBACK (ol_search_dialog_search_partial_results_cb),
+                    NULL);
   for (; sourceids; sourceids = g_list_delete_link (sourceids, sourceids))
   {
     g_free (sourceids->data);
@@ -162,6 +171,31 @@ ol_search_dialog_search_started_cb (OlLyricSourceSearchTask *task,
   }
 }
 
+static void
+ol_search_dialog_search_partial_results_cb (OlLyricSourceSearchTask *task,
+                                            const gchar *sourceid,
+                                            GList *results,
+                                            gpointer userdata)
+{
+  if (task != search_task)
+    return;
+  /* Show the results found so far, which are replaced with the ranked
+     results of all sources once the search completes */
+  gtk_widget_set_sensitive (GTK_WIDGET (widgets.list),
+                            TRUE);
+  ol_lyric_candidate_list_append_list (widgets.list,
+                                       results);
+  gtk_widget_show (widgets.candidates_panel);
+  if (widgets.msg != NULL)
+  {
+    GtkTreeModel *model = gtk_tree_view_get_model (widgets.list);
+    char *msg = g_strdup_printf (_(MSG_FOUND),
+                                 gtk_tree_model_iter_n_children (model, NULL));
+    gtk_label_set_text (widgets.msg, msg);
+    g_free (msg);
+  }
+}
+
 static void
 ol_search_dialog_search_complete_cb (OlLyricSourceSearchTask *task,
                                      enum OlLyricSourceStatus status,
@@ -18,11 +18,19 @@
  * along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>. 
  */
 
+#include <math.h>
 #include "ol_timeline.h"
-#include <stdlib.h>
-#include <sys/time.h>
 #include "ol_debug.h"
 
+/* The timeline is locked to the reported player position with a small
+ * phase-locked loop: small errors are absorbed by running the clock slightly
+ * faster or slower for a while, and the residual error between two reports is
+ * fed into a frequency correction. Only large errors snap the time. */
+static const double MAX_SLEW = 0.05;        /* fraction of the playback rate */
+static const gint64 SLEW_WINDOW = 2000;     /* ms to absorb an error in */
+static const double MAX_DRIFT = 0.01;       /* fraction of the playback rate */
+static const double DRIFT_GAIN = 0.1;
+
 enum OlTimelineStatus {
   OL_TIMELINE_PLAYING,
   OL_TIMELINE_PAUSED,
@@ -31,17 +39,64 @@ enum OlTimelineStatus {
 
 struct _OlTimeline
 {
-  int cached_time;
-  struct timeval cached_time_begin;
+  double anchor_time;           /* time at anchor_clock, in ms */
+  gint64 anchor_clock;          /* monotonic clock, in us */
+  double rate;
+  double drift;
+  double slew;
+  gint64 slew_duration;         /* in us, counted from anchor_clock */
+  gint64 last_sync_clock;       /* 0 if no report since the last snap */
+  gint64 error;
   enum OlTimelineStatus status;
   int accuracy;
+  OlTimelineClockFunc clock;
+  gpointer clock_data;
 };
 
+static gint64
+ol_timeline_clock (OlTimeline *timeline)
+{
+  if (timeline->clock != NULL)
+    return timeline->clock (timeline->clock_data);
+  return g_get_monotonic_time ();
+}
+
+static double
+ol_timeline_get_time_at (OlTimeline *timeline,
+                         gint64 clock)
+{
+  if (timeline->status != OL_TIMELINE_PLAYING)
+    return timeline->anchor_time;
+  gint64 elapsed = MAX (clock - timeline->anchor_clock, 0);
+  double advance = elapsed * timeline->rate * (1.0 + timeline->drift) +
+    MIN (elapsed, timeline->slew_duration) * timeline->slew;
+  return timeline->anchor_time + advance / 1000.0;
+}
+
+/* Rounds a time to milliseconds, so that floating point errors don't drop a
+ * millisecond */
+static gint64
+ol_timeline_round (double time_in_ms)
+{
+  return (gint64) floor (time_in_ms + 0.5);
+}
+
+static void
+ol_timeline_anchor (OlTimeline *timeline,
+                    double time_in_ms,
+                    gint64 clock)
+{
+  timeline->anchor_time = time_in_ms;
+  timeline->anchor_clock = clock;
+  timeline->slew = 0.0;
+  timeline->slew_duration = 0;
+}
+
 OlTimeline *
 ol_timeline_new (void)
 {
-  OlTimeline *timeline = g_new (OlTimeline, 1);
-  timeline->cached_time = 0;
+  OlTimeline *timeline = g_new0 (OlTimeline, 1);
+  timeline->rate = 1.0;
   timeline->status = OL_TIMELINE_STOPPED;
   timeline->accuracy = 1000;
   return timeline;
@@ -53,6 +108,16 @@ ol_timeline_free (OlTimeline *timeline)
   g_free (timeline);
 }
 
+void
+ol_timeline_set_clock (OlTimeline *timeline,
+                       OlTimelineClockFunc clock,
+                       gpointer userdata)
+{
+  ol_assert (timeline != NULL);
+  timeline->clock = clock;
+  timeline->clock_data = userdata;
+}
+
 void
 ol_timeline_play (OlTimeline *timeline)
 {
@@ -60,7 +125,10 @@ ol_timeline_play (OlTimeline *timeline)
   if (timeline->status == OL_TIMELINE_PLAYING)
     return;
   timeline->status = OL_TIMELINE_PLAYING;
-  gettimeofday (&timeline->cached_time_begin, NULL);
+  timeline->last_sync_clock = 0;
+  ol_timeline_anchor (timeline,
+                      timeline->anchor_time,
+                      ol_timeline_clock (timeline));
 }
 
 void
@@ -69,8 +137,9 @@ ol_timeline_pause (OlTimeline *timeline)
   ol_assert (timeline != NULL);
   if (timeline->status == OL_TIMELINE_PAUSED)
     return;
-  if (timeline->status == OL_TIMELINE_PLAYING)
-    timeline->cached_time = ol_timeline_get_time (timeline);
+  ol_timeline_anchor (timeline,
+                      ol_timeline_get_time_at (timeline, ol_timeline_clock (timeline)),
+                      0);
   timeline->status = OL_TIMELINE_PAUSED;
 }
 
@@ -78,20 +147,49 @@ void
 ol_timeline_stop (OlTimeline *timeline)
 {
   ol_assert (timeline != NULL);
-  timeline->cached_time = 0;
+  ol_timeline_anchor (timeline, 0.0, 0);
   timeline->status = OL_TIMELINE_STOPPED;
 }
 
-void
+gboolean
 ol_timeline_maybe_set_time (OlTimeline *timeline,
                             gint64 time_in_ms)
 {
-  ol_assert (timeline != NULL);
-  gint64 current_time = ol_timeline_get_time (timeline);
-  if (abs (current_time - time_in_ms) > timeline->accuracy)
+  ol_assert_ret (timeline != NULL, FALSE);
+  if (timeline->status == OL_TIMELINE_STOPPED)
+    return FALSE;
+  gint64 clock = ol_timeline_clock (timeline);
+  double current_time = ol_timeline_get_time_at (timeline, clock);
+  gint64 error = time_in_ms - ol_timeline_round (current_time);
+  timeline->error = error;
+  if (timeline->status != OL_TIMELINE_PLAYING ||
+      ABS (error) > timeline->accuracy ||
+      timeline->rate <= 0.0)
   {
+    if (error == 0)
+      return FALSE;
     ol_timeline_set_time (timeline, time_in_ms);
+    return TRUE;
   }
+  if (timeline->last_sync_clock > 0 && clock > timeline->last_sync_clock)
+  {
+    /* Whatever error is left since the previous report is mostly caused by
+     * the clocks running at different speeds */
+    double drift = timeline->drift +
+      DRIFT_GAIN * error * 1000.0 / (clock - timeline->last_sync_clock);
+    timeline->drift = CLAMP (drift, -MAX_DRIFT, MAX_DRIFT);
+  }
+  timeline->last_sync_clock = clock;
+  ol_timeline_anchor (timeline, current_time, clock);
+  if (error != 0)
+  {
+    double max_slew = MAX_SLEW * timeline->rate;
+    timeline->slew = CLAMP ((double) error / SLEW_WINDOW, -max_slew, max_slew);
+    timeline->slew_duration = error * 1000.0 / timeline->slew;
+  }
+  ol_debugf ("Timeline error: %" G_GINT64_FORMAT "ms, drift: %lf\n",
+             error, timeline->drift);
+  return FALSE;
 }
 
 void
@@ -101,27 +199,47 @@ ol_timeline_set_time (OlTimeline *timeline,
   ol_assert (timeline != NULL);
   if (timeline->status == OL_TIMELINE_STOPPED)
     return;
-  timeline->cached_time = time_in_ms;
-  gettimeofday (&timeline->cached_time_begin, NULL);
+  timeline->last_sync_clock = 0;
+  ol_timeline_anchor (timeline, time_in_ms, ol_timeline_clock (timeline));
 }
 
 gint64
 ol_timeline_get_time (OlTimeline *timeline)
 {
   ol_assert_ret (timeline != NULL, 0);
-  if (timeline->status == OL_TIMELINE_PLAYING)
-  {
-    struct timeval current_time;
-    gettimeofday (&current_time, NULL);
-    gint64 time = timeline->cached_time +
-      (current_time.tv_sec - timeline->cached_time_begin.tv_sec) * 1000 +
-      (current_time.tv_usec - timeline->cached_time_begin.tv_usec) / 1000;
-    return time;
-  }
-  else
-  {
-    return timeline->cached_time;
-  }
+  return ol_timeline_round (ol_timeline_get_time_at (timeline,
+                                                     ol_timeline_clock (timeline)));
+}
+
+void
+ol_timeline_set_rate (OlTimeline *timeline,
+                      gdouble rate)
+{
+  ol_assert (timeline != NULL);
+  if (rate < 0.0)
+    rate = 0.0;
+  if (rate == timeline->rate)
+    return;
+  gint64 clock = ol_timeline_clock (timeline);
+  ol_timeline_anchor (timeline,
+                      ol_timeline_get_time_at (timeline, clock),
+                      clock);
+  timeline->rate = rate;
+  timeline->last_sync_clock = 0;
+}
+
+gdouble
+ol_timeline_get_rate (OlTimeline *timeline)
+{
+  ol_assert_ret (timeline != NULL, 1.0);
+  return timeline->rate;
+}
+
+gint64
+ol_timeline_get_error (OlTimeline *timeline)
+{
+  ol_assert_ret (timeline != NULL, 0);
+  return timeline->error;
 }
 
 void
@@ -24,6 +24,15 @@
 
 typedef struct _OlTimeline OlTimeline;
 
+/**
+ * The clock a timeline runs with.
+ *
+ * @param userdata The userdata passed to ol_timeline_set_clock().
+ *
+ * @return The monotonic time of the clock, in microseconds.
+ */
+typedef gint64 (*OlTimelineClockFunc) (gpointer userdata);
+
 /** 
  * Create a new timeline.
  * 
@@ -39,10 +48,24 @@ OlTimeline *ol_timeline_new (void);
  */
 void ol_timeline_free (OlTimeline *timeline);
 
+/** 
+ * Set the clock of a timeline.
+ *
+ * The clock should be set before the timeline plays. It is intended for tests
+ * to drive the time of a timeline without sleeping.
+ * @param timeline A timeline.
+ * @param clock The clock, or NULL to use g_get_monotonic_time().
+ * @param userdata The data passed to clock.
+ */
+void ol_timeline_set_clock (OlTimeline *timeline,
+                            OlTimelineClockFunc clock,
+                            gpointer userdata);
+
 /** 
  * Change status of a timeline to playing.
  *
- * The time of the timeline will keep increasing.
+ * The time of the timeline will keep increasing, based on the monotonic
+ * clock of the system, or the clock set by ol_timeline_set_clock().
  * @param timeline A timeline.
  */
 void ol_timeline_play (OlTimeline *timeline);
@@ -64,20 +87,24 @@ void ol_timeline_pause (OlTimeline *timeline);
 void ol_timeline_stop (OlTimeline *timeline);
 
 /** 
- * Set time of a timeline if neccessary.
+ * Synchronize a timeline with a reported time.
  *
  * If the difference between time of the timeline and the specified time is greater
- * than accuracy of the timeline, the time will be set. Otherwise the time will not
- * change.
+ * than accuracy of the timeline, the time will be set. Otherwise the timeline
+ * keeps running smoothly and runs slightly faster or slower until the error is
+ * absorbed. The error left between two reports is used to correct the speed
+ * of the timeline.
  *
- * It is suggestted to use this function if the precesion of time_in_ms is greater
- * than milliseconds.
+ * It is suggestted to use this function for periodic position reports, and
+ * ol_timeline_set_time() for seeks.
  * 
  * @param timeline A timeline.
  * @param time_in_ms The time to set, in milliseconds.
+ *
+ * @return TRUE if the time jumped to time_in_ms.
  */
-void ol_timeline_maybe_set_time (OlTimeline *timeline,
-                                 gint64 time_in_ms);
+gboolean ol_timeline_maybe_set_time (OlTimeline *timeline,
+                                     gint64 time_in_ms);
 
 /** 
  * Set time of a timeline.
@@ -97,10 +124,39 @@ void ol_timeline_set_time (OlTimeline *timeline,
  */
 gint64 ol_timeline_get_time (OlTimeline *timeline);
 
+/** 
+ * Set the playback rate of a timeline.
+ *
+ * @param timeline A timeline.
+ * @param rate The playback rate, 1.0 for normal speed. Negative values are
+ *             treated as 0.
+ */
+void ol_timeline_set_rate (OlTimeline *timeline,
+                           gdouble rate);
+
+/** 
+ * Get the playback rate of a timeline.
+ * 
+ * @param timeline A timeline.
+ * 
+ * @return The playback rate.
+ */
+gdouble ol_timeline_get_rate (OlTimeline *timeline);
+
+/** 
+ * Get the error measured by the last call of ol_timeline_maybe_set_time().
+ * 
+ * @param timeline A timeline.
+ * 
+ * @return The reported time minus the time of the timeline, in milliseconds.
+ */
+gint64 ol_timeline_get_error (OlTimeline *timeline);
+
 /** 
  * Set accuracy of a timeline.
  *
- * Accuracy only affects ol_timeline_maybe_set_time().
+ * Accuracy only affects ol_timeline_maybe_set_time(). Errors greater than
+ * the accuracy are treated as discontinuities and make the time jump.
  * @param timeline 
  * @param accuracy 
  */
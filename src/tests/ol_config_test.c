@@ -35,7 +35,12 @@ test_basic_value ()
   printf ("%s\n", __FUNCTION__);
   OlConfigProxy *config = ol_config_proxy_get_instance ();
   assert (config != NULL);
+  guint hits, misses;
   ol_test_expect (ol_config_proxy_get_int (config, "Test/default_int") == 0);
+  /* The get that loads the values calls the config daemon */
+  ol_config_proxy_get_cache_stats (config, &hits, &misses);
+  ol_test_expect (hits == 0);
+  ol_test_expect (misses == 1);
   ol_test_expect (ol_config_proxy_set_int (config, "Test/default_int", 42) == TRUE);
   ol_test_expect (ol_config_proxy_get_int (config, "Test/default_int") == 42);
   
@@ -81,6 +86,106 @@ test_set_value ()
   /* g_strfreev (ol_config_proxy_get_str_list (config, "OSD", "active-lrc-color", NULL)); */
 }
 
+void
+test_cached_value ()
+{
+  printf ("%s\n", __FUNCTION__);
+  OlConfigProxy *config = ol_config_proxy_get_instance ();
+  const char *colors[] = {"#123456", "a;b", "c\\d", NULL};
+  /* Setting values updates the cache, and the next get gets the new value */
+  ol_test_expect (ol_config_proxy_set_int (config, "Test/cached_int", 1) == TRUE);
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/cached_int") == 1);
+  ol_test_expect (ol_config_proxy_set_int (config, "Test/cached_int", 2) == TRUE);
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/cached_int") == 2);
+  ol_test_expect (ol_config_proxy_set_double (config, "Test/cached_double", 0.75) == TRUE);
+  ol_test_expect (ol_config_proxy_get_double (config, "Test/cached_double") == 0.75);
+  ol_test_expect (ol_config_proxy_set_bool (config, "Test/cached_bool", TRUE) == TRUE);
+  ol_test_expect (ol_config_proxy_get_bool (config, "Test/cached_bool") == TRUE);
+  /* Option names are case insensitive */
+  ol_test_expect (ol_config_proxy_get_bool (config, "Test/Cached_Bool") == TRUE);
+  ol_test_expect (ol_config_proxy_set_str_list (config, "Test/cached_list", colors, -1) == TRUE);
+  gsize len = 0;
+  gchar **list = ol_config_proxy_get_str_list (config, "Test/cached_list", &len);
+  ol_test_expect (len == 3);
+  ol_test_expect_streq (list[0], colors[0]);
+  ol_test_expect_streq (list[1], colors[1]);
+  ol_test_expect_streq (list[2], colors[2]);
+  g_strfreev (list);
+  ol_test_expect (ol_config_proxy_get_str_list (config, "Test/cached_missing", NULL) == NULL);
+  /* Values of another type are invalid */
+  ol_test_expect (ol_config_proxy_set_string (config, "Test/cached_str", "abc") == TRUE);
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/cached_str") == 0);
+  /* Gets without changes are all from the cache */
+  guint hits, misses, new_hits, new_misses;
+  ol_config_proxy_get_int (config, "Test/cached_int");
+  ol_config_proxy_get_cache_stats (config, &hits, &misses);
+  ol_config_proxy_get_int (config, "Test/cached_int");
+  ol_config_proxy_get_bool (config, "Test/cached_missing");
+  ol_config_proxy_get_cache_stats (config, &new_hits, &new_misses);
+  ol_test_expect (new_hits == hits + 2);
+  ol_test_expect (new_misses == misses);
+  /* Setting a value doesn't load all the values again */
+  ol_test_expect (ol_config_proxy_set_int (config, "Test/cached_int", 3) == TRUE);
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/cached_int") == 3);
+  ol_test_expect (ol_config_proxy_get_double (config, "Test/cached_double") == 0.75);
+  ol_config_proxy_get_cache_stats (config, &hits, &misses);
+  ol_test_expect (hits == new_hits + 2);
+  ol_test_expect (misses == new_misses);
+}
+
+void
+test_transaction ()
+{
+  printf ("%s\n", __FUNCTION__);
+  OlConfigProxy *config = ol_config_proxy_get_instance ();
+  ol_test_expect (ol_config_proxy_set_int (config, "Test/transaction_x", 0) == TRUE);
+  ol_test_expect (ol_config_proxy_set_int (config, "Test/transaction_y", 0) == TRUE);
+  OlConfigBatch *batch = ol_config_batch_new (config);
+  ol_test_expect (ol_config_batch_set_int (batch, "Test/transaction_x", 1) == TRUE);
+  ol_test_expect (ol_config_batch_set_int (batch, "Test/transaction_y", 2) == TRUE);
+  /* Values set in the batch are visible before committed */
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/transaction_x") == 1);
+  /* Values set out of the batch are set immediately */
+  ol_test_expect (ol_config_proxy_set_int (config, "Test/transaction_z", 3) == TRUE);
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/transaction_z") == 3);
+  OlConfigBatch *other = ol_config_batch_new (config);
+  ol_test_expect (ol_config_batch_set_int (other, "Test/transaction_x", 4) == TRUE);
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/transaction_x") == 4);
+  ol_test_expect (ol_config_batch_commit (other) == TRUE);
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/transaction_x") == 4);
+  /* The values of a batch are not set until it is committed */
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/transaction_y") == 0);
+  ol_test_expect (ol_config_batch_commit (batch) == TRUE);
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/transaction_x") == 1);
+  ol_test_expect (ol_config_proxy_get_int (config, "Test/transaction_y") == 2);
+}
+
+static void
+benchmark_track_change ()
+{
+  /* The config values the client gets on each track change */
+  static const char *KEYS[] = {
+    "General/notify-music",
+    "Download/download-first-lyric",
+  };
+  static const int TRACK_CHANGES = 1000;
+  OlConfigProxy *config = ol_config_proxy_get_instance ();
+  guint hits, misses, new_hits, new_misses;
+  int i, j;
+  /* Make sure the values are cached, as the client does on startup */
+  ol_config_proxy_get_bool (config, KEYS[0]);
+  ol_config_proxy_get_cache_stats (config, &hits, &misses);
+  gint64 start = g_get_monotonic_time ();
+  for (i = 0; i < TRACK_CHANGES; i++)
+    for (j = 0; j < G_N_ELEMENTS (KEYS); j++)
+      ol_config_proxy_get_bool (config, KEYS[j]);
+  gint64 elapsed = MAX (g_get_monotonic_time () - start, 1);
+  ol_config_proxy_get_cache_stats (config, &new_hits, &new_misses);
+  printf ("%d track changes in %" G_GINT64_FORMAT "us: "
+          "%u D-Bus calls eliminated, %u left\n",
+          TRACK_CHANGES, elapsed, new_hits - hits, new_misses - misses);
+}
+
 static void
 init_config ()
 {
@@ -94,5 +199,8 @@ main (int argc, char **argv)
   test_singleton ();
   test_basic_value ();
   test_set_value ();
+  test_cached_value ();
+  test_transaction ();
+  benchmark_track_change ();
   return 0;
 }
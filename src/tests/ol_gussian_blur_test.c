@@ -1,19 +1,175 @@
+#include <math.h>
+#include <string.h>
 #include <cairo.h>
+#include <glib.h>
 
 #include "ol_gussian_blur.h"
+#include "ol_test_util.h"
+
+/* The straightforward column-major implementation that the blur engine
+   replaced, kept as the reference for bit-exactness. */
+static int *
+reference_calc_kernel (double sigma, int *size)
+{
+  int kernel_size = ceil (sigma * 6);
+  if (kernel_size % 2 == 0)
+    kernel_size++;
+  int orig = kernel_size / 2;
+  *size = kernel_size;
+  double *kernel_double = g_new (double, kernel_size);
+  double sum = 0.0;
+  int *kernel = g_new (int, kernel_size);
+  int i;
+  double factor = 1.0 / sqrt (2.0 * M_PI * sigma * sigma);
+  double denom = 1.0 / (2.0 * sigma * sigma);
+  for (i = 0; i < kernel_size; i++)
+  {
+    kernel_double[i] = factor * exp (- (i - orig) * (i - orig) * denom);
+    sum += kernel_double[i];
+  }
+  for (i = 0; i < kernel_size; i++)
+    kernel[i] = kernel_double[i] / sum * (1 << (sizeof (int) / 2 * 8));
+  g_free (kernel_double);
+  return kernel;
+}
 
 static void
-banchmark ()
+reference_blur (cairo_surface_t *surface, double sigma)
+{
+  static const int DIR[2][2] = {{0, 1}, {1, 0}};
+  guint32 *pixels = (guint32*) cairo_image_surface_get_data (surface);
+  int width = cairo_image_surface_get_width (surface);
+  int height = cairo_image_surface_get_height (surface);
+  int kernel_size;
+  int *kernel = reference_calc_kernel (sigma, &kernel_size);
+  int kernel_orig = kernel_size / 2;
+  int d, i, x, y, c;
+  for (d = 0; d < 2; d++)
+  {
+    guint32 *old_pixels = g_new (guint32, width * height);
+    memcpy (old_pixels, pixels, sizeof (guint32) * width * height);
+    for (x = 0; x < width; x++)
+      for (y = 0; y < height; y++)
+      {
+        guint64 value[4] = {0};
+        int sum = 0;
+        for (i = 0; i < kernel_size; i++)
+        {
+          int x1 = x + (i - kernel_orig) * DIR[d][0];
+          int y1 = y + (i - kernel_orig) * DIR[d][1];
+          if (x1 < 0 || y1 < 0 || x1 >= width || y1 >= height)
+            continue;
+          sum += kernel[i];
+          for (c = 0; c < 4; c++)
+            value[c] += ((old_pixels[y1 * width + x1] >> (c * 8)) & 0xff) *
+              (guint64) kernel[i];
+        }
+        guint32 result = 0;
+        for (c = 0; c < 4; c++)
+          result |= MIN (value[c] / sum, 0xff) << (c * 8);
+        pixels[y * width + x] = result;
+      }
+    g_free (old_pixels);
+  }
+  g_free (kernel);
+}
+
+static cairo_surface_t *
+create_random_surface (int width, int height, guint32 seed)
 {
   cairo_surface_t *img = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-                                                    1000, 1000);
-  ol_gussian_blur (img, 10);
+                                                    width, height);
+  guint32 *pixels = (guint32*) cairo_image_surface_get_data (img);
+  GRand *rand = g_rand_new_with_seed (seed);
+  int i;
+  for (i = 0; i < width * height; i++)
+  {
+    /* Keep the pixels premultiplied as cairo expects */
+    guint32 alpha = g_rand_int_range (rand, 0, 256);
+    pixels[i] = alpha << 24 |
+      g_rand_int_range (rand, 0, alpha + 1) << 16 |
+      g_rand_int_range (rand, 0, alpha + 1) << 8 |
+      g_rand_int_range (rand, 0, alpha + 1);
+  }
+  g_rand_free (rand);
+  return img;
+}
+
+static gboolean
+surface_equal (cairo_surface_t *a, cairo_surface_t *b)
+{
+  int size = cairo_image_surface_get_stride (a) *
+    cairo_image_surface_get_height (a);
+  return memcmp (cairo_image_surface_get_data (a),
+                 cairo_image_surface_get_data (b),
+                 size) == 0;
+}
+
+static void
+test_bit_exact (void)
+{
+  static const enum OlBlurImpl IMPLS[] = {
+    OL_BLUR_IMPL_SCALAR,
+    OL_BLUR_IMPL_SSE2,
+    OL_BLUR_IMPL_AVX2,
+  };
+  static const int SIZES[][2] = {
+    {1, 1}, {3, 2}, {17, 5}, {64, 64}, {301, 41}, {5, 300},
+  };
+  static const double SIGMAS[] = { 0.1, 0.5, 1.0, 2.5, 10.0 };
+  int i, s, k;
+  for (i = 0; i < G_N_ELEMENTS (IMPLS); i++)
+  {
+    if (!ol_gussian_blur_set_impl (IMPLS[i]))
+    {
+      printf ("Blur implementation %d is not supported, skipped\n", IMPLS[i]);
+      continue;
+    }
+    for (s = 0; s < G_N_ELEMENTS (SIZES); s++)
+      for (k = 0; k < G_N_ELEMENTS (SIGMAS); k++)
+      {
+        cairo_surface_t *expected = create_random_surface (SIZES[s][0],
+                                                           SIZES[s][1],
+                                                           s * 31 + k);
+        cairo_surface_t *actual = create_random_surface (SIZES[s][0],
+                                                         SIZES[s][1],
+                                                         s * 31 + k);
+        reference_blur (expected, SIGMAS[k]);
+        ol_gussian_blur (actual, SIGMAS[k]);
+        ol_test_expect (surface_equal (expected, actual));
+        cairo_surface_destroy (expected);
+        cairo_surface_destroy (actual);
+      }
+  }
+  ol_gussian_blur_set_impl (OL_BLUR_IMPL_AUTO);
+}
+
+static void
+banchmark (void)
+{
+  static const int WIDTH = 2000;
+  static const int HEIGHT = 100;
+  static const double SIGMA = 3.0;
+  static const int ROUNDS = 10;
+  cairo_surface_t *img = create_random_surface (WIDTH, HEIGHT, 0);
+  int i;
+  gint64 start = g_get_monotonic_time ();
+  reference_blur (img, SIGMA);
+  gint64 reference_time = g_get_monotonic_time () - start;
+  start = g_get_monotonic_time ();
+  for (i = 0; i < ROUNDS; i++)
+    ol_gussian_blur (img, SIGMA);
+  gint64 blur_time = (g_get_monotonic_time () - start) / ROUNDS;
+  printf ("Blur %dx%d with sigma %.1lf: reference %" G_GINT64_FORMAT
+          "us, current %" G_GINT64_FORMAT "us\n",
+          WIDTH, HEIGHT, SIGMA, reference_time, blur_time);
   cairo_surface_destroy (img);
 }
 
 int
 main ()
 {
+  test_bit_exact ();
   banchmark ();
   return 0;
 }
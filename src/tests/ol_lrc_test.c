@@ -0,0 +1,491 @@
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "ol_lrc.h"
+#include "ol_test_util.h"
+
+#ifdef __GLIBC__
+/* Count heap allocations to make sure following the playing line doesn't
+   allocate memory. */
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static guint alloc_count = 0;
+
+void *
+malloc (size_t size)
+{
+  alloc_count++;
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+  alloc_count++;
+  return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  alloc_count++;
+  return __libc_realloc (ptr, size);
+}
+#endif
+
+static const gint64 LINE_DURATION = 3000;
+
+static GVariant *
+create_content (guint count)
+{
+  GVariantBuilder builder;
+  guint i;
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+  for (i = 0; i < count; i++)
+  {
+    /* Every third line is empty, and some lines share the same timestamp */
+    g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (&builder, "{sv}", "id", g_variant_new_uint32 (i));
+    g_variant_builder_add (&builder, "{sv}", "timestamp",
+                           g_variant_new_int64 ((i - i % 5 / 4) * LINE_DURATION));
+    g_variant_builder_add (&builder, "{sv}", "text",
+                           g_variant_new_string (i % 3 == 2 ? "" : "lyric"));
+    g_variant_builder_close (&builder);
+  }
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static OlLrc *
+create_lrc (guint count)
+{
+  GVariant *content = create_content (count);
+  OlLrc *lrc = ol_lrc_new (NULL, "file:///tmp/test.lrc");
+  ol_lrc_set_content_from_variant (lrc, content);
+  g_variant_unref (content);
+  return lrc;
+}
+
+static OlLrc *
+parse_fixture (const char *name, const char *charset)
+{
+  gchar *path = g_build_filename (TEST_DATA_DIR, name, NULL);
+  gchar *content = NULL;
+  gsize len = 0;
+  OlLrc *lrc = NULL;
+  if (g_file_get_contents (path, &content, &len, NULL))
+  {
+    lrc = ol_lrc_new (NULL, "file:///tmp/test.lrc");
+    ol_test_expect (ol_lrc_set_content_from_raw (lrc, content, len, charset));
+  }
+  else
+  {
+    printf ("ERROR: cannot read %s\n", path);
+  }
+  g_free (content);
+  g_free (path);
+  return lrc;
+}
+
+static void
+expect_line (OlLrc *lrc, guint id, gint64 timestamp, const char *text)
+{
+  OlLrcCursor cursor;
+  ol_lrc_cursor_init (&cursor, lrc);
+  ol_test_expect (ol_lrc_cursor_move_to (&cursor, id));
+  ol_test_expect (ol_lrc_cursor_get_timestamp (&cursor) == timestamp);
+  ol_test_expect_streq (ol_lrc_cursor_get_text (&cursor), text);
+}
+
+static gint
+iter_seek_nonempty (OlLrc *lrc, gint64 timestamp)
+{
+  OlLrcIter *iter = ol_lrc_iter_from_timestamp (lrc, timestamp);
+  gint id = -1;
+  for (; ol_lrc_iter_is_valid (iter); ol_lrc_iter_next (iter))
+  {
+    if (ol_lrc_iter_get_text (iter)[0] != '\0')
+    {
+      id = ol_lrc_iter_get_id (iter);
+      break;
+    }
+  }
+  ol_lrc_iter_free (iter);
+  return id;
+}
+
+static void
+check_cursor (OlLrc *lrc, OlLrcCursor *cursor, gint64 timestamp)
+{
+  OlLrcIter *iter = ol_lrc_iter_from_timestamp (lrc, timestamp);
+  ol_lrc_cursor_seek (cursor, timestamp);
+  ol_test_expect (ol_lrc_cursor_get_id (cursor) == ol_lrc_iter_get_id (iter));
+  ol_test_expect (ol_lrc_cursor_get_timestamp (cursor) ==
+                  ol_lrc_iter_get_timestamp (iter));
+  ol_test_expect (ol_lrc_cursor_get_duration (cursor) ==
+                  ol_lrc_iter_get_duration (iter));
+  ol_test_expect (ol_lrc_cursor_compute_percentage (cursor, timestamp) ==
+                  ol_lrc_iter_compute_percentage (iter, timestamp));
+  ol_lrc_iter_free (iter);
+  gint id = iter_seek_nonempty (lrc, timestamp);
+  ol_test_expect (ol_lrc_cursor_seek_nonempty (cursor, timestamp) == (id >= 0));
+  if (id >= 0)
+    ol_test_expect (ol_lrc_cursor_get_id (cursor) == id);
+}
+
+static void
+test_cursor (void)
+{
+  static const guint COUNT = 50;
+  OlLrc *lrc = create_lrc (COUNT);
+  OlLrcCursor cursor;
+  gint64 time;
+  gint i;
+  ol_lrc_cursor_init (&cursor, lrc);
+  for (time = -1000; time < COUNT * LINE_DURATION + 5000; time += 250)
+    check_cursor (lrc, &cursor, time);
+  for (time = COUNT * LINE_DURATION; time > -1000; time -= 700)
+    check_cursor (lrc, &cursor, time);
+  GRand *rand = g_rand_new_with_seed (0);
+  for (i = 0; i < 1000; i++)
+    check_cursor (lrc, &cursor,
+                  g_rand_int_range (rand, -1000, COUNT * LINE_DURATION + 5000));
+  g_rand_free (rand);
+  /* The cursor follows the changes of offset */
+  ol_lrc_set_offset (lrc, 1234);
+  for (time = -1000; time < COUNT * LINE_DURATION; time += 300)
+    check_cursor (lrc, &cursor, time);
+  g_object_unref (lrc);
+}
+
+/* Checks the line and percentage shown at played_time, as the OSD does */
+static void
+expect_position (OlLrcCursor *cursor,
+                 gint64 played_time,
+                 guint id,
+                 gdouble percentage)
+{
+  ol_test_expect (ol_lrc_cursor_seek_nonempty (cursor, played_time));
+  ol_test_expect (ol_lrc_cursor_get_id (cursor) == id);
+  ol_test_expect (ol_lrc_cursor_compute_percentage (cursor, played_time) ==
+                  percentage);
+}
+
+static void
+test_offset (void)
+{
+  OlLrc *lrc = create_lrc (10);
+  OlLrcCursor cursor;
+  ol_lrc_cursor_init (&cursor, lrc);
+  expect_position (&cursor, 1500, 0, 0.5);
+  /* A new offset applies to the same played time right away */
+  ol_lrc_set_offset (lrc, 750);
+  ol_test_expect (ol_lrc_get_offset (lrc) == 750);
+  expect_position (&cursor, 1500, 0, 0.75);
+  ol_lrc_set_offset (lrc, 2250);
+  expect_position (&cursor, 1500, 1, 0.25);
+  ol_lrc_set_offset (lrc, -750);
+  expect_position (&cursor, 1500, 0, 0.25);
+  g_object_unref (lrc);
+}
+
+static void
+test_cursor_gap (void)
+{
+  /* One lyric line, a gap of empty lines, then another lyric line */
+  static const guint GAP = 10;
+  GVariantBuilder builder;
+  guint i;
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+  for (i = 0; i <= GAP + 1; i++)
+  {
+    g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (&builder, "{sv}", "id", g_variant_new_uint32 (i));
+    g_variant_builder_add (&builder, "{sv}", "timestamp",
+                           g_variant_new_int64 (i * 1000));
+    g_variant_builder_add (&builder, "{sv}", "text",
+                           g_variant_new_string (i == 0 || i == GAP + 1 ?
+                                                 "lyric" : ""));
+    g_variant_builder_close (&builder);
+  }
+  GVariant *content = g_variant_ref_sink (g_variant_builder_end (&builder));
+  OlLrc *lrc = ol_lrc_new (NULL, "file:///tmp/test.lrc");
+  ol_lrc_set_content_from_variant (lrc, content);
+  g_variant_unref (content);
+  OlLrcCursor cursor;
+  gint64 time;
+  ol_lrc_cursor_init (&cursor, lrc);
+  /* Following the playback frame by frame across the gap, the cursor keeps
+     the line that fits the timestamp to start the next seek from. So each
+     seek only checks that line and the next one, without searching. */
+  for (time = 0; time < (GAP + 2) * 1000; time += 16)
+  {
+    ol_test_expect (ol_lrc_cursor_seek_nonempty (&cursor, time));
+    ol_test_expect (ol_lrc_cursor_get_id (&cursor) ==
+                    (time < 1000 ? 0 : GAP + 1));
+    ol_test_expect (cursor.seek_id == time / 1000);
+  }
+  g_object_unref (lrc);
+}
+
+static void
+test_next_nonempty (void)
+{
+  OlLrc *lrc = create_lrc (6);
+  ol_test_expect (ol_lrc_get_next_nonempty_id (lrc, 0) == 0);
+  ol_test_expect (ol_lrc_get_next_nonempty_id (lrc, 2) == 3);
+  ol_test_expect (ol_lrc_get_next_nonempty_id (lrc, 5) == -1);
+  ol_test_expect (ol_lrc_get_next_nonempty_id (lrc, 6) == -1);
+  g_object_unref (lrc);
+}
+
+static void
+test_load (void)
+{
+  static const guint COUNT = 2000;
+  GVariant *content = create_content (COUNT);
+  OlLrc *lrc = ol_lrc_new (NULL, "file:///tmp/test.lrc");
+  OlLrcCursor cursor;
+  guint i;
+#ifdef __GLIBC__
+  guint allocs = alloc_count;
+#endif
+  ol_lrc_set_content_from_variant (lrc, content);
+#ifdef __GLIBC__
+  allocs = alloc_count - allocs;
+  printf ("Load %u lines with %u heap allocations\n", COUNT, allocs);
+  /* The content is not serialized, so reading it doesn't allocate */
+  ol_test_expect (allocs < 10);
+#endif
+  ol_test_expect (ol_lrc_get_item_count (lrc) == COUNT);
+  ol_lrc_cursor_init (&cursor, lrc);
+  for (i = 0; i < COUNT; i++)
+  {
+    ol_lrc_cursor_move_to (&cursor, i);
+    ol_test_expect_streq (ol_lrc_cursor_get_text (&cursor),
+                          i % 3 == 2 ? "" : "lyric");
+  }
+  /* Timestamps must not be truncated to 32 bits */
+  GVariantBuilder builder;
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (&builder, "{sv}", "id", g_variant_new_uint32 (0));
+  g_variant_builder_add (&builder, "{sv}", "timestamp",
+                         g_variant_new_int64 (G_GINT64_CONSTANT (1) << 40));
+  g_variant_builder_add (&builder, "{sv}", "text", g_variant_new_string ("a"));
+  g_variant_builder_close (&builder);
+  g_variant_unref (content);
+  content = g_variant_ref_sink (g_variant_builder_end (&builder));
+  ol_lrc_set_content_from_variant (lrc, content);
+  ol_lrc_cursor_init (&cursor, lrc);
+  ol_test_expect (ol_lrc_cursor_get_timestamp (&cursor) ==
+                  G_GINT64_CONSTANT (1) << 40);
+  g_variant_unref (content);
+  g_object_unref (lrc);
+}
+
+static void
+test_parse_basic (void)
+{
+  static const char *FIXTURES[][2] = {
+    { "lrc_basic.lrc", NULL },
+    { "lrc_gbk.lrc", "GBK" },
+  };
+  int i;
+  for (i = 0; i < G_N_ELEMENTS (FIXTURES); i++)
+  {
+    OlLrc *lrc = parse_fixture (FIXTURES[i][0], FIXTURES[i][1]);
+    if (!lrc)
+      continue;
+    ol_test_expect (ol_lrc_get_item_count (lrc) == 4);
+    expect_line (lrc, 0, 0, "Text 1");
+    expect_line (lrc, 1, 94000, "\344\270\255\346\226\207\346\255\214\350\257\215");
+    expect_line (lrc, 2, 153260, "\344\270\255\346\226\207\346\255\214\350\257\215");
+    expect_line (lrc, 3, 11045060,
+                 "\345\217\246\344\270\200\344\270\252\346\255\214\350\257\215[00:00]");
+    ol_test_expect_streq (ol_lrc_get_attribute (lrc, "attr1"), "");
+    ol_test_expect_streq (ol_lrc_get_attribute (lrc, "attr2"), "value");
+    ol_test_expect (ol_lrc_get_attribute (lrc, "attr3") == NULL);
+    g_object_unref (lrc);
+  }
+}
+
+static void
+test_parse_fixtures (void)
+{
+  OlLrc *lrc = parse_fixture ("lrc_bom.lrc", NULL);
+  if (lrc)
+  {
+    OlLrcCursor cursor;
+    ol_test_expect (ol_lrc_get_item_count (lrc) == 45);
+    ol_lrc_cursor_init (&cursor, lrc);
+    ol_test_expect (ol_lrc_cursor_get_timestamp (&cursor) == 17200);
+    /* CRLF is not a part of the text */
+    const char *text = ol_lrc_cursor_get_text (&cursor);
+    ol_test_expect (strchr (text, '\r') == NULL);
+    g_object_unref (lrc);
+  }
+  lrc = parse_fixture ("lrc_no_newline.lrc", NULL);
+  if (lrc)
+  {
+    ol_test_expect (ol_lrc_get_item_count (lrc) == 1);
+    expect_line (lrc, 0, 0, "lyric");
+    g_object_unref (lrc);
+  }
+  lrc = parse_fixture ("lrc_tail.lrc", NULL);
+  if (lrc)
+  {
+    ol_test_expect (ol_lrc_get_item_count (lrc) == 3);
+    expect_line (lrc, 0, 10000, "begin");
+    expect_line (lrc, 1, 20000, "middle");
+    expect_line (lrc, 2, 30000, "end");
+    g_object_unref (lrc);
+  }
+  lrc = parse_fixture ("lrc_line_breaks.lrc", NULL);
+  if (lrc)
+  {
+    /* Lines are broken as str.splitlines() in Python does */
+    static const char *TEXTS[] = { "a", "b", "c", "d", "e", "f", "g", "h",
+                                   "i\xe2\x80\xaa" };
+    guint i;
+    ol_test_expect (ol_lrc_get_item_count (lrc) == G_N_ELEMENTS (TEXTS));
+    for (i = 0; i < G_N_ELEMENTS (TEXTS); i++)
+      expect_line (lrc, i, (i + 1) * 1000, TEXTS[i]);
+    ol_test_expect_streq (ol_lrc_get_attribute (lrc, "ti"), "breaks");
+    g_object_unref (lrc);
+  }
+  lrc = parse_fixture ("lyric_with_offset.lrc", NULL);
+  if (lrc)
+  {
+    ol_test_expect (ol_lrc_get_offset (lrc) == 100);
+    expect_line (lrc, 0, 1000 - 100, "foo");
+    g_object_unref (lrc);
+  }
+}
+
+static void
+test_parse_raw (void)
+{
+  static const char CONTENT[] =
+    "[ti:title][ar:artist]\r"
+    "[00:03.5][00:01]b\r\n"
+    "[00:02.123456]c\n"
+    "[00:01]d\n"
+    "[00:0x]invalid\n"
+    "[bad tag]invalid\n"
+    "[1:2:3:4]invalid\n"
+    "[offset:-20]";
+  OlLrc *lrc = ol_lrc_new (NULL, "file:///tmp/test.lrc");
+  ol_test_expect (ol_lrc_set_content_from_raw (lrc, CONTENT, -1, NULL));
+  ol_test_expect (ol_lrc_get_item_count (lrc) == 4);
+  expect_line (lrc, 0, 1020, "b");
+  expect_line (lrc, 1, 1020, "d");
+  expect_line (lrc, 2, 2143, "c");
+  expect_line (lrc, 3, 3520, "b");
+  ol_test_expect_streq (ol_lrc_get_attribute (lrc, "ti"), "title");
+  ol_test_expect_streq (ol_lrc_get_attribute (lrc, "ar"), "artist");
+  ol_test_expect (ol_lrc_get_offset (lrc) == -20);
+  /* Empty content results in one empty line */
+  ol_test_expect (ol_lrc_set_content_from_raw (lrc, "", 0, NULL));
+  ol_test_expect (ol_lrc_get_item_count (lrc) == 1);
+  ol_test_expect (ol_lrc_get_offset (lrc) == 0);
+  expect_line (lrc, 0, 0, "");
+  g_object_unref (lrc);
+}
+
+static void
+benchmark_parse (void)
+{
+  static const char *FIXTURES[] = {
+    "lrc_basic.lrc", "lrc_bom.lrc", "lyrics1.lrc", "lyric2.lrc",
+    "lyric3.lrc", "lyric4.lrc",
+  };
+  static const int ROUNDS = 200;
+  GString *content = g_string_new (NULL);
+  int i;
+  for (i = 0; i < G_N_ELEMENTS (FIXTURES); i++)
+  {
+    gchar *path = g_build_filename (TEST_DATA_DIR, FIXTURES[i], NULL);
+    gchar *data = NULL;
+    gsize len = 0;
+    if (g_file_get_contents (path, &data, &len, NULL))
+    {
+      g_string_append_len (content, data, len);
+      g_string_append_c (content, '\n');
+    }
+    g_free (data);
+    g_free (path);
+  }
+  OlLrc *lrc = ol_lrc_new (NULL, "file:///tmp/test.lrc");
+  gint64 start = g_get_monotonic_time ();
+  for (i = 0; i < ROUNDS; i++)
+    ol_lrc_set_content_from_raw (lrc, content->str, content->len, NULL);
+  gint64 elapsed = MAX (g_get_monotonic_time () - start, 1);
+  printf ("Parse %" G_GSIZE_FORMAT " bytes (%u lines) %d times in %"
+          G_GINT64_FORMAT "us: %.1lfMB/s\n",
+          content->len, ol_lrc_get_item_count (lrc), ROUNDS, elapsed,
+          (double) content->len * ROUNDS / elapsed);
+  g_object_unref (lrc);
+  g_string_free (content, TRUE);
+}
+
+static void
+benchmark (void)
+{
+  static const guint COUNT = 1000;
+  static const gint64 FRAME_INTERVAL = 16;
+  OlLrc *lrc = create_lrc (COUNT);
+  OlLrcCursor cursor;
+  gint64 end_time = COUNT * LINE_DURATION;
+  gint64 time;
+  guint frames = 0;
+  gdouble sum = 0.0;
+
+  gint64 start = g_get_monotonic_time ();
+  for (time = 0; time < end_time; time += FRAME_INTERVAL)
+  {
+    OlLrcIter *iter = ol_lrc_iter_from_timestamp (lrc, time);
+    sum += ol_lrc_iter_compute_percentage (iter, time);
+    ol_lrc_iter_free (iter);
+  }
+  gint64 iter_time = g_get_monotonic_time () - start;
+
+  ol_lrc_cursor_init (&cursor, lrc);
+#ifdef __GLIBC__
+  guint allocs = alloc_count;
+#endif
+  start = g_get_monotonic_time ();
+  for (time = 0; time < end_time; time += FRAME_INTERVAL)
+  {
+    if (ol_lrc_cursor_seek_nonempty (&cursor, time))
+      sum += ol_lrc_cursor_compute_percentage (&cursor, time);
+    frames++;
+  }
+  gint64 cursor_time = g_get_monotonic_time () - start;
+#ifdef __GLIBC__
+  allocs = alloc_count - allocs;
+  printf ("Cursor: %u heap allocations in %u frames\n", allocs, frames);
+  ol_test_expect (allocs == 0);
+#endif
+  printf ("Follow %u lines in %u frames: iter %" G_GINT64_FORMAT
+          "us, cursor %" G_GINT64_FORMAT "us (%lf)\n",
+          COUNT, frames, iter_time, cursor_time, sum);
+  g_object_unref (lrc);
+}
+
+int
+main ()
+{
+  test_cursor ();
+  test_offset ();
+  test_cursor_gap ();
+  test_next_nonempty ();
+  test_load ();
+  test_parse_basic ();
+  test_parse_fixtures ();
+  test_parse_raw ();
+  benchmark ();
+  benchmark_parse ();
+  return 0;
+}
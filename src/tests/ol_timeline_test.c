@@ -0,0 +1,113 @@
+#include <glib.h>
+#include "ol_timeline.h"
+#include "ol_test_util.h"
+
+/* The timelines are driven by a fake clock, so the times are exact */
+static gint64 now = 1000000;
+
+static gint64
+fake_clock (gpointer userdata)
+{
+  return *(gint64 *) userdata;
+}
+
+static OlTimeline *
+create_timeline (void)
+{
+  OlTimeline *timeline = ol_timeline_new ();
+  ol_timeline_set_clock (timeline, fake_clock, &now);
+  return timeline;
+}
+
+static void
+test_play_pause (void)
+{
+  OlTimeline *timeline = create_timeline ();
+  ol_test_expect (ol_timeline_get_time (timeline) == 0);
+  ol_timeline_set_time (timeline, 1000);
+  ol_test_expect (ol_timeline_get_time (timeline) == 0);
+  ol_timeline_play (timeline);
+  ol_timeline_set_time (timeline, 1000);
+  now += 100000;
+  ol_test_expect (ol_timeline_get_time (timeline) == 1100);
+  ol_timeline_pause (timeline);
+  now += 50000;
+  ol_test_expect (ol_timeline_get_time (timeline) == 1100);
+  ol_timeline_play (timeline);
+  now += 50000;
+  ol_test_expect (ol_timeline_get_time (timeline) == 1150);
+  ol_timeline_stop (timeline);
+  ol_test_expect (ol_timeline_get_time (timeline) == 0);
+  ol_timeline_free (timeline);
+}
+
+static void
+test_rate (void)
+{
+  OlTimeline *timeline = create_timeline ();
+  ol_timeline_play (timeline);
+  ol_timeline_set_rate (timeline, 2.0);
+  ol_timeline_set_time (timeline, 0);
+  now += 100000;
+  ol_test_expect (ol_timeline_get_time (timeline) == 200);
+  ol_timeline_set_rate (timeline, 0.0);
+  now += 50000;
+  ol_test_expect (ol_timeline_get_time (timeline) == 200);
+  ol_timeline_free (timeline);
+}
+
+static void
+test_slew (void)
+{
+  OlTimeline *timeline = create_timeline ();
+  ol_timeline_play (timeline);
+  ol_timeline_set_time (timeline, 10000);
+  /* A small error must not make the time jump */
+  ol_test_expect (!ol_timeline_maybe_set_time (timeline, 10050));
+  ol_test_expect (ol_timeline_get_error (timeline) == 50);
+  ol_test_expect (ol_timeline_get_time (timeline) == 10000);
+  /* The error is absorbed by running 2.5% faster for 2 seconds */
+  now += 200000;
+  ol_test_expect (ol_timeline_get_time (timeline) == 10205);
+  now += 1800000;
+  ol_test_expect (ol_timeline_get_time (timeline) == 12050);
+  now += 1000000;
+  ol_test_expect (ol_timeline_get_time (timeline) == 13050);
+  /* No error left, so the speed is not corrected */
+  ol_test_expect (!ol_timeline_maybe_set_time (timeline, 13050));
+  ol_test_expect (ol_timeline_get_error (timeline) == 0);
+  now += 1000000;
+  ol_test_expect (ol_timeline_get_time (timeline) == 14050);
+  /* A large error is treated as a seek */
+  ol_test_expect (ol_timeline_maybe_set_time (timeline, 30000));
+  ol_test_expect (ol_timeline_get_time (timeline) == 30000);
+  ol_timeline_free (timeline);
+}
+
+static void
+test_drift (void)
+{
+  OlTimeline *timeline = create_timeline ();
+  ol_timeline_play (timeline);
+  ol_timeline_set_time (timeline, 0);
+  ol_test_expect (!ol_timeline_maybe_set_time (timeline, 0));
+  /* The player runs 0.1% faster than the clock */
+  now += 10000000;
+  ol_test_expect (!ol_timeline_maybe_set_time (timeline, 10010));
+  ol_test_expect (ol_timeline_get_error (timeline) == 10);
+  /* The error is absorbed, and the error left between the two reports makes
+     the timeline run 0.01% faster */
+  now += 10000000;
+  ol_test_expect (ol_timeline_get_time (timeline) == 20011);
+  ol_timeline_free (timeline);
+}
+
+int
+main (int argc, char **argv)
+{
+  test_play_pause ();
+  test_rate ();
+  test_slew ();
+  test_drift ();
+  return 0;
+}
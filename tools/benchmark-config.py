@@ -0,0 +1,96 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file is part of OSD Lyrics.
+#
+# OSD Lyrics is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# OSD Lyrics is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+Benchmarks the D-Bus calls of osdlyrics.config.Config during track changes.
+
+Usage: python3 tools/benchmark-config.py [TRACK_CHANGES] [LATENCY_US]
+
+The config service is simulated in process, with each call taking LATENCY_US
+microseconds as a round-trip on the session bus does. A track change gets the
+config values the lyric source daemon gets to search and download lyrics
+from each enabled source through a manual proxy. The values are changed once
+in a while, as the OSD window is moved. The calls are counted with and
+without the cache of Config. The osdlyrics package must be importable.
+"""
+
+import sys
+import time
+
+import osdlyrics.utils
+from osdlyrics.config import Config, join
+
+from fakeconfig import FakeConfigService, FakeConnection
+
+VALUES = {
+    'Download/download-engine': join(['lrclib', 'netease', 'megalobiz',
+                                      'subtitles4songs']),
+    'Download/proxy': 'manual',
+    'Download/proxy-type': 'http',
+    'Download/proxy-host': 'localhost',
+    'Download/proxy-port': '8080',
+    'Download/proxy-username': '',
+    'Download/proxy-password': '',
+    'OSD/x': '0',
+}
+
+# Search and download through the proxy
+REQUESTS_PER_SOURCE = 2
+
+# A value changes every this many track changes
+CHANGE_INTERVAL = 10
+
+
+def track_change(config):
+    sources = config.get_string_list('Download/download-engine')
+    for _ in sources:
+        for _ in range(REQUESTS_PER_SOURCE):
+            # Bypass the cache of get_proxy_settings, which is measured by
+            # benchmark-proxy.py
+            osdlyrics.utils._resolve_proxy_settings(config)
+
+
+def measure(name, track_changes, latency, cached):
+    service = FakeConfigService(VALUES, latency)
+    config = Config(FakeConnection(service))
+    config._cache_enabled = cached
+    start = time.perf_counter()
+    for i in range(track_changes):
+        if i % CHANGE_INTERVAL == 0:
+            config.set_int('OSD/x', i)
+        track_change(config)
+    elapsed = time.perf_counter() - start
+    print('%-10s %8d calls %8.1f calls/track %10.1fus/track' % (
+        name, service.calls, service.calls / track_changes,
+        elapsed / track_changes * 1e6))
+    return service.calls
+
+
+def main():
+    track_changes = int(sys.argv[1]) if len(sys.argv) > 1 else 1000
+    latency = (float(sys.argv[2]) if len(sys.argv) > 2 else 100) / 1e6
+    print('%d track changes, %.0fus per call' % (track_changes, latency * 1e6))
+    before = measure('uncached', track_changes, latency, False)
+    after = measure('cached', track_changes, latency, True)
+    print('%d of %d calls eliminated' % (before - after, before))
+
+
+if __name__ == '__main__':
+    main()
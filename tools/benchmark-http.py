@@ -0,0 +1,146 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file is part of OSD Lyrics.
+#
+# OSD Lyrics is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# OSD Lyrics is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+Benchmarks the HTTP requests of lyric source plugins.
+
+Usage: python3 tools/benchmark-http.py [REQUESTS] [SETUP_MS] [THREADS]
+
+A local HTTP/1.1 server with keep-alive stands in for the lyric sites. It
+waits SETUP_MS milliseconds before serving each new connection, as the DNS
+lookup, TCP and TLS handshakes with a remote site take. REQUESTS requests
+are sent from THREADS threads, as the BaseTaskThread workers of a plugin do,
+with a new curl handle for each request as http_download used to, and with
+http_download, which reuses the handles and connections of its pool. The
+osdlyrics package must be importable.
+"""
+
+import http.server
+import io
+import sys
+import threading
+import time
+import urllib.parse
+
+import pycurl
+
+from osdlyrics.utils import http_download
+
+CONTENT = b'[ti:Benchmark]\n' + b'[00:01.00]lyric\n' * 100
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    disable_nagle_algorithm = True
+
+    def setup(self):
+        time.sleep(self.server.setup_delay)
+        super().setup()
+
+    def do_GET(self):
+        self.send_response(200)
+        self.send_header('Content-Type', 'text/plain')
+        self.send_header('Content-Length', str(len(CONTENT)))
+        self.end_headers()
+        self.wfile.write(CONTENT)
+
+    def do_POST(self):
+        self.rfile.read(int(self.headers.get('Content-Length', 0)))
+        self.do_GET()
+
+    def log_message(self, format, *args):
+        pass
+
+
+def legacy_http_download(url, params={}):
+    """ http_download before the pool of curl handles """
+    c = pycurl.Curl()
+    buf = io.BytesIO()
+    c.setopt(pycurl.NOSIGNAL, 1)
+    c.setopt(pycurl.DNS_USE_GLOBAL_CACHE, 0)
+    c.setopt(pycurl.FOLLOWLOCATION, 1)
+    c.setopt(pycurl.MAXREDIRS, 5)
+    c.setopt(pycurl.WRITEFUNCTION, buf.write)
+    if params:
+        url = url + '?' + urllib.parse.urlencode(params)
+    c.setopt(pycurl.URL, url)
+    c.setopt(pycurl.HTTPHEADER, ['User-Agent:OSD Lyrics'])
+    c.setopt(pycurl.PROXY, '')
+    c.perform()
+    return c.getinfo(pycurl.HTTP_CODE), buf.getvalue()
+
+
+def measure(name, download, url, requests, threads):
+    latencies = []
+    errors = []
+    lock = threading.Lock()
+
+    def worker(count):
+        try:
+            for i in range(count):
+                start = time.perf_counter()
+                code, content = download(url, params={'s': i})
+                elapsed = time.perf_counter() - start
+                if code != 200 or content != CONTENT:
+                    raise AssertionError('Unexpected response %d' % code)
+                with lock:
+                    latencies.append(elapsed)
+        except Exception as e:
+            errors.append(e)
+
+    workers = [threading.Thread(target=worker, args=(requests // threads,))
+               for _ in range(threads)]
+    start = time.perf_counter()
+    for t in workers:
+        t.start()
+    for t in workers:
+        t.join()
+    total = time.perf_counter() - start
+    if errors:
+        raise errors[0]
+    latencies.sort()
+    mean = sum(latencies) / len(latencies)
+    print('%-16s %8.2fms mean %8.2fms p95 %8.1f requests/s' % (
+        name, mean * 1000, latencies[int(len(latencies) * 0.95)] * 1000,
+        len(latencies) / total))
+    return mean
+
+
+def main():
+    requests = int(sys.argv[1]) if len(sys.argv) > 1 else 200
+    setup_ms = float(sys.argv[2]) if len(sys.argv) > 2 else 20
+    threads = int(sys.argv[3]) if len(sys.argv) > 3 else 4
+    server = http.server.ThreadingHTTPServer(('127.0.0.1', 0), Handler)
+    server.daemon_threads = True
+    server.setup_delay = setup_ms / 1000
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    url = 'http://127.0.0.1:%d/search' % server.server_address[1]
+    print('%d requests from %d threads, %.0fms to set up a connection' % (
+        requests, threads, setup_ms))
+    try:
+        before = measure('new handles', legacy_http_download, url, requests, threads)
+        after = measure('pooled', http_download, url, requests, threads)
+    finally:
+        server.shutdown()
+    print('speedup: %.1fx' % (before / after))
+
+
+if __name__ == '__main__':
+    main()
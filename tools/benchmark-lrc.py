@@ -0,0 +1,160 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file is part of OSD Lyrics.
+#
+# OSD Lyrics is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# OSD Lyrics is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+Benchmarks the LRC parser of the daemon on synthetic LRC files.
+
+Usage: python3 tools/benchmark-lrc.py [LINES] [ROUNDS]
+
+The parser is compared with the tokenizer it replaced, which is kept here as
+the baseline, and with the cost of a hit in the parsed lyrics cache of the
+daemon, which only stats the file.
+"""
+
+import importlib.util
+import os
+import os.path
+import random
+import re
+import sys
+import tempfile
+import time
+
+import dbus.types
+
+LRC_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        os.pardir, 'python', 'lrc.py')
+
+
+def load_lrc_module():
+    spec = importlib.util.spec_from_file_location('lrc', LRC_PATH)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+LEGACY_LINE_PATTERN = re.compile(r'(\[[^\[]*?\])')
+LEGACY_TIMESTAMP_PATTERN = re.compile(r'^\[(\d+(:\d+){0,2}(\.\d+)?)\]$')
+LEGACY_ATTR_PATTERN = re.compile(r'^\[([\w\d]+):(.*)\]$')
+
+
+def legacy_parse_lrc(content):
+    """ The parser before the single-pattern scanner """
+    attrs = {}
+    lyrics = []
+    for line in content.splitlines():
+        timetags = []
+        pos = 0
+        while pos < len(line) and line[pos] == '[':
+            m = LEGACY_LINE_PATTERN.search(line, pos)
+            if not m or m.start() != pos:
+                break
+            tag = m.group()
+            tm = LEGACY_TIMESTAMP_PATTERN.match(tag)
+            am = None if tm else LEGACY_ATTR_PATTERN.match(tag)
+            if tm:
+                parts = tm.group(1).split(':')
+                parts.reverse()
+                factor = 1000
+                ms = int(float(parts[0]) * factor)
+                for s in parts[1:]:
+                    factor = factor * 60
+                    ms = ms + factor * int(s)
+                timetags.append(ms)
+            elif am:
+                attrs[am.group(1)] = am.group(2)
+            else:
+                break
+            pos = m.end()
+        for timestamp in timetags:
+            lyrics.append({'timestamp': dbus.types.Int64(timestamp),
+                           'text': line[pos:]})
+    lyrics.sort(key=lambda a: a['timestamp'])
+    for i, lyric in enumerate(lyrics):
+        lyric['id'] = dbus.types.UInt32(i)
+    return attrs, lyrics
+
+
+def create_content(line_count):
+    random.seed(line_count)
+    lines = ['[ti:Benchmark]', '[ar:OSD Lyrics]', '[offset:100]']
+    for i in range(line_count):
+        ms = i * 2500
+        tag = '[%02d:%02d.%02d]' % (ms // 60000, ms // 1000 % 60, ms // 10 % 100)
+        if i % 10 == 0:
+            # Repeated lines share the same text
+            tag += '[%d:%02d:%02d.%03d]' % (ms // 3600000, ms // 60000 % 60,
+                                             ms // 1000 % 60, ms % 1000)
+        text = ' '.join(random.choice(('lyric', 'text', '歌词', 'la'))
+                        for _ in range(random.randint(0, 8)))
+        lines.append(tag + text)
+    return '\r\n'.join(lines) + '\r\n'
+
+
+def measure(name, func, rounds, size):
+    """ Reports the best time of rounds, which is the least disturbed """
+    elapsed = float('inf')
+    for _ in range(rounds):
+        start = time.perf_counter()
+        func()
+        elapsed = min(elapsed, time.perf_counter() - start)
+    print('%-24s %10.3fms %10.1fMB/s' % (name, elapsed * 1000,
+                                         size / elapsed / 1e6))
+    return elapsed
+
+
+def main():
+    line_count = int(sys.argv[1]) if len(sys.argv) > 1 else 10000
+    rounds = int(sys.argv[2]) if len(sys.argv) > 2 else 20
+    lrc = load_lrc_module()
+    content = create_content(line_count)
+    size = len(content.encode('utf-8'))
+    print('%d lines, %d bytes, %d rounds' % (line_count, size, rounds))
+
+    expected = legacy_parse_lrc(content)
+    attrs, lyrics = lrc.parse_lrc(content)
+    assert attrs == expected[0]
+    assert [(l['timestamp'], l['text']) for l in lyrics] == \
+        [(l['timestamp'], l['text']) for l in expected[1]]
+
+    legacy = measure('legacy parse_lrc', lambda: legacy_parse_lrc(content),
+                     rounds, size)
+    measure('parse_lrc', lambda: lrc.parse_lrc(content), rounds, size)
+    parse = measure('parse_lrc_lines', lambda: lrc.parse_lrc_lines(content),
+                    rounds, size)
+    with tempfile.NamedTemporaryFile(suffix='.lrc') as f:
+        f.write(content.encode('utf-8'))
+        f.flush()
+        cache = {}
+
+        def cached_parse():
+            st = os.stat(f.name)
+            key = (f.name, st.st_mtime_ns, st.st_size)
+            if key not in cache:
+                cache[key] = lrc.parse_lrc_lines(content)
+            return cache[key]
+        cached_parse()
+        cached = measure('cache hit', cached_parse, rounds, size)
+    print('speedup: parse %.1fx, cache hit %.0fx' % (legacy / parse,
+                                                    legacy / cached))
+
+
+if __name__ == '__main__':
+    main()
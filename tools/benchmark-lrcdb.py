@@ -0,0 +1,133 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file is part of OSD Lyrics.
+#
+# OSD Lyrics is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# OSD Lyrics is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+Benchmarks finding lyrics in the lrc db of the daemon.
+
+Usage: python3 tools/benchmark-lrcdb.py [ROWS] [QUERIES]
+
+A db with the schema before migrations is populated with ROWS assignments.
+The lookups of LrcDb.find() are measured on it with the queries it used to
+run, then the db is opened with LrcDb, which upgrades it, and the lookups
+are measured again. The osdlyrics package must be importable.
+"""
+
+import os
+import os.path
+import random
+import sqlite3
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                os.pardir, 'daemon'))
+
+from osdlyrics.metadata import Metadata  # noqa: E402
+
+import lrcdb  # noqa: E402
+
+LEGACY_FIND_BY_LOCATION = 'SELECT lrcpath FROM lyrics WHERE uri = ?'
+LEGACY_FIND_BY_INFO = ('SELECT lrcpath FROM lyrics WHERE title=:title AND '
+                       'artist=:artist AND album=:album AND tracknum=:tracknum')
+LEGACY_ASSIGN = ('INSERT OR REPLACE INTO lyrics '
+                 '(title, artist, album, tracknum, uri, lrcpath) '
+                 'VALUES (?, ?, ?, ?, ?, ?)')
+
+
+def create_metadata(i):
+    return Metadata(title='Title %d' % i,
+                    artist='Artist %d' % (i % 1000),
+                    album='Album %d' % (i % 5000),
+                    tracknum=i % 20,
+                    location='file:///music/%d.mp3' % i)
+
+
+def populate(path, rows):
+    conn = sqlite3.connect(path)
+    conn.execute(lrcdb.LrcDb.MIGRATIONS[0][0])
+    with conn:
+        conn.executemany(LEGACY_ASSIGN,
+                         ((m.title, m.artist, m.album, m.tracknum, m.location,
+                           'file:///lyrics/%d.lrc' % i)
+                          for i, m in ((i, create_metadata(i)) for i in range(rows))))
+    conn.close()
+
+
+def legacy_find(conn, metadata):
+    """ LrcDb.find() before the migrations """
+    if metadata.location:
+        r = conn.execute(LEGACY_FIND_BY_LOCATION, (metadata.location,)).fetchone()
+        if r:
+            return r[0]
+    r = conn.execute(LEGACY_FIND_BY_INFO,
+                     {'title': metadata.title or '',
+                      'artist': metadata.artist or '',
+                      'album': metadata.album or '',
+                      'tracknum': max(metadata.tracknum, 0)}).fetchone()
+    if r:
+        return r[0]
+    return None
+
+
+def measure(name, func, queries):
+    start = time.perf_counter()
+    for metadata in queries:
+        func(metadata)
+    elapsed = (time.perf_counter() - start) / len(queries)
+    print('%-24s %10.1fus/query' % (name, elapsed * 1e6))
+    return elapsed
+
+
+def create_queries(rows, count):
+    random.seed(rows)
+    queries = []
+    for _ in range(count):
+        m = create_metadata(random.randrange(rows * 2))
+        # Players without locations, which are found by metadata
+        m.location = None
+        queries.append(m)
+    return queries
+
+
+def main():
+    rows = int(sys.argv[1]) if len(sys.argv) > 1 else 100000
+    count = int(sys.argv[2]) if len(sys.argv) > 2 else 200
+    queries = create_queries(rows, count)
+    with tempfile.TemporaryDirectory() as tempdir:
+        path = os.path.join(tempdir, 'lrc.db')
+        populate(path, rows)
+        print('%d rows, %d queries, half of them not found' % (rows, count))
+
+        conn = sqlite3.connect(path)
+        before = measure('find before', lambda m: legacy_find(conn, m), queries)
+        expected = [legacy_find(conn, m) for m in queries]
+        conn.close()
+        start = time.perf_counter()
+        db = lrcdb.LrcDb(path)
+        print('%-24s %10.1fms' % ('migration', (time.perf_counter() - start) * 1000))
+        if expected != [db.find(m) for m in queries]:
+            raise AssertionError('LrcDb.find() returns different results')
+        after = measure('find after', db.find, queries)
+        print('speedup: %.0fx' % (before / after))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,88 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file is part of OSD Lyrics.
+#
+# OSD Lyrics is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# OSD Lyrics is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+Benchmarks resolving the proxy settings before each request of a plugin.
+
+Usage: python3 tools/benchmark-proxy.py [REQUESTS] [LATENCY_US]
+
+The config service is simulated in process, with each call taking LATENCY_US
+microseconds as a round-trip on the session bus does. The proxy settings are
+resolved for each request, as get_proxy_settings did before caching them,
+and with get_proxy_settings, in the manual and the system mode. The proxy
+port is changed once in a while, which must be seen by the next request.
+The system proxy is read from GSettings if available, or from the
+environment. The osdlyrics package must be importable.
+"""
+
+import sys
+import time
+
+import osdlyrics.utils
+from osdlyrics.config import Config
+
+from fakeconfig import FakeConfigService, FakeConnection
+
+VALUES = {
+    'Download/proxy': 'manual',
+    'Download/proxy-type': 'http',
+    'Download/proxy-host': 'localhost',
+    'Download/proxy-port': '8080',
+    'Download/proxy-username': '',
+    'Download/proxy-password': '',
+}
+
+# The proxy port changes every this many requests
+CHANGE_INTERVAL = 100
+
+
+def legacy_get_proxy_settings(config):
+    """ get_proxy_settings before caching """
+    return osdlyrics.utils._resolve_proxy_settings(config)[0]
+
+
+def measure(name, get_proxy_settings, mode, requests, latency):
+    service = FakeConfigService(dict(VALUES, **{'Download/proxy': mode}), latency)
+    config = Config(FakeConnection(service))
+    start = time.perf_counter()
+    for i in range(requests):
+        if i % CHANGE_INTERVAL == 0:
+            config.set_int('Download/proxy-port', 1000 + i)
+        proxy = get_proxy_settings(config)
+        if mode == 'manual' and proxy.port != 1000 + i // CHANGE_INTERVAL * CHANGE_INTERVAL:
+            raise AssertionError('Stale proxy settings')
+    elapsed = time.perf_counter() - start
+    print('%-8s %-10s %8.2f calls/request %10.2fus/request' % (
+        mode, name, service.calls / requests, elapsed / requests * 1e6))
+    return elapsed
+
+
+def main():
+    requests = int(sys.argv[1]) if len(sys.argv) > 1 else 10000
+    latency = (float(sys.argv[2]) if len(sys.argv) > 2 else 100) / 1e6
+    print('%d requests, %.0fus per call' % (requests, latency * 1e6))
+    for mode in ('manual', 'system'):
+        before = measure('uncached', legacy_get_proxy_settings, mode, requests, latency)
+        after = measure('cached', osdlyrics.utils.get_proxy_settings, mode, requests, latency)
+        print('%-8s speedup: %.1fx' % (mode, before / after))
+
+
+if __name__ == '__main__':
+    main()
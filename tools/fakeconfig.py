@@ -0,0 +1,95 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file is part of OSD Lyrics.
+#
+# OSD Lyrics is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# OSD Lyrics is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+An in-process stand-in for the config daemon, shared by the benchmarks of
+osdlyrics.config.Config and its users.
+"""
+
+import time
+
+import osdlyrics.config
+from osdlyrics.config import ValueNotExistError, to_bool
+
+
+class FakeConfigService:
+    """ A proxy object of org.osdlyrics.Config with the methods used by Config
+
+    Each call takes `latency` seconds, as a round-trip on the session bus
+    does, and is counted in `calls`.
+    """
+
+    def __init__(self, values, latency):
+        self.values = dict(values)
+        self.calls = 0
+        self._latency = latency
+        self._value_changed_cb = None
+
+    def _call(self):
+        self.calls += 1
+        end = time.perf_counter() + self._latency
+        while time.perf_counter() < end:
+            pass
+
+    def _get(self, key, convert):
+        self._call()
+        try:
+            return convert(self.values[osdlyrics.config.cache_key(key)])
+        except KeyError:
+            raise ValueNotExistError(key)
+
+    def GetAllValues(self):
+        self._call()
+        return dict(self.values)
+
+    def GetBool(self, key):
+        return self._get(key, to_bool)
+
+    def GetInt(self, key):
+        return self._get(key, int)
+
+    def GetString(self, key):
+        return self._get(key, str)
+
+    def GetStringList(self, key):
+        return self._get(key, osdlyrics.config.split)
+
+    def SetInt(self, key, value):
+        self._call()
+        self.values[osdlyrics.config.cache_key(key)] = str(value)
+        self._value_changed_cb([key])
+
+    def get_dbus_method(self, member, dbus_interface=None):
+        return getattr(self, member)
+
+    def connect_to_signal(self, signal, handler, dbus_interface=None, **kwargs):
+        self._value_changed_cb = handler
+
+
+class FakeConnection:
+
+    def __init__(self, service):
+        self._service = service
+
+    def get_object(self, *args, **kwargs):
+        return self._service
+
+    def watch_name_owner(self, name, callback):
+        pass
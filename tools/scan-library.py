@@ -0,0 +1,430 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file is part of OSD Lyrics.
+#
+# OSD Lyrics is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# OSD Lyrics is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with OSD Lyrics.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+Assigns existing LRC files to the tracks of a music library in bulk.
+
+Usage: osdlyrics-scan-library [OPTIONS] MUSIC_DIR...
+
+The music directories and the lyric directories are walked with a pool of
+threads, and the tags of the tracks are read with a pool of processes. Each
+track is matched to LRC files with the lyric path and file name patterns of
+the daemon, in the same order as the daemon finds lyrics, and the matches
+are saved into the lrc db in large transactions.
+
+Tracks that already have lyrics assigned, including the ones assigned by
+users, are left untouched. The processed tracks are recorded in a state file,
+so an interrupted scan continues from where it stopped when run again.
+
+Tags are read with mutagen if it is installed. Otherwise only the file name
+patterns made of the file name of the track (%f) can match.
+"""
+
+import argparse
+import concurrent.futures
+import configparser
+import os
+import os.path
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                os.pardir, 'daemon'))
+
+from osdlyrics.config import split  # noqa: E402
+from osdlyrics.metadata import Metadata  # noqa: E402
+from osdlyrics.pattern import PatternException, expand_path  # noqa: E402
+import osdlyrics.utils  # noqa: E402
+
+import lrcdb  # noqa: E402
+import lrcindex  # noqa: E402
+import lyrics  # noqa: E402
+
+try:
+    import mutagen
+except ImportError:
+    mutagen = None
+
+AUDIO_EXTS = frozenset([
+    '.aac', '.aif', '.aiff', '.ape', '.dsf', '.flac', '.m4a', '.mp3', '.mp4',
+    '.mpc', '.oga', '.ogg', '.opus', '.tta', '.wav', '.wma', '.wv',
+])
+
+# Tracks handled by each task of the tag reading processes
+TAGS_CHUNK_SIZE = 64
+
+PROGRESS_INTERVAL = 0.5
+
+
+def is_audio_file(name):
+    return os.path.splitext(name)[1].lower() in AUDIO_EXTS
+
+
+def walk_music(top, recursive=True):
+    """
+    Lists the audio files and LRC files under top.
+
+    Return values: tracks, lrc_files
+    - `tracks`: The paths of the audio files.
+    - `lrc_files`: A dict from directories to the names of LRC files in them.
+    """
+    tracks = []
+    lrc_files = {}
+    for dirpath, dirnames, filenames in os.walk(top):
+        if not recursive:
+            del dirnames[:]
+        for filename in filenames:
+            if is_audio_file(filename):
+                tracks.append(os.path.join(dirpath, filename))
+            elif lrcindex.is_lrc_file(filename):
+                lrc_files.setdefault(dirpath, []).append(filename)
+    return tracks, lrc_files
+
+
+def split_walk_jobs(top):
+    """
+    Splits walking top into the top directory itself and each of its
+    subdirectories, so that the workers share a large library.
+    """
+    jobs = [(top, False)]
+    try:
+        with os.scandir(top) as entries:
+            for entry in entries:
+                if entry.is_dir():
+                    jobs.append((entry.path, True))
+    except OSError as e:
+        print('Cannot read %s: %s' % (top, e), file=sys.stderr)
+        return []
+    return jobs
+
+
+def read_tags(path):
+    """
+    Reads the tags of an audio file in a worker process.
+
+    Returns a tuple of the title, artist, album and track number, with None
+    for missing ones.
+    """
+    try:
+        audio = mutagen.File(path, easy=True)
+    except Exception:
+        audio = None
+    if not audio or not audio.tags:
+        return None, None, None, -1
+
+    def first(key):
+        values = audio.tags.get(key)
+        return values[0] if values else None
+    try:
+        # Track numbers may be in the form of "3/12"
+        tracknum = int((first('tracknumber') or '').split('/')[0])
+    except ValueError:
+        tracknum = -1
+    return first('title'), first('artist'), first('album'), tracknum
+
+
+class LrcMatcher:
+    """
+    Finds LRC files with the patterns of the daemon in the lists of files
+    walked beforehand, which matches names like LrcIndex of the daemon.
+    """
+
+    def __init__(self, path_patterns, file_patterns):
+        self.path_patterns = path_patterns
+        self.file_patterns = file_patterns
+        # directory -> {normalized relative path -> [relative paths]}
+        self._files = {}
+
+    def add_files(self, directory, names):
+        index = self._files.setdefault(os.path.normpath(directory), {})
+        for name in names:
+            entries = index.setdefault(lrcindex.normalize_name(name), [])
+            if name not in entries:
+                entries.append(name)
+
+    def find(self, directory, name):
+        directory = os.path.normpath(directory)
+        index = self._files.get(directory)
+        if index is None or os.sep in name:
+            # Out of the walked directories, or in a subdirectory of a music
+            # directory that is not listed.
+            path = os.path.join(directory, name)
+            return path if os.path.isfile(path) else None
+        name = os.path.normpath(name)
+        names = index.get(lrcindex.normalize_name(name))
+        if not names:
+            return None
+        return os.path.join(directory, name if name in names else names[0])
+
+    def match(self, metadata):
+        for path, name in lyrics.expand_lrc_names(metadata, self.path_patterns,
+                                                  self.file_patterns):
+            fullpath = self.find(path, name)
+            if fullpath:
+                return fullpath
+        return None
+
+
+class ScanState:
+    """
+    The tracks processed by previous scans, stored as lines of paths and
+    modification times. A track is processed again once it is modified.
+    """
+
+    def __init__(self, filename, restart):
+        self._done = {}
+        self._file = None
+        if filename is None:
+            return
+        if not restart and os.path.exists(filename):
+            with open(filename, encoding='utf-8', errors='surrogateescape') as f:
+                for line in f:
+                    path, sep, mtime = line.rstrip('\n').rpartition('\t')
+                    if sep:
+                        self._done[path] = mtime
+        osdlyrics.utils.ensure_path(filename)
+        self._file = open(filename, 'w' if restart else 'a',
+                          encoding='utf-8', errors='surrogateescape')
+
+    def is_done(self, path, mtime):
+        return self._done.get(path) == str(mtime)
+
+    def mark_done(self, processed):
+        """ Records the tracks, after their assignments are committed
+        """
+        if self._file is None:
+            return
+        self._file.writelines('%s\t%s\n' % item for item in processed)
+        self._file.flush()
+
+    def close(self):
+        if self._file is not None:
+            self._file.close()
+
+
+class Progress:
+
+    def __init__(self, total):
+        self._total = total
+        self._start = time.perf_counter()
+        self._last = 0
+        self._tty = sys.stderr.isatty()
+
+    def update(self, done, matched, force=False):
+        now = time.perf_counter()
+        if not force and now - self._last < PROGRESS_INTERVAL:
+            return
+        self._last = now
+        elapsed = max(now - self._start, 1e-9)
+        print('%s%d/%d tracks, %d matched, %.0f files/s' % (
+            '\r' if self._tty else '', done, self._total, matched,
+            done / elapsed), end='' if self._tty else '\n',
+            file=sys.stderr, flush=True)
+
+    def finish(self, done, matched):
+        self.update(done, matched, force=True)
+        if self._tty:
+            print(file=sys.stderr)
+
+
+def report(name, count, elapsed):
+    print('%-12s %8d files %8.2fs %10.0f files/s' % (
+        name, count, elapsed, count / max(elapsed, 1e-9)))
+
+
+def load_patterns(options):
+    """ Reads the patterns from the config file of OSD Lyrics, as the daemon
+    """
+    config = configparser.RawConfigParser()
+    config.read(options.config)
+
+    def get_list(key, default):
+        try:
+            return split(config.get('General', key))
+        except (configparser.NoSectionError, configparser.NoOptionError):
+            return default
+    path_patterns = options.lrc_path or get_list('lrc-path',
+                                                 lyrics.DEFAULT_PATH_PATTERNS)
+    file_patterns = options.lrc_filename or get_list('lrc-filename',
+                                                     lyrics.DEFAULT_FILE_PATTERNS)
+    return path_patterns, file_patterns
+
+
+def walk(options, matcher):
+    """ Walks the music and lyric directories in a thread pool
+    """
+    lyric_roots = set()
+    for path_pat in matcher.path_patterns:
+        if path_pat != '%':
+            try:
+                lyric_roots.add(expand_path(path_pat, Metadata()))
+            except PatternException:
+                continue
+    tracks = []
+    with concurrent.futures.ThreadPoolExecutor(options.jobs) as executor:
+        lyric_jobs = {executor.submit(lrcindex.scan_directory, root, root): root
+                      for root in lyric_roots}
+        music_jobs = [executor.submit(walk_music, top, recursive)
+                      for music_dir in options.music_dirs
+                      for top, recursive in split_walk_jobs(os.path.abspath(music_dir))]
+        for future in concurrent.futures.as_completed(lyric_jobs):
+            files, dirs = future.result()
+            if dirs:
+                matcher.add_files(lyric_jobs[future], files)
+        for future in music_jobs:
+            music_tracks, lrc_files = future.result()
+            tracks.extend(music_tracks)
+            if '%' in matcher.path_patterns:
+                for directory, names in lrc_files.items():
+                    matcher.add_files(directory, names)
+    if '%' in matcher.path_patterns:
+        # Music directories without LRC files are known to have none
+        for directory in set(os.path.dirname(track) for track in tracks):
+            matcher.add_files(directory, [])
+    return tracks
+
+
+def iter_tags(options, tracks):
+    """ Yields the tags of tracks in order, read in a process pool
+    """
+    if mutagen is None:
+        for _ in tracks:
+            yield None, None, None, -1
+        return
+    with concurrent.futures.ProcessPoolExecutor(options.jobs) as executor:
+        yield from executor.map(read_tags, tracks, chunksize=TAGS_CHUNK_SIZE)
+
+
+def scan(options):
+    path_patterns, file_patterns = load_patterns(options)
+    matcher = LrcMatcher(path_patterns, file_patterns)
+    db = lrcdb.LrcDb(options.db)
+    assigned = db.assigned_locations()
+    state = ScanState(None if options.dry_run else options.state, options.restart)
+    if mutagen is None:
+        print('mutagen is not installed, tracks are matched by file names only',
+              file=sys.stderr)
+
+    start = time.perf_counter()
+    tracks = walk(options, matcher)
+    walk_elapsed = time.perf_counter() - start
+
+    pending = []
+    skipped = 0
+    for path in tracks:
+        location = osdlyrics.utils.path2uri(path)
+        try:
+            mtime = os.stat(path).st_mtime_ns
+        except OSError:
+            continue
+        if location in assigned or state.is_done(path, mtime):
+            skipped += 1
+        else:
+            pending.append((path, location, mtime))
+    print('%d tracks found, %d already processed' % (len(tracks), skipped),
+          file=sys.stderr)
+
+    start = time.perf_counter()
+    progress = Progress(len(pending))
+    assignments = []
+    processed = []
+    matched = 0
+    tags = iter_tags(options, [path for path, _, _ in pending])
+    for done, ((path, location, mtime), (title, artist, album, tracknum)) in \
+            enumerate(zip(pending, tags), 1):
+        metadata = Metadata(title=title, artist=artist, album=album,
+                            tracknum=tracknum, location=location)
+        lrc_path = matcher.match(metadata)
+        if lrc_path:
+            matched += 1
+            assignments.append((metadata, osdlyrics.utils.path2uri(lrc_path)))
+            if options.dry_run:
+                print('%s\t%s' % (path, lrc_path))
+        processed.append((path, mtime))
+        if len(processed) >= options.batch_size:
+            commit(options, db, state, assignments, processed)
+        progress.update(done, matched)
+    commit(options, db, state, assignments, processed)
+    progress.finish(len(pending), matched)
+    state.close()
+    match_elapsed = time.perf_counter() - start
+
+    report('walk', len(tracks), walk_elapsed)
+    report('match', len(pending), match_elapsed)
+    report('total', len(tracks), walk_elapsed + match_elapsed)
+    print('%d tracks matched%s' % (matched, ', not saved' if options.dry_run else ''))
+
+
+def commit(options, db, state, assignments, processed):
+    """ Saves a batch of assignments, then records the tracks as processed
+    """
+    if not options.dry_run:
+        db.assign_many(assignments)
+        state.mark_done(processed)
+    del assignments[:]
+    del processed[:]
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description='Assign existing LRC files to the tracks of a music library.')
+    parser.add_argument('music_dirs', metavar='MUSIC_DIR', nargs='+',
+                        help='directories of music files to scan')
+    parser.add_argument('-n', '--dry-run', action='store_true',
+                        help='print the matches without saving them')
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count() or 1,
+                        help='number of workers (default: number of CPUs)')
+    parser.add_argument('--batch-size', type=int, default=5000,
+                        help='number of tracks saved in each transaction '
+                        '(default: %(default)s)')
+    parser.add_argument('--db', default=osdlyrics.utils.get_config_path('lrc.db'),
+                        help='path of the lrc db (default: %(default)s)')
+    parser.add_argument('--config',
+                        default=osdlyrics.utils.get_config_path('osdlyrics.conf'),
+                        help='config file to read the patterns of LRC files from '
+                        '(default: %(default)s)')
+    parser.add_argument('--lrc-path', action='append', metavar='PATTERN',
+                        help='pattern of lyric directories, overriding the config. '
+                        'Can be given multiple times')
+    parser.add_argument('--lrc-filename', action='append', metavar='PATTERN',
+                        help='pattern of LRC file names, overriding the config. '
+                        'Can be given multiple times')
+    parser.add_argument('--state',
+                        default=osdlyrics.utils.get_config_path('scan-library.state'),
+                        help='file recording the processed tracks to resume '
+                        'scanning (default: %(default)s)')
+    parser.add_argument('--restart', action='store_true',
+                        help='process the tracks recorded in the state file again')
+    options = parser.parse_args()
+    if options.jobs < 1 or options.batch_size < 1:
+        parser.error('--jobs and --batch-size must be positive')
+    return options
+
+
+def main():
+    try:
+        scan(parse_args())
+    except KeyboardInterrupt:
+        print('\nInterrupted, run again to continue', file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()